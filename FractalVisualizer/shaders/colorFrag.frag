@@ -0,0 +1,85 @@
+#version 330 core
+
+// Colors smooth iteration counts, from fractalFrag.frag's iteration pass or the CPU renderers.
+// The CPU textures are R32F, so their y reads 0: no root basin and nothing stopped early.
+
+uniform sampler2D iterationTexture;
+uniform vec2 iResolution;
+uniform float iterations;
+uniform float contrast;
+
+// the palette baked by bakePalette in palette.cpp, one texel per entry
+uniform sampler1D paletteTexture;
+uniform int paletteSize;
+uniform int paletteRepeats;
+
+// running totals of the histogram from prefixSumFrag.frag, read in place of contrast when equalizing
+uniform int equalize;
+uniform sampler2D cumulativeHistogram;
+uniform int histogramBins;
+
+// Sub-samples of edge pixels from the shader's supersampling pass, subsampleGrid x subsampleGrid
+// texels per pixel. subsampleEntries holds each pixel's entry, -1 for pixels it left out, and
+// entry i starts at (i % entries per row, i / entries per row) * subsampleGrid. 0 colors the one sample.
+uniform int subsampleGrid;
+uniform sampler2D subsampleTexture;
+uniform isampler2D subsampleEntries;
+
+out vec4 fragColor;
+
+vec4 colorOf(vec2 texel) {
+    float smoothIter = texel.x;
+
+    // alpha 0 marks interior pixels stopped by the periodicity check for the statistics
+    if (smoothIter >= float(iterations)) {
+        return vec4(0.0, 0.0, 0.0, texel.y < 0.0 ? 0.0 : 1.0);
+    }
+
+    float t;
+    if (equalize != 0) {
+        // equalizedPosition in palette.cpp
+        float position = max(smoothIter, 0.0) * (float(histogramBins) / float(iterations));
+        int bin = min(int(position), histogramBins - 1);
+        float total = texelFetch(cumulativeHistogram, ivec2(histogramBins - 1, 0), 0).r;
+        float after = texelFetch(cumulativeHistogram, ivec2(bin, 0), 0).r;
+        float before = bin > 0 ? texelFetch(cumulativeHistogram, ivec2(bin - 1, 0), 0).r : 0.0;
+        t = total > 0.0 ? mix(before, after, clamp(position - float(bin), 0.0, 1.0)) / total : 0.0;
+    }
+    else {
+        t = max(smoothIter / float(iterations), 0.0);
+        t = pow(t, contrast);
+        t = smoothstep(0.0, 1.0, t);
+    }
+
+    if (paletteRepeats > 0) {
+        t = fract(t * float(paletteRepeats));
+    }
+
+    // every root gets its own stretch of the gradient
+    if (texel.y >= 1.0) {
+        t = fract(t + texel.y - 1.0);
+    }
+
+    return texelFetch(paletteTexture, min(int(t * float(paletteSize)), paletteSize - 1), 0);
+}
+
+void main() {
+    vec2 texel = texture(iterationTexture, gl_FragCoord.xy / iResolution).rg;
+    fragColor = colorOf(texel);
+
+    // blendSubsamples in supersampling.cpp, the pixel's own alpha still marks a periodic interior
+    int entry = subsampleGrid > 0 ? texelFetch(subsampleEntries, ivec2(gl_FragCoord.xy), 0).r : -1;
+    if (entry >= 0) {
+        int rowEntries = textureSize(subsampleTexture, 0).x / subsampleGrid;
+        ivec2 first = ivec2(entry % rowEntries, entry / rowEntries) * subsampleGrid;
+        vec4 sum = vec4(0.0);
+        for (int y = 0; y < subsampleGrid; y++) {
+            for (int x = 0; x < subsampleGrid; x++) {
+                vec2 subsample = texelFetch(subsampleTexture, first + ivec2(x, y), 0).rg;
+                sum += colorOf(vec2(subsample.x, max(subsample.y, 0.0)));
+            }
+        }
+        sum /= float(subsampleGrid * subsampleGrid);
+        fragColor = vec4(sum.rgb, fragColor.a == 0.0 ? 0.0 : sum.a);
+    }
+}
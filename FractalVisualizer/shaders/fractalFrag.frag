@@ -6,14 +6,58 @@ uniform float centerY;
 uniform vec2 iResolution;
 uniform float iterations;
 uniform float escapeRadius;
-uniform float contrast;
 
-uniform vec4 colorStops[4];
-uniform float stopPositions[3];
+// 1 when the equation is z^2 + c, so the main cardioid and period 2 bulb can be skipped
+uniform int interiorTest;
 
-out vec4 fragColor;
+// Orbits that come back within periodicityTolerance (a small fraction of a pixel) of a saved point are
+// in a cycle and stop early, the saved point moves after periodicityInterval iterations
+// and the interval doubles every time. 0 turns the check off.
+uniform int periodicityInterval;
+uniform float periodicityTolerance;
+
+// interior pixels stopped by the periodicity check, marked for the statistics
+bool terminatedEarly = false;
+
+// 1 for z - f(z) equations, orbits that move less than convergenceEpsilon in a step have settled
+// on a root and are shaded by how fast they got there, tinted by which root it is
+uniform int convergenceTest;
+uniform float convergenceEpsilon;
+float rootBasin = -1.0;
+
+// 1 when the equation can reach inf or nan, which would never pass the escape check
+uniform int nonFiniteBailout;
+
+// 1 carries dz/dc next to z and shades escaping pixels by their distance to the boundary,
+// reaching the last color at distanceRange pixels. Same scale as the iteration counts.
+uniform int distanceEstimation;
+uniform float distanceRange;
+
+// Perturbation for deep z^2 + c views, 0 iterates directly, 1 keeps deltas in float, 2 in ComplexExp
+uniform int deltaMode;
+uniform sampler2D referenceOrbit;
+uniform int referenceLength;
+uniform vec2 deltaScale;
+uniform int deltaScaleExponent;
+
+// Sub-sample pass of edge-adaptive antialiasing, see supersampling.h. With subsampleGrid > 0 each
+// fragment is one jittered sub-sample of an edge pixel: texel (i % width, i / width) of
+// subsamplePixels holds the pixel of entry i, whose sub-samples are the subsampleGrid x
+// subsampleGrid fragments at that texel times subsampleGrid. Fragments past subsampleCount entries
+// are discarded.
+uniform int subsampleGrid;
+uniform isampler2D subsamplePixels;
+uniform int subsampleCount;
+
+// The iteration pass, colorFrag.frag colors its output so palette changes don't iterate again.
+// x is the smooth iteration count, y is 1 + the root basin for converging orbits, -1 for
+// interior pixels stopped by the periodicity check and 0 otherwise.
+out vec2 fragIterations;
 
 #define LOG2 0.69314718055994530941723212145818
+#define REFERENCE_TEXTURE_WIDTH 1024
+#define ZERO_EXPONENT -1000000
+#define DISTANCE_BAILOUT 1e6
 
 // [CUSTOM_UNIFORMS]
 
@@ -202,80 +246,365 @@ vec2 complexImag(vec2 a) {
 
 // [BEGIN_CUSTOM_EQUATION]
 vec2 customEquation(vec2 z, vec2 c) { return z; }
+vec2 customDerivative(vec2 z, vec2 c, vec2 dz, vec2 dc) { return dz; }
+#define UNROLL_FACTOR 1
+vec2 iterateUnrolled(vec2 z, vec2 c, inout float peak) { z = customEquation(z, c); peak = max(peak, dot(z, z)); return z; }
 // [END_CUSTOM_EQUATION]
 
-float getSmoothIterations() {
-    highp float real = ((gl_FragCoord.x / iResolution.x - 0.5) * zoom + centerX) * 2.0;
-    highp float imag = ((gl_FragCoord.y / iResolution.y - 0.5) * zoom + centerY) * 2.0;
+// Extended exponent numbers, value = m * 2^e with a float mantissa scaled so the larger
+// component is in [1, 2). Same idea as FloatExp on the CPU, sharing one exponent per complex number.
+
+struct ComplexExp {
+    vec2 m;
+    int e;
+};
+
+float exp2Int(int e) {
+    return intBitsToFloat((clamp(e, -126, 127) + 127) << 23);
+}
+
+ComplexExp normalizeExp(vec2 m, int e) {
+    float largest = max(abs(m.x), abs(m.y));
+    if (largest == 0.0) {
+        return ComplexExp(vec2(0.0), ZERO_EXPONENT);
+    }
+    int shift = ((floatBitsToInt(largest) >> 23) & 0xFF) - 127;
+    return ComplexExp(m * exp2Int(-shift), e + shift);
+}
+
+ComplexExp addExp(ComplexExp a, ComplexExp b) {
+    int difference = a.e - b.e;
+    if (difference > 30) return a;
+    if (difference < -30) return b;
+    if (difference >= 0) return normalizeExp(a.m + b.m * exp2Int(-difference), a.e);
+    return normalizeExp(a.m * exp2Int(difference) + b.m, b.e);
+}
+
+ComplexExp multiplyExp(ComplexExp a, ComplexExp b) {
+    return normalizeExp(complexMultiply(a.m, b.m), a.e + b.e);
+}
+
+vec2 toVec2(ComplexExp a) {
+    if (a.e < -126) return vec2(0.0);
+    return a.m * exp2Int(a.e);
+}
+
+vec2 getReference(int m) {
+    return texelFetch(referenceOrbit, ivec2(m % REFERENCE_TEXTURE_WIDTH, m / REFERENCE_TEXTURE_WIDTH), 0).xy;
+}
+
+float getEscapeIterations(int n, float magnitudeSq) {
+    float logZn = log(magnitudeSq) / 2.0;
+    float nu = log(logZn / LOG2) / LOG2;
+    return float(n) + 1.0 - nu;
+}
+
+// getDistanceIterations with dz/dc, which grows as fast as the pixels shrink, and the pixel
+// height, deltaScale.y, in extended exponent
+float getPerturbedDistance(float magnitudeSq, ComplexExp dz) {
+    float pixelLog2 = log2(deltaScale.y) + float(deltaScaleExponent);
+    float distanceLog2 = log2(0.25 * sqrt(magnitudeSq) * log(magnitudeSq)) - (float(dz.e) + log2(length(dz.m)));
+    return clamp(exp2(distanceLog2 - pixelLog2) / distanceRange, 0.0, 0.999) * float(iterations);
+}
+
+// dz/dc' = 2z * dz/dc + 1
+ComplexExp stepDerivative(vec2 z, ComplexExp dz) {
+    return addExp(multiplyExp(normalizeExp(2.0 * z, 0), dz), ComplexExp(vec2(1.0, 0.0), 0));
+}
+
+// z = Z_m + dz with dz' = (2Z + dz) * dz + dc, rebasing to the start of the reference
+// when the orbit gets closer to zero than the delta or the reference runs out. Distance
+// estimation follows escaped pixels on to DISTANCE_BAILOUT like getSmoothIterations.
+float getPerturbedIterations(vec2 position) {
+    vec2 pixelOffset = position - 0.5 * iResolution;
+    int m = 0;
+    ComplexExp derivative = ComplexExp(vec2(0.0), ZERO_EXPONENT);
+    float escapedDistance = -1.0;
+    float farDistance = 0.999 * float(iterations);
+
+    if (deltaMode == 1) {
+        vec2 deltaC = pixelOffset * deltaScale * exp2Int(deltaScaleExponent);
+        vec2 delta = vec2(0.0);
+
+        for (int n = 0; n < int(iterations); ++n) {
+            vec2 reference = getReference(m);
+            vec2 z = reference + delta;
+            float magnitudeSq = dot(z, z);
+
+            if (magnitudeSq > escapeRadius) {
+                if (distanceEstimation == 0) {
+                    return getEscapeIterations(n, magnitudeSq);
+                }
+                escapedDistance = getPerturbedDistance(magnitudeSq, derivative);
+                if (escapedDistance >= farDistance || magnitudeSq > DISTANCE_BAILOUT) {
+                    return escapedDistance;
+                }
+            }
+            if (magnitudeSq < dot(delta, delta) || m + 1 >= referenceLength) {
+                delta = z;
+                reference = vec2(0.0);
+                m = 0;
+            }
+
+            if (distanceEstimation == 1) {
+                derivative = stepDerivative(z, derivative);
+            }
+            delta = complexMultiply(2.0 * reference + delta, delta) + deltaC;
+            ++m;
+        }
+        return escapedDistance >= 0.0 ? escapedDistance : float(iterations);
+    }
+
+    ComplexExp deltaC = multiplyExp(normalizeExp(pixelOffset, 0), ComplexExp(deltaScale, deltaScaleExponent));
+    ComplexExp delta = ComplexExp(vec2(0.0), ZERO_EXPONENT);
+
+    for (int n = 0; n < int(iterations); ++n) {
+        vec2 reference = getReference(m);
+        vec2 deltaValue = toVec2(delta);
+        vec2 z = reference + deltaValue;
+        float magnitudeSq = dot(z, z);
+
+        if (magnitudeSq > escapeRadius) {
+            if (distanceEstimation == 0) {
+                return getEscapeIterations(n, magnitudeSq);
+            }
+            escapedDistance = getPerturbedDistance(magnitudeSq, derivative);
+            if (escapedDistance >= farDistance || magnitudeSq > DISTANCE_BAILOUT) {
+                return escapedDistance;
+            }
+        }
+        if (magnitudeSq < dot(deltaValue, deltaValue) || m + 1 >= referenceLength) {
+            delta = addExp(normalizeExp(reference, 0), delta);
+            reference = vec2(0.0);
+            m = 0;
+        }
+
+        if (distanceEstimation == 1) {
+            derivative = stepDerivative(z, derivative);
+        }
+        ComplexExp sum = addExp(normalizeExp(2.0 * reference, 0), delta);
+        delta = addExp(multiplyExp(sum, delta), deltaC);
+        ++m;
+    }
+    return escapedDistance >= 0.0 ? escapedDistance : float(iterations);
+}
+
+// same as getConvergenceIterations in escapeTime.h
+float getConvergenceIterations(int n, float stepSq, float previousStepSq) {
+    float logEpsilon = log(convergenceEpsilon * convergenceEpsilon);
+    float logStep = log(stepSq);
+    float logPrevious = log(previousStepSq);
+    if (!(logPrevious > logStep)) return float(n);
+    float t = (logEpsilon - logPrevious) / (logStep - logPrevious);
+    return float(n) - 1.0 + clamp(t, 0.0, 1.0);
+}
+
+// same as getDistanceIterations in escapeTime.h
+float getDistanceIterations(float magnitudeSq, vec2 dz) {
+    float pixelSize = 2.0 * zoom / iResolution.y;
+    float distance = 0.25 * sqrt(magnitudeSq / dot(dz, dz)) * log(magnitudeSq);
+    return clamp(distance / (pixelSize * distanceRange), 0.0, 0.999) * float(iterations);
+}
+
+bool isInMainCardioidOrBulb(vec2 c) {
+    float imagSq = c.y * c.y;
+    float shifted = c.x - 0.25;
+    float q = shifted * shifted + imagSq;
+    if (q * (q + shifted) <= 0.25 * imagSq) return true;
+
+    float bulb = c.x + 1.0;
+    return bulb * bulb + imagSq <= 0.0625;
+}
+
+// UNROLL_FACTOR iterations at a time with one escape check per block, peak is the largest |z|^2
+// inside it. A block that escaped or hit inf or nan is redone one iteration at a time from its start,
+// so the result is the same as the loop in getSmoothIterations. Periodicity is checked between blocks.
+float getUnrolledIterations(vec2 c) {
+    vec2 z = c;
+    int n = 0;
+
+    vec2 savedZ = z;
+    int checkLength = periodicityInterval;
+    int checkCounter = 0;
+    float toleranceSq = periodicityTolerance * periodicityTolerance;
+
+    while (n + UNROLL_FACTOR <= int(iterations)) {
+        float peak = dot(z, z);
+        vec2 next = iterateUnrolled(z, c, peak);
+        if (!(peak <= escapeRadius) || !(dot(next, next) <= escapeRadius)) {
+            break;
+        }
+        z = next;
+        n += UNROLL_FACTOR;
+
+        if (periodicityInterval > 0) {
+            vec2 difference = z - savedZ;
+            if (dot(difference, difference) < toleranceSq) {
+                terminatedEarly = true;
+                return float(iterations);
+            }
+            if (++checkCounter == checkLength) {
+                savedZ = z;
+                checkCounter = 0;
+                checkLength *= 2;
+            }
+        }
+    }
+
+    for (; n < int(iterations); ++n) {
+        float magnitudeSq = dot(z, z);
+        if (magnitudeSq > escapeRadius) {
+            return getEscapeIterations(n, magnitudeSq);
+        }
+        z = customEquation(z, c);
+
+        if (nonFiniteBailout == 1 && (any(isinf(z)) || any(isnan(z)))) {
+            return float(n + 1);
+        }
+    }
+    return float(iterations);
+}
+
+float getSmoothIterations(vec2 position) {
+    highp float real = ((position.x / iResolution.x - 0.5) * zoom + centerX) * 2.0;
+    highp float imag = ((position.y / iResolution.y - 0.5) * zoom + centerY) * 2.0;
     
     highp float constReal = real;
     highp float constImag = imag;
+
+    if (interiorTest == 1 && isInMainCardioidOrBulb(vec2(constReal, constImag))) {
+        return float(iterations);
+    }
+
+    // the unrolled loop has no per iteration checks for convergence or the derivative
+    if (UNROLL_FACTOR > 1 && convergenceTest == 0 && distanceEstimation == 0) {
+        return getUnrolledIterations(vec2(constReal, constImag));
+    }
     
     highp float realSq = 0.0;
     highp float imagSq = 0.0;
     int initialIterations = 0;
+
+    vec2 savedZ = vec2(real, imag);
+    int checkLength = periodicityInterval;
+    int checkCounter = 0;
+    float toleranceSq = periodicityTolerance * periodicityTolerance;
+
+    float previousStepSq = 0.0;
+
+    // dz/dc starts at 1 because z starts at the pixel
+    vec2 dz = vec2(1.0, 0.0);
+    float escapedDistance = -1.0;
+    float farDistance = 0.999 * float(iterations);
     
     while (initialIterations < iterations) {
         realSq = real * real;
         imagSq = imag * imag;
         
         if (realSq + imagSq > escapeRadius) {
-            float logZn = log(realSq + imagSq) / 2.0;
-            float nu = log(logZn / LOG2) / LOG2;
-            return float(initialIterations) + 1.0 - nu;
+            if (distanceEstimation == 0) {
+                float logZn = log(realSq + imagSq) / 2.0;
+                float nu = log(logZn / LOG2) / LOG2;
+                return float(initialIterations) + 1.0 - nu;
+            }
+
+            // far pixels are already past the range, only pixels near the boundary iterate on to the larger bailout
+            escapedDistance = getDistanceIterations(realSq + imagSq, dz);
+            if (escapedDistance >= farDistance || realSq + imagSq > DISTANCE_BAILOUT) {
+                return escapedDistance;
+            }
         }
         
         vec2 z = vec2(real, imag);
         vec2 c = vec2(constReal, constImag);
         vec2 nextZ;
         
+        if (distanceEstimation == 1) {
+            dz = customDerivative(z, c, dz, vec2(1.0, 0.0));
+        }
         nextZ = customEquation(z, c);
 
         real = nextZ.x;
         imag = nextZ.y;
 
         ++initialIterations;
+
+        if (convergenceTest == 1) {
+            vec2 step = nextZ - z;
+            float stepSq = dot(step, step);
+            if (stepSq < convergenceEpsilon * convergenceEpsilon) {
+                rootBasin = atan(nextZ.y, nextZ.x) / (2.0 * 3.14159265) + 0.5;
+                return getConvergenceIterations(initialIterations, stepSq, previousStepSq);
+            }
+            previousStepSq = stepSq;
+        }
+
+        if (nonFiniteBailout == 1 && (any(isinf(nextZ)) || any(isnan(nextZ)))) {
+            if (distanceEstimation == 1) return escapedDistance >= 0.0 ? escapedDistance : farDistance;
+            return float(initialIterations);
+        }
+
+        if (periodicityInterval > 0) {
+            vec2 difference = nextZ - savedZ;
+            if (dot(difference, difference) < toleranceSq) {
+                terminatedEarly = true;
+                return float(iterations);
+            }
+            if (++checkCounter == checkLength) {
+                savedZ = nextZ;
+                checkCounter = 0;
+                checkLength *= 2;
+            }
+        }
+    }
+
+    // escaped but ran out of iterations before the distance bailout
+    if (escapedDistance >= 0.0) {
+        return escapedDistance;
     }
     
     return float(iterations);
 }
 
-vec4 getGradientColor(float t, vec4 colors[4], float stops[3]) {
-    int i;
-    if (t < stops[0]) {
-        i = 0;
-    } else if (t < stops[1]) {
-        i = 1;
-    } else {
-        i = 2;
-    }
+// hashSample in supersampling.cpp
+uint hashSample(uint value) {
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return value;
+}
 
-    float segmentStart;
-    if (i == 0) {
-        segmentStart = 0.0;
-    } else {
-        segmentStart = stops[i - 1];
+// where the fragment samples the frame, in its pixels like gl_FragCoord
+vec2 getSamplePosition() {
+    if (subsampleGrid == 0) {
+        return gl_FragCoord.xy;
     }
 
-    float segmentEnd = stops[i];
-    float factor = (t - segmentStart) / (segmentEnd - segmentStart);
-    return mix(colors[i], colors[i+1], factor);
-}
-
-vec4 returnColor() {
-    float smoothIter = getSmoothIterations();
-    
-    if (smoothIter >= float(iterations)) {
-        return vec4(0.0, 0.0, 0.0, 1.0);
+    ivec2 fragment = ivec2(gl_FragCoord.xy);
+    ivec2 entry = fragment / subsampleGrid;
+    ivec2 cell = fragment - entry * subsampleGrid;
+    if (entry.y * textureSize(subsamplePixels, 0).x + entry.x >= subsampleCount) {
+        discard;
     }
-    
-    float t = smoothIter / float(iterations);
-    t = pow(t, contrast);
-    t = smoothstep(0.0, 1.0, t);
+    ivec2 pixel = texelFetch(subsamplePixels, entry, 0).xy;
 
-    return getGradientColor(t, colorStops, stopPositions);
+    // subsamplePosition in supersampling.cpp
+    uint seed = hashSample(uint(pixel.x) + hashSample(uint(pixel.y) + hashSample(uint(cell.y * subsampleGrid + cell.x))));
+    vec2 jitter = vec2(float(seed & 0xffffu), float(seed >> 16)) / 65536.0;
+    return vec2(pixel) + (vec2(cell) + jitter) / float(subsampleGrid);
 }
 
 void main() {
-    fragColor = returnColor();
-}
\ No newline at end of file
+    vec2 position = getSamplePosition();
+    float smoothIter = deltaMode == 0 ? getSmoothIterations(position) : getPerturbedIterations(position);
+
+    float marker = 0.0;
+    if (rootBasin >= 0.0) {
+        marker = 1.0 + rootBasin;
+    } else if (terminatedEarly && smoothIter >= float(iterations)) {
+        marker = -1.0;
+    }
+    fragIterations = vec2(smoothIter, marker);
+}
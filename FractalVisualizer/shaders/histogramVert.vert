@@ -0,0 +1,31 @@
+#version 330 core
+
+// One point for the middle pixel of each sampleStride x sampleStride block of the iteration
+// texture, dropped on the bin of its smooth iteration count. Additive blending does the counting.
+// Neighbouring points go to different rows, so points of the same bin don't all wait on one texel;
+// prefixSumFrag.frag adds the rows up.
+
+uniform sampler2D iterationTexture;
+uniform int sampleColumns;
+uniform int sampleStride;
+uniform float iterations;
+uniform int binCount;
+uniform int laneCount;
+
+void main() {
+    ivec2 block = ivec2(gl_VertexID % sampleColumns, gl_VertexID / sampleColumns);
+    ivec2 pixel = min(block * sampleStride + sampleStride / 2, textureSize(iterationTexture, 0) - 1);
+    float smoothIter = texelFetch(iterationTexture, pixel, 0).r;
+
+    // pixels inside the set aren't counted, the point lands outside the target
+    if (!(smoothIter < iterations)) {
+        gl_Position = vec4(2.0, 2.0, 0.0, 1.0);
+        return;
+    }
+
+    // IterationHistogram::add in palette.cpp
+    float binScale = float(binCount) / iterations;
+    int bin = min(int(max(smoothIter, 0.0) * binScale), binCount - 1);
+    int lane = gl_VertexID % laneCount;
+    gl_Position = vec4((float(bin) + 0.5) / float(binCount) * 2.0 - 1.0, (float(lane) + 0.5) / float(laneCount) * 2.0 - 1.0, 0.0, 1.0);
+}
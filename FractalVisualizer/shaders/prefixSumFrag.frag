@@ -0,0 +1,30 @@
+#version 330 core
+
+// Running totals of the histogram, one texel per bin. The first pass adds up the lanes
+// histogramVert.vert spread the counts over, then every pass adds the value offset bins to the
+// left, doubling offset each time (Hillis and Steele), so log2(bins) passes leave each bin
+// holding the count of every bin up to and including itself.
+
+uniform sampler2D source;
+uniform int offset; // 0 for the pass over the lanes
+uniform int laneCount;
+
+out float total;
+
+void main() {
+    int bin = int(gl_FragCoord.x);
+
+    if (offset == 0) {
+        float sum = 0.0;
+        for (int lane = 0; lane < laneCount; ++lane) {
+            sum += texelFetch(source, ivec2(bin, lane), 0).r;
+        }
+        total = sum;
+        return;
+    }
+
+    total = texelFetch(source, ivec2(bin, 0), 0).r;
+    if (bin >= offset) {
+        total += texelFetch(source, ivec2(bin - offset, 0), 0).r;
+    }
+}
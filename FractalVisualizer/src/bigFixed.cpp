@@ -0,0 +1,250 @@
+#include "bigFixed.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+BigFixed::BigFixed(int fractionalLimbs) {
+    limbs.assign(std::max(fractionalLimbs, 0) + 1, 0);
+}
+
+BigFixed BigFixed::fromDouble(double value, int fractionalLimbs) {
+    BigFixed result(fractionalLimbs);
+
+    double integerPart = std::floor(value);
+    double fraction = value - integerPart;
+    result.limbs[0] = static_cast<uint32_t>(static_cast<int32_t>(integerPart));
+
+    for (int i = 1; i <= fractionalLimbs && fraction > 0.0; ++i) {
+        fraction *= 4294967296.0;
+        double limb = std::floor(fraction);
+        result.limbs[i] = static_cast<uint32_t>(limb);
+        fraction -= limb;
+    }
+
+    return result;
+}
+
+BigFixed BigFixed::fromString(const std::string& text, int fractionalLimbs) {
+    size_t pos = 0;
+    while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) pos++;
+
+    bool negative = false;
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+        negative = text[pos] == '-';
+        pos++;
+    }
+
+    std::string integerDigits;
+    std::string fractionDigits;
+    while (pos < text.size() && isdigit(static_cast<unsigned char>(text[pos]))) integerDigits += text[pos++];
+    if (pos < text.size() && text[pos] == '.') {
+        pos++;
+        while (pos < text.size() && isdigit(static_cast<unsigned char>(text[pos]))) fractionDigits += text[pos++];
+    }
+    while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) pos++;
+
+    if (pos != text.size() || (integerDigits.empty() && fractionDigits.empty()) || integerDigits.size() > 9) {
+        throw std::runtime_error("Invalid coordinate: " + text);
+    }
+
+    // about 3.33 bits per decimal digit, plus a guard limb
+    int neededLimbs = static_cast<int>(fractionDigits.size() * 3.33 / 32.0) + 2;
+    BigFixed result(std::max(fractionalLimbs, neededLimbs));
+
+    // fraction = (digit + fraction) / 10, from the last digit to the first
+    for (auto it = fractionDigits.rbegin(); it != fractionDigits.rend(); ++it) {
+        result.limbs[0] = static_cast<uint32_t>(*it - '0');
+        uint64_t remainder = 0;
+        for (uint32_t& limb : result.limbs) {
+            uint64_t current = (remainder << 32) | limb;
+            limb = static_cast<uint32_t>(current / 10);
+            remainder = current % 10;
+        }
+    }
+
+    result.limbs[0] = integerDigits.empty() ? 0 : static_cast<uint32_t>(std::stoul(integerDigits));
+    if (negative) result.negate();
+    return result;
+}
+
+double BigFixed::toDouble() const {
+    double value = static_cast<int32_t>(limbs[0]);
+    double scale = 1.0;
+    for (size_t i = 1; i < limbs.size() && i <= 3; ++i) {
+        scale /= 4294967296.0;
+        value += limbs[i] * scale;
+    }
+    return value;
+}
+
+FloatExp BigFixed::toFloatExp() const {
+    BigFixed magnitude = *this;
+    if (isNegative()) magnitude.negate();
+
+    // the first limb with a bit set and the two after it hold the 53 leading bits
+    size_t first = 0;
+    while (first < magnitude.limbs.size() && magnitude.limbs[first] == 0) ++first;
+    if (first == magnitude.limbs.size()) return FloatExp();
+
+    double value = 0.0;
+    double scale = 1.0;
+    for (size_t i = first; i < magnitude.limbs.size() && i < first + 3; ++i) {
+        value += magnitude.limbs[i] * scale;
+        scale /= 4294967296.0;
+    }
+    FloatExp result(value, -32 * static_cast<int>(first));
+    return isNegative() ? -result : result;
+}
+
+std::string BigFixed::toString(int decimals) const {
+    BigFixed magnitude = *this;
+    std::string text;
+    if (isNegative()) {
+        magnitude.negate();
+        text += '-';
+    }
+
+    text += std::to_string(magnitude.limbs[0]);
+    if (decimals <= 0) return text;
+    text += '.';
+
+    // each digit is the integer carry out of multiplying the fraction by 10
+    for (int d = 0; d < decimals; ++d) {
+        uint64_t carry = 0;
+        for (size_t i = magnitude.limbs.size() - 1; i >= 1; --i) {
+            uint64_t current = static_cast<uint64_t>(magnitude.limbs[i]) * 10 + carry;
+            magnitude.limbs[i] = static_cast<uint32_t>(current);
+            carry = current >> 32;
+        }
+        text += static_cast<char>('0' + carry);
+    }
+
+    return text;
+}
+
+void BigFixed::reservePrecision(int fractionalLimbs) {
+    size_t size = static_cast<size_t>(fractionalLimbs) + 1;
+    if (size <= limbs.size()) return;
+    if (size > limbs.capacity()) {
+        limbs.reserve(std::max(size, limbs.capacity() * 2));
+    }
+    limbs.resize(size, 0);
+}
+
+void BigFixed::addLimbs(const uint32_t* otherLimbs, int count, bool subtract) {
+    // limbs past our own precision are truncated
+    int last = std::min(count, static_cast<int>(limbs.size())) - 1;
+    int64_t carry = 0;
+
+    for (int i = last; i >= 0; --i) {
+        int64_t sum = static_cast<int64_t>(limbs[i]) + (subtract ? -static_cast<int64_t>(otherLimbs[i]) : static_cast<int64_t>(otherLimbs[i])) + carry;
+        limbs[i] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+}
+
+void BigFixed::add(const BigFixed& other) {
+    addLimbs(other.limbs.data(), static_cast<int>(other.limbs.size()), false);
+}
+
+void BigFixed::subtract(const BigFixed& other) {
+    addLimbs(other.limbs.data(), static_cast<int>(other.limbs.size()), true);
+}
+
+void BigFixed::add(const FloatExp& value) {
+    if (value.isZero()) return;
+
+    // 53 bit integer mantissa whose lowest bit has weight 2^lowWeight
+    uint64_t magnitude = static_cast<uint64_t>(std::abs(value.mantissa) * 4503599627370496.0);
+    int lowWeight = value.exponent - 52;
+    bool negative = value.mantissa < 0.0;
+
+    int64_t carry = 0;
+    for (int i = static_cast<int>(limbs.size()) - 1; i >= 0; --i) {
+        // limb i holds weights 2^(-32i) to 2^(-32i + 31)
+        int shift = lowWeight + 32 * i;
+        uint32_t chunk = 0;
+        if (shift >= 0 && shift < 32) chunk = static_cast<uint32_t>(magnitude << shift);
+        else if (shift < 0 && shift > -64) chunk = static_cast<uint32_t>(magnitude >> -shift);
+
+        if (chunk == 0 && carry == 0) continue;
+
+        int64_t sum = static_cast<int64_t>(limbs[i]) + (negative ? -static_cast<int64_t>(chunk) : static_cast<int64_t>(chunk)) + carry;
+        limbs[i] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+}
+
+void BigFixed::negate() {
+    uint64_t carry = 1;
+    for (int i = static_cast<int>(limbs.size()) - 1; i >= 0; --i) {
+        uint64_t sum = static_cast<uint64_t>(~limbs[i]) + carry;
+        limbs[i] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+}
+
+void BigFixed::shiftLeft(int power) {
+    if (power <= 0) return;
+    for (size_t i = 0; i < limbs.size(); ++i) {
+        uint32_t next = i + 1 < limbs.size() ? limbs[i + 1] : 0;
+        limbs[i] = (limbs[i] << power) | (next >> (32 - power));
+    }
+}
+
+void BigFixed::multiply(const BigFixed& a, const BigFixed& b, BigFixed& result) {
+    thread_local std::vector<uint32_t> magnitudeA;
+    thread_local std::vector<uint32_t> magnitudeB;
+    thread_local std::vector<uint32_t> product;
+
+    // schoolbook product of the magnitudes, little endian so each row carries into the next limb
+    auto loadMagnitude = [](const BigFixed& value, std::vector<uint32_t>& magnitude) {
+        magnitude.assign(value.limbs.rbegin(), value.limbs.rend());
+        if (value.isNegative()) {
+            uint64_t carry = 1;
+            for (uint32_t& limb : magnitude) {
+                uint64_t sum = static_cast<uint64_t>(~limb) + carry;
+                limb = static_cast<uint32_t>(sum);
+                carry = sum >> 32;
+            }
+        }
+    };
+
+    loadMagnitude(a, magnitudeA);
+    loadMagnitude(b, magnitudeB);
+
+    size_t sizeA = magnitudeA.size();
+    size_t sizeB = magnitudeB.size();
+    product.assign(sizeA + sizeB, 0);
+
+    for (size_t i = 0; i < sizeA; ++i) {
+        uint64_t carry = 0;
+        uint64_t limbA = magnitudeA[i];
+        if (limbA == 0) continue;
+        for (size_t j = 0; j < sizeB; ++j) {
+            uint64_t current = limbA * magnitudeB[j] + product[i + j] + carry;
+            product[i + j] = static_cast<uint32_t>(current);
+            carry = current >> 32;
+        }
+        product[i + sizeB] = static_cast<uint32_t>(carry);
+    }
+
+    // product index sizeA + sizeB - 2 is the integer limb, anything above it overflowed
+    int integerIndex = static_cast<int>(sizeA + sizeB) - 2;
+    for (size_t k = 0; k < result.limbs.size(); ++k) {
+        int index = integerIndex - static_cast<int>(k);
+        result.limbs[k] = index >= 0 ? product[index] : 0;
+    }
+
+    if (a.isNegative() != b.isNegative()) result.negate();
+}
+
+bool BigFixed::operator==(const BigFixed& other) const {
+    size_t size = std::max(limbs.size(), other.limbs.size());
+    for (size_t i = 0; i < size; ++i) {
+        uint32_t limb = i < limbs.size() ? limbs[i] : 0;
+        uint32_t otherLimb = i < other.limbs.size() ? other.limbs[i] : 0;
+        if (limb != otherLimb) return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef BIG_FIXED_H
+#define BIG_FIXED_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "floatExp.h"
+
+// Arbitrary precision signed fixed point number for view coordinates and reference orbits.
+// limbs[0] is the integer part, limbs[1..] are 32 bit fractional limbs with the most
+// significant first, and the whole limb string is one two's complement number.
+// The fractional limb count only grows, and storage is reserved ahead so adding
+// precision while zooming doesn't reallocate on every mouse event.
+
+class BigFixed {
+public:
+    BigFixed(int fractionalLimbs = 2);
+
+    static BigFixed fromDouble(double value, int fractionalLimbs = 2);
+    static BigFixed fromString(const std::string& text, int fractionalLimbs = 2);
+
+    double toDouble() const;
+    FloatExp toFloatExp() const; // keeps the leading bits of values far below 1e-308, like differences of deep centers
+    std::string toString(int decimals) const;
+
+    int fractionalLimbs() const { return static_cast<int>(limbs.size()) - 1; }
+    int fractionalBits() const { return fractionalLimbs() * 32; }
+
+    // grows to at least this many fractional limbs, new limbs are zero
+    void reservePrecision(int fractionalLimbs);
+
+    bool isNegative() const { return (limbs[0] & 0x80000000u) != 0; }
+
+    void add(const BigFixed& other);
+    void subtract(const BigFixed& other);
+    void add(const FloatExp& value);
+    void negate();
+
+    // value * 2^power for small positive powers, like the factor of two in 2 * Z_real * Z_imag
+    void shiftLeft(int power);
+
+    // result keeps its own precision, its limbs are reused between calls
+    static void multiply(const BigFixed& a, const BigFixed& b, BigFixed& result);
+
+    bool operator==(const BigFixed& other) const;
+
+private:
+    std::vector<uint32_t> limbs;
+
+    void addLimbs(const uint32_t* otherLimbs, int count, bool subtract);
+};
+
+#endif // BIG_FIXED_H
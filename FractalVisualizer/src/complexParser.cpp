@@ -1,9 +1,27 @@
 #include "complexParser.h"
 
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+
 std::string ComplexExpressionParser::translate(const std::string& equation) {
+    return toGLSL(parse(equation));
+}
+
+std::string ComplexExpressionParser::translateDerivative(const std::string& equation) {
+    return toGLSL(derivative(parse(equation)));
+}
+
+ExpressionNode ComplexExpressionParser::parse(const std::string& equation) {
     tokens = tokenize(equation);
     currentToken = 0;
-    return parseExpression();
+
+    ExpressionNode root = parseExpression();
+    if (currentToken < tokens.size()) {
+        throw std::runtime_error("Unexpected token at position " + std::to_string(tokens[currentToken].pos));
+    }
+    return root;
 }
 
 std::vector<ComplexExpressionParser::Token> ComplexExpressionParser::tokenize(const std::string& input) {
@@ -38,6 +56,10 @@ std::vector<ComplexExpressionParser::Token> ComplexExpressionParser::tokenize(co
                 pos++;
             }
             else {
+                // the derivative of the equation is written with these
+                if (ident == "dz" || ident == "dc") {
+                    throw std::runtime_error("Variable name " + ident + " is reserved");
+                }
                 tokens.push_back({ Token::Variable, ident, start });
             }
             continue;
@@ -67,12 +89,12 @@ std::vector<ComplexExpressionParser::Token> ComplexExpressionParser::tokenize(co
     return tokens;
 }
 
-std::string ComplexExpressionParser::parseExpression(int precedence) {
+ExpressionNode ComplexExpressionParser::parseExpression(int precedence) {
     static const std::unordered_map<std::string, int> operatorPrecedence = {
         {"+", 1}, {"-", 1}, {"*", 2}, {"/", 2}, {"^", 3}
     };
 
-    std::string left = parsePrimary();
+    ExpressionNode left = parsePrimary();
 
     while (currentToken < tokens.size()) {
         const Token& token = tokens[currentToken];
@@ -82,48 +104,37 @@ std::string ComplexExpressionParser::parseExpression(int precedence) {
         if (currentPrecedence <= precedence) break;
 
         currentToken++;
-        std::string right = parseExpression(currentPrecedence);
-
-        if (token.value == "^") {
-            left = "complexPower(" + left + ", " + right + ")";
-        }
-        else if (token.value == "*") {
-            left = "complexMultiply(" + left + ", " + right + ")";
-        }
-        else if (token.value == "/") {
-            left = "complexDivide(" + left + ", " + right + ")";
-        }
-        else {
-            left = "(" + left + token.value + right + ")";
-        }
+        ExpressionNode right = parseExpression(currentPrecedence);
+        left = { ExpressionNode::Operator, token.value, { std::move(left), std::move(right) } };
     }
 
     return left;
 }
 
-std::string ComplexExpressionParser::parsePrimary() {
+ExpressionNode ComplexExpressionParser::parsePrimary() {
+    if (currentToken >= tokens.size()) {
+        throw std::runtime_error("Unexpected end of equation");
+    }
     const Token& token = tokens[currentToken++];
 
     switch (token.type) {
         case Token::Number:
-            return token.value;
+            return { ExpressionNode::Number, token.value, {} };
 
         case Token::Variable:
-            return token.value;
+            return { ExpressionNode::Variable, token.value, {} };
 
         case Token::Function: {
-            std::string function = "complex" + capitalize(token.value);
-            currentToken++; // skip (
-            std::string arg = parseExpression();
-
-            currentToken++; // skip )
-            return function + "(" + arg + ")";
+            expect(Token::LeftParenthesis);
+            ExpressionNode arg = parseExpression();
+            expect(Token::RightParenthesis);
+            return { ExpressionNode::Function, token.value, { std::move(arg) } };
         }
 
         case Token::LeftParenthesis: {
-            std::string expression = parseExpression();
-            currentToken++; // skip )
-            return "(" + expression + ")";
+            ExpressionNode expression = parseExpression();
+            expect(Token::RightParenthesis);
+            return { ExpressionNode::Parentheses, "()", { std::move(expression) } };
         }
 
         default:
@@ -131,6 +142,279 @@ std::string ComplexExpressionParser::parsePrimary() {
     }
 }
 
+void ComplexExpressionParser::expect(Token::Type type) {
+    if (currentToken >= tokens.size() || tokens[currentToken].type != type) {
+        throw std::runtime_error(currentToken < tokens.size()
+            ? "Unexpected token at position " + std::to_string(tokens[currentToken].pos)
+            : "Unexpected end of equation");
+    }
+    currentToken++;
+}
+
+std::string ComplexExpressionParser::toGLSL(const ExpressionNode& node) {
+    switch (node.type) {
+        case ExpressionNode::Number:
+        case ExpressionNode::Variable:
+            return node.value;
+
+        case ExpressionNode::Function:
+            return "complex" + capitalize(node.value) + "(" + toGLSL(node.children[0]) + ")";
+
+        case ExpressionNode::Parentheses:
+            return "(" + toGLSL(node.children[0]) + ")";
+
+        default: {
+            std::string left = toGLSL(node.children[0]);
+            std::string right = toGLSL(node.children[1]);
+
+            if (node.value == "^") {
+                return "complexPower(" + left + ", " + right + ")";
+            }
+            else if (node.value == "*") {
+                return "complexMultiply(" + left + ", " + right + ")";
+            }
+            else if (node.value == "/") {
+                return "complexDivide(" + left + ", " + right + ")";
+            }
+            return "(" + left + node.value + right + ")";
+        }
+    }
+}
+
+namespace {
+
+const ExpressionNode& stripParentheses(const ExpressionNode& node) {
+    return node.type == ExpressionNode::Parentheses ? stripParentheses(node.children[0]) : node;
+}
+
+bool isVariable(const ExpressionNode& node, const char* name) {
+    const ExpressionNode& inner = stripParentheses(node);
+    return inner.type == ExpressionNode::Variable && inner.value == name;
+}
+
+bool isNumber(const ExpressionNode& node, double value) {
+    const ExpressionNode& inner = stripParentheses(node);
+    return inner.type == ExpressionNode::Number && std::stod(inner.value) == value;
+}
+
+// z^2 or z*z
+bool isSquareOfZ(const ExpressionNode& node) {
+    const ExpressionNode& inner = stripParentheses(node);
+    if (inner.type != ExpressionNode::Operator) return false;
+    if (inner.value == "^") return isVariable(inner.children[0], "z") && isNumber(inner.children[1], 2.0);
+    if (inner.value == "*") return isVariable(inner.children[0], "z") && isVariable(inner.children[1], "z");
+    return false;
+}
+
+// z^n for an integer literal n >= 2, the Multibrot family
+bool isIntegerPowerOfZ(const ExpressionNode& node) {
+    if (isSquareOfZ(node)) return true;
+    const ExpressionNode& inner = stripParentheses(node);
+    if (inner.type != ExpressionNode::Operator || inner.value != "^" || !isVariable(inner.children[0], "z")) return false;
+
+    const ExpressionNode& exponent = stripParentheses(inner.children[1]);
+    return exponent.type == ExpressionNode::Number && exponent.value.find('.') == std::string::npos && std::stod(exponent.value) >= 2.0;
+}
+
+bool usesOverflowingFunction(const ExpressionNode& node) {
+    static const std::unordered_set<std::string> overflowing = { "exp", "sin", "cos", "tan", "sinh", "cosh", "tanh" };
+    if (node.type == ExpressionNode::Function && overflowing.count(node.value)) return true;
+
+    // z^c and friends go through exp and log as well
+    if (node.type == ExpressionNode::Operator && node.value == "^" && stripParentheses(node.children[1]).type != ExpressionNode::Number) return true;
+
+    for (const ExpressionNode& child : node.children) {
+        if (usesOverflowingFunction(child)) return true;
+    }
+    return false;
+}
+
+ExpressionNode number(const std::string& value) {
+    return { ExpressionNode::Number, value, {} };
+}
+
+ExpressionNode variable(const std::string& name) {
+    return { ExpressionNode::Variable, name, {} };
+}
+
+ExpressionNode operation(const std::string& op, ExpressionNode left, ExpressionNode right) {
+    return { ExpressionNode::Operator, op, { std::move(left), std::move(right) } };
+}
+
+ExpressionNode function(const std::string& name, ExpressionNode argument) {
+    return { ExpressionNode::Function, name, { std::move(argument) } };
+}
+
+int equationCost(const ExpressionNode& node) {
+    int cost = 0;
+    for (const ExpressionNode& child : node.children) cost += equationCost(child);
+
+    if (node.type == ExpressionNode::Function) return cost + 16;
+    if (node.type != ExpressionNode::Operator) return cost;
+    if (node.value == "+" || node.value == "-") return cost + 2;
+    if (node.value == "*") return cost + 6;
+    if (node.value == "/") return cost + 12;
+
+    // integer powers are repeated multiplication, anything else goes through log and exp
+    const ExpressionNode& exponent = stripParentheses(node.children[1]);
+    if (exponent.type == ExpressionNode::Number && exponent.value.find('.') == std::string::npos) {
+        return cost + 6 * static_cast<int>(std::clamp(std::stod(exponent.value), 1.0, 64.0));
+    }
+    return cost + 32;
+}
+
+// always has a decimal point so GLSL reads it as a float
+std::string formatFloat(double value) {
+    std::ostringstream stream;
+    stream << std::setprecision(17) << value;
+    std::string text = stream.str();
+    if (text.find_first_of(".e") == std::string::npos) text += ".0";
+    return text;
+}
+
+// 0.0 - x negates both components, the same as complex negation
+ExpressionNode negate(ExpressionNode node) {
+    return operation("-", number("0.0"), std::move(node));
+}
+
+// derivatives that are identically zero are left out, so constants and uniforms cost nothing
+std::optional<ExpressionNode> differentiate(const ExpressionNode& node) {
+    switch (node.type) {
+        case ExpressionNode::Number:
+            return std::nullopt;
+
+        case ExpressionNode::Variable:
+            if (node.value == "z") return variable("dz");
+            if (node.value == "c") return variable("dc");
+            return std::nullopt;
+
+        case ExpressionNode::Parentheses:
+            return differentiate(node.children[0]);
+
+        case ExpressionNode::Function: {
+            std::optional<ExpressionNode> inner = differentiate(node.children[0]);
+            if (!inner) return std::nullopt;
+
+            const ExpressionNode& a = node.children[0];
+            ExpressionNode da = std::move(*inner);
+            const std::string& name = node.value;
+
+            if (name == "sqrt") return operation("/", std::move(da), operation("*", number("2.0"), function("sqrt", a)));
+            if (name == "exp") return operation("*", function("exp", a), std::move(da));
+            if (name == "log" || name == "ln") return operation("/", std::move(da), a);
+            if (name == "sin") return operation("*", function("cos", a), std::move(da));
+            if (name == "cos") return operation("*", negate(function("sin", a)), std::move(da));
+            if (name == "tan") return operation("/", std::move(da), operation("*", function("cos", a), function("cos", a)));
+            if (name == "sinh") return operation("*", function("cosh", a), std::move(da));
+            if (name == "cosh") return operation("*", function("sinh", a), std::move(da));
+            if (name == "tanh") return operation("/", std::move(da), operation("*", function("cosh", a), function("cosh", a)));
+            if (name == "asin") return operation("/", std::move(da), function("sqrt", operation("-", variable("dc"), operation("*", a, a))));
+            if (name == "acos") return operation("/", negate(std::move(da)), function("sqrt", operation("-", variable("dc"), operation("*", a, a))));
+            if (name == "atan") return operation("/", std::move(da), operation("+", variable("dc"), operation("*", a, a)));
+            if (name == "asinh") return operation("/", std::move(da), function("sqrt", operation("+", operation("*", a, a), variable("dc"))));
+            if (name == "acosh") return operation("/", std::move(da), operation("*", function("sqrt", operation("-", a, variable("dc"))), function("sqrt", operation("+", a, variable("dc")))));
+            if (name == "atanh") return operation("/", std::move(da), operation("-", variable("dc"), operation("*", a, a)));
+            if (name == "conj" || name == "mod" || name == "real" || name == "imag") return function(name, std::move(da));
+            return da; // abs
+        }
+
+        default: {
+            const ExpressionNode& a = node.children[0];
+            const ExpressionNode& b = node.children[1];
+            std::optional<ExpressionNode> da = differentiate(a);
+            std::optional<ExpressionNode> db = differentiate(b);
+            if (!da && !db) return std::nullopt;
+
+            if (node.value == "+") {
+                if (!da) return db;
+                if (!db) return da;
+                return operation("+", std::move(*da), std::move(*db));
+            }
+
+            if (node.value == "-") {
+                if (!db) return da;
+                if (!da) return negate(std::move(*db));
+                return operation("-", std::move(*da), std::move(*db));
+            }
+
+            if (node.value == "*") {
+                if (!db) return operation("*", std::move(*da), b);
+                if (!da) return operation("*", a, std::move(*db));
+                return operation("+", operation("*", std::move(*da), b), operation("*", a, std::move(*db)));
+            }
+
+            if (node.value == "/") {
+                if (!db) return operation("/", std::move(*da), b);
+                ExpressionNode numerator = da
+                    ? operation("-", operation("*", std::move(*da), b), operation("*", a, std::move(*db)))
+                    : negate(operation("*", a, std::move(*db)));
+                return operation("/", std::move(numerator), operation("*", b, b));
+            }
+
+            // a^n for a literal n is n * a^(n - 1) * da, keeping integer literals integers for the GLSL overloads
+            const ExpressionNode& exponent = stripParentheses(b);
+            if (!db && exponent.type == ExpressionNode::Number) {
+                bool isInteger = exponent.value.find('.') == std::string::npos;
+                double n = std::stod(exponent.value);
+                if (n == 1.0) return da;
+
+                std::string lowered = isInteger ? std::to_string(static_cast<long long>(n) - 1) : formatFloat(n - 1.0);
+                ExpressionNode power = n - 1.0 == 1.0 ? a : operation("^", a, number(lowered));
+                return operation("*", operation("*", number(formatFloat(n)), std::move(power)), std::move(*da));
+            }
+
+            // a^b = exp(b log a), so d(a^b) = a^b * (db log a + b da / a)
+            ExpressionNode power = operation("^", a, b);
+            std::optional<ExpressionNode> sum;
+            if (db) sum = operation("*", std::move(*db), function("log", a));
+            if (da) {
+                ExpressionNode term = operation("/", operation("*", b, std::move(*da)), a);
+                sum = sum ? operation("+", std::move(*sum), std::move(term)) : std::move(term);
+            }
+            return operation("*", std::move(power), std::move(*sum));
+        }
+    }
+}
+
+} // namespace
+
+ExpressionNode ComplexExpressionParser::derivative(const ExpressionNode& node) {
+    std::optional<ExpressionNode> result = differentiate(node);
+
+    // still a vec2 when the equation doesn't depend on the pixel at all
+    if (!result) return operation("*", number("0.0"), variable("dc"));
+    return std::move(*result);
+}
+
+EquationTraits ComplexExpressionParser::analyze(const ExpressionNode& node) {
+    EquationTraits traits;
+
+    const ExpressionNode& root = stripParentheses(node);
+    if (root.type == ExpressionNode::Operator && root.value == "+") {
+        const ExpressionNode& left = root.children[0];
+        const ExpressionNode& right = root.children[1];
+        traits.isQuadraticMandelbrot = (isSquareOfZ(left) && isVariable(right, "c")) || (isVariable(left, "c") && isSquareOfZ(right));
+        traits.hasConnectedLevelSets = (isIntegerPowerOfZ(left) && isVariable(right, "c")) || (isVariable(left, "c") && isIntegerPowerOfZ(right));
+    }
+    if (root.type == ExpressionNode::Operator && root.value == "-") {
+        traits.converges = isVariable(root.children[0], "z");
+    }
+    traits.canOverflow = usesOverflowingFunction(node);
+    traits.cost = equationCost(node);
+
+    return traits;
+}
+
+EquationTraits analyzeEquation(const std::string& equation) {
+    try {
+        ComplexExpressionParser parser;
+        return ComplexExpressionParser::analyze(parser.parse(equation));
+    }
+    catch (const std::exception&) {
+        return EquationTraits();
+    }
+}
+
 std::string ComplexExpressionParser::capitalize(std::string s) {
     if (!s.empty()) {
         s[0] = toupper(s[0]);
@@ -4,12 +4,41 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <stdexcept>
 #include <cctype>
 
+// Parsed equation, operators have two children, functions and parentheses one
+struct ExpressionNode {
+    enum Type { Number, Variable, Operator, Function, Parentheses };
+    Type type;
+    std::string value;
+    std::vector<ExpressionNode> children;
+};
+
+// What the renderers can assume about an equation beyond evaluating it
+struct EquationTraits {
+    bool isQuadraticMandelbrot = false; // z^2 + c, main cardioid and period 2 bulb membership is known in closed form
+    bool hasConnectedLevelSets = false; // z^n + c with integer n >= 2, a region enclosed by one iteration count has that count inside
+    bool converges = false; // z - f(z) like Newton's method, orbits settle on a root instead of escaping
+    bool canOverflow = false; // exp, trigonometric and hyperbolic functions can reach inf or nan before escaping
+    int cost = 0; // rough float operations per iteration, cheap equations are unrolled further in the shader
+};
+
 class ComplexExpressionParser {
 public:
     std::string translate(const std::string& equation);
+    std::string translateDerivative(const std::string& equation);
+    ExpressionNode parse(const std::string& equation);
+
+    static std::string toGLSL(const ExpressionNode& node);
+    static EquationTraits analyze(const ExpressionNode& node);
+
+    // d(equation)/d(pixel) in terms of z, c and two extra variables: dz, the derivative of z carried
+    // through the iterations, and dc, the complex number 1 since c is the pixel itself.
+    // abs, conj, mod, real and imag aren't holomorphic and keep only the magnitude of the derivative,
+    // the inverse trigonometric functions use the derivative of the exact complex function.
+    static ExpressionNode derivative(const ExpressionNode& node);
 
 private:
     struct Token {
@@ -24,10 +53,13 @@ private:
 
     std::vector<Token> tokenize(const std::string& input);
 
-    std::string parseExpression(int precedence = 0);
-    std::string parsePrimary();
+    ExpressionNode parseExpression(int precedence = 0);
+    ExpressionNode parsePrimary();
+    void expect(Token::Type type);
 
     static std::string capitalize(std::string s);
 };
 
-#endif // COMPLEX_PARSER_H
\ No newline at end of file
+EquationTraits analyzeEquation(const std::string& equation);
+
+#endif // COMPLEX_PARSER_H
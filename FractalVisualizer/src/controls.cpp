@@ -3,9 +3,7 @@
 bool isDragging = false;
 double lastMouseX = 0.0;
 double lastMouseY = 0.0;
-double centerX = 0.0;
-double centerY = 0.0;
-float zoom = 1.0;
+ViewState view;
 
 void setupControls(GLFWwindow* window) {
 	glfwSetKeyCallback(window, ImGui_ImplGlfw_KeyCallback);
@@ -45,9 +43,8 @@ void scrollInput(GLFWwindow* window, double xOffset, double yOffset) {
 	glfwGetCursorPos(window, &mouseX, &mouseY);
 
 	if (mouseX < OPENGL_WIDTH) {
-		float zoomFactor = (yOffset > 0) ? 0.9f : 1.1f;
-		zoom *= zoomFactor;
-		zoom = std::max(0.000001f, std::min(zoom, 10.0f));
+		double zoomFactor = (yOffset > 0) ? 0.9 : 1.1;
+		view.setLogZoom(view.logZoom + std::log2(zoomFactor));
 
 	}
 }
@@ -61,8 +58,7 @@ void cursorPositionCallback(GLFWwindow* window, double xPos, double yPos) {
 		int width, height;
 		glfwGetWindowSize(window, &width, &height);
 
-		centerX -= (deltaX / OPENGL_WIDTH) * zoom;
-		centerY += (deltaY / HEIGHT) * zoom;
+		view.pan(-deltaX / OPENGL_WIDTH, deltaY / HEIGHT);
 
 		lastMouseX = xPos;
 		lastMouseY = yPos;
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <algorithm>
+#include <cmath>
 
 #include "GLFW/glfw3.h"
 #include "imgui.h"
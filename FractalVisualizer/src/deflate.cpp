@@ -0,0 +1,611 @@
+#include "deflate.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+
+const int MIN_MATCH = 3;
+const int MAX_MATCH = 258;
+
+const int HASH_BITS = 15;
+const int HASH_SIZE = 1 << HASH_BITS;
+const int WINDOW_MASK = DEFLATE_WINDOW - 1;
+
+// chain search limits, about zlib's level 4
+const int MAX_CHAIN = 32;
+const int NICE_MATCH = 128;
+
+// a byte repeated this often is taken as a run without looking for a better match
+const int RUN_THRESHOLD = 16;
+
+// matches longer than this only hash their first position
+const int MAX_INSERT = 32;
+
+const int TOKENS_PER_BLOCK = 16384;
+
+const int LITERAL_CODES = 286;
+const int DISTANCE_CODES = 30;
+const int LENGTH_CODES = 19;
+
+const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// order the code length code lengths are sent in
+const uint8_t LENGTH_CODE_ORDER[LENGTH_CODES] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+struct CodeTables {
+    std::array<uint8_t, MAX_MATCH + 1> lengthCode;
+    std::array<uint8_t, 512> distanceCode; // distances up to 256 directly, larger ones by (distance - 1) >> 7
+
+    CodeTables() {
+        for (int code = 0; code < 29; ++code) {
+            for (int length = LENGTH_BASE[code]; length < LENGTH_BASE[code] + (1 << LENGTH_EXTRA[code]) && length <= MAX_MATCH; ++length) {
+                lengthCode[length] = static_cast<uint8_t>(code);
+            }
+        }
+        lengthCode[MAX_MATCH] = 28;
+
+        for (int code = 0; code < DISTANCE_CODES; ++code) {
+            for (int distance = DISTANCE_BASE[code]; distance < DISTANCE_BASE[code] + (1 << DISTANCE_EXTRA[code]); ++distance) {
+                if (distance <= 256) distanceCode[distance - 1] = static_cast<uint8_t>(code);
+                else distanceCode[256 + ((distance - 1) >> 7)] = static_cast<uint8_t>(code);
+            }
+        }
+    }
+
+    int distance(int value) const {
+        return value <= 256 ? distanceCode[value - 1] : distanceCode[256 + ((value - 1) >> 7)];
+    }
+};
+
+const CodeTables TABLES;
+
+// a literal when distance is 0, a match of length bytes otherwise
+struct Token {
+    uint16_t length;
+    uint16_t distance;
+};
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out(out) {
+    }
+
+    // deflate packs bits from the least significant end
+    void write(uint32_t value, int count) {
+        bits |= static_cast<uint64_t>(value) << used;
+        used += count;
+        while (used >= 8) {
+            out.push_back(static_cast<uint8_t>(bits));
+            bits >>= 8;
+            used -= 8;
+        }
+    }
+
+    void alignToByte() {
+        if (used > 0) {
+            out.push_back(static_cast<uint8_t>(bits));
+            bits = 0;
+            used = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint64_t bits = 0;
+    int used = 0;
+};
+
+// Huffman code lengths no longer than maxBits, frequencies are halved until the tree fits
+std::vector<uint8_t> buildLengths(std::vector<uint32_t> frequencies, int maxBits) {
+    int count = static_cast<int>(frequencies.size());
+    std::vector<uint8_t> lengths(count, 0);
+
+    std::vector<int> used;
+    for (int i = 0; i < count; ++i) {
+        if (frequencies[i] > 0) used.push_back(i);
+    }
+    // inflate rejects most incomplete codes, one or no symbol still gets a second one bit code
+    if (used.size() < 2) {
+        int symbol = used.empty() ? 0 : used[0];
+        lengths[symbol] = 1;
+        lengths[symbol == 0 ? 1 : 0] = 1;
+        return lengths;
+    }
+
+    while (true) {
+        // nodes below count are symbols, parents are added after them
+        std::vector<int> parent(count * 2, -1);
+        using Node = std::pair<uint64_t, int>;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        for (int symbol : used) queue.push({ frequencies[symbol], symbol });
+
+        int next = count;
+        while (queue.size() > 1) {
+            Node a = queue.top();
+            queue.pop();
+            Node b = queue.top();
+            queue.pop();
+            parent[a.second] = next;
+            parent[b.second] = next;
+            queue.push({ a.first + b.first, next++ });
+        }
+
+        int longest = 0;
+        for (int symbol : used) {
+            int depth = 0;
+            for (int node = symbol; parent[node] >= 0; node = parent[node]) ++depth;
+            lengths[symbol] = static_cast<uint8_t>(depth);
+            longest = std::max(longest, depth);
+        }
+        if (longest <= maxBits) return lengths;
+
+        for (int symbol : used) frequencies[symbol] = (frequencies[symbol] + 1) / 2;
+    }
+}
+
+// canonical codes with their bits reversed, ready for BitWriter
+std::vector<uint16_t> buildCodes(const std::vector<uint8_t>& lengths) {
+    std::array<int, 16> lengthCount = {};
+    for (uint8_t length : lengths) lengthCount[length]++;
+    lengthCount[0] = 0;
+
+    std::array<int, 16> nextCode = {};
+    int code = 0;
+    for (int bits = 1; bits < 16; ++bits) {
+        code = (code + lengthCount[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+
+    std::vector<uint16_t> codes(lengths.size(), 0);
+    for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+        int length = lengths[symbol];
+        if (length == 0) continue;
+        int value = nextCode[length]++;
+        int reversed = 0;
+        for (int bit = 0; bit < length; ++bit) reversed |= ((value >> bit) & 1) << (length - 1 - bit);
+        codes[symbol] = static_cast<uint16_t>(reversed);
+    }
+    return codes;
+}
+
+struct LengthRun {
+    uint8_t symbol;
+    uint8_t extra;
+};
+
+// the literal and distance lengths as code length symbols, 16 repeats the last length, 17 and 18 repeat zero
+std::vector<LengthRun> encodeLengths(const std::vector<uint8_t>& lengths) {
+    std::vector<LengthRun> runs;
+    size_t i = 0;
+    while (i < lengths.size()) {
+        uint8_t length = lengths[i];
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == length) ++run;
+
+        if (length == 0 && run >= 3) {
+            size_t left = run;
+            while (left >= 11) {
+                size_t take = std::min<size_t>(left, 138);
+                runs.push_back({ 18, static_cast<uint8_t>(take - 11) });
+                left -= take;
+            }
+            if (left >= 3) {
+                runs.push_back({ 17, static_cast<uint8_t>(left - 3) });
+                left = 0;
+            }
+            for (; left > 0; --left) runs.push_back({ 0, 0 });
+        }
+        else if (length != 0 && run >= 4) {
+            runs.push_back({ length, 0 });
+            size_t left = run - 1;
+            while (left >= 3) {
+                size_t take = std::min<size_t>(left, 6);
+                runs.push_back({ 16, static_cast<uint8_t>(take - 3) });
+                left -= take;
+            }
+            for (; left > 0; --left) runs.push_back({ length, 0 });
+        }
+        else {
+            for (size_t k = 0; k < run; ++k) runs.push_back({ length, 0 });
+        }
+        i += run;
+    }
+    return runs;
+}
+
+void writeStored(BitWriter& writer, const uint8_t* data, size_t length, bool final) {
+    do {
+        size_t piece = std::min<size_t>(length, 65535);
+        length -= piece;
+        writer.write(final && length == 0 ? 1 : 0, 1);
+        writer.write(0, 2);
+        writer.alignToByte();
+        writer.write(static_cast<uint32_t>(piece), 16);
+        writer.write(static_cast<uint32_t>(~piece & 0xffff), 16);
+        for (size_t i = 0; i < piece; ++i) writer.write(data[i], 8);
+        data += piece;
+    } while (length > 0);
+}
+
+// one block with its own Huffman codes, or stored when that is smaller
+void writeBlock(BitWriter& writer, const Token* tokens, size_t tokenCount, const uint8_t* raw, size_t rawLength, bool final) {
+    std::vector<uint32_t> literalFrequencies(LITERAL_CODES, 0);
+    std::vector<uint32_t> distanceFrequencies(DISTANCE_CODES, 0);
+    for (size_t i = 0; i < tokenCount; ++i) {
+        const Token& token = tokens[i];
+        if (token.distance == 0) {
+            literalFrequencies[token.length]++;
+        }
+        else {
+            literalFrequencies[257 + TABLES.lengthCode[token.length]]++;
+            distanceFrequencies[TABLES.distance(token.distance)]++;
+        }
+    }
+    literalFrequencies[256] = 1;
+
+    std::vector<uint8_t> literalLengths = buildLengths(literalFrequencies, 15);
+    std::vector<uint8_t> distanceLengths = buildLengths(distanceFrequencies, 15);
+
+    int literalCount = LITERAL_CODES;
+    while (literalCount > 257 && literalLengths[literalCount - 1] == 0) --literalCount;
+    int distanceCount = DISTANCE_CODES;
+    while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) --distanceCount;
+
+    std::vector<uint8_t> allLengths(literalLengths.begin(), literalLengths.begin() + literalCount);
+    allLengths.insert(allLengths.end(), distanceLengths.begin(), distanceLengths.begin() + distanceCount);
+    std::vector<LengthRun> runs = encodeLengths(allLengths);
+
+    std::vector<uint32_t> lengthFrequencies(LENGTH_CODES, 0);
+    for (const LengthRun& run : runs) lengthFrequencies[run.symbol]++;
+    std::vector<uint8_t> lengthLengths = buildLengths(lengthFrequencies, 7);
+    int lengthCount = LENGTH_CODES;
+    while (lengthCount > 4 && lengthLengths[LENGTH_CODE_ORDER[lengthCount - 1]] == 0) --lengthCount;
+
+    // compare sizes before writing anything
+    uint64_t bits = 3 + 5 + 5 + 4 + 3 * lengthCount;
+    for (const LengthRun& run : runs) {
+        bits += lengthLengths[run.symbol] + (run.symbol == 16 ? 2 : run.symbol == 17 ? 3 : run.symbol == 18 ? 7 : 0);
+    }
+    for (int symbol = 0; symbol < LITERAL_CODES; ++symbol) {
+        bits += static_cast<uint64_t>(literalFrequencies[symbol]) * literalLengths[symbol];
+        if (symbol >= 257) bits += static_cast<uint64_t>(literalFrequencies[symbol]) * LENGTH_EXTRA[symbol - 257];
+    }
+    for (int symbol = 0; symbol < DISTANCE_CODES; ++symbol) {
+        bits += static_cast<uint64_t>(distanceFrequencies[symbol]) * (distanceLengths[symbol] + DISTANCE_EXTRA[symbol]);
+    }
+    uint64_t storedBits = static_cast<uint64_t>(rawLength) * 8 + ((rawLength + 65534) / 65535 + 1) * 40;
+    if (storedBits < bits) {
+        writeStored(writer, raw, rawLength, final);
+        return;
+    }
+
+    std::vector<uint16_t> literalCodes = buildCodes(literalLengths);
+    std::vector<uint16_t> distanceCodes = buildCodes(distanceLengths);
+    std::vector<uint16_t> lengthCodes = buildCodes(lengthLengths);
+
+    writer.write(final ? 1 : 0, 1);
+    writer.write(2, 2);
+    writer.write(literalCount - 257, 5);
+    writer.write(distanceCount - 1, 5);
+    writer.write(lengthCount - 4, 4);
+    for (int i = 0; i < lengthCount; ++i) writer.write(lengthLengths[LENGTH_CODE_ORDER[i]], 3);
+    for (const LengthRun& run : runs) {
+        writer.write(lengthCodes[run.symbol], lengthLengths[run.symbol]);
+        if (run.symbol == 16) writer.write(run.extra, 2);
+        else if (run.symbol == 17) writer.write(run.extra, 3);
+        else if (run.symbol == 18) writer.write(run.extra, 7);
+    }
+
+    for (size_t i = 0; i < tokenCount; ++i) {
+        const Token& token = tokens[i];
+        if (token.distance == 0) {
+            writer.write(literalCodes[token.length], literalLengths[token.length]);
+            continue;
+        }
+        int lengthCode = TABLES.lengthCode[token.length];
+        writer.write(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+        writer.write(token.length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+        int distanceCode = TABLES.distance(token.distance);
+        writer.write(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+        writer.write(token.distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+    }
+    writer.write(literalCodes[256], literalLengths[256]);
+}
+
+uint32_t hashAt(const uint8_t* data) {
+    return ((data[0] << 10) ^ (data[1] << 5) ^ data[2]) & (HASH_SIZE - 1);
+}
+
+// reads what BitWriter writes, for inflate
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t length) : data(data), length(length) {
+    }
+
+    uint32_t read(int count) {
+        while (used < count) {
+            if (position >= length) throw std::runtime_error("Deflate data ends early");
+            bits |= static_cast<uint64_t>(data[position++]) << used;
+            used += 8;
+        }
+        uint32_t value = static_cast<uint32_t>(bits & ((1ull << count) - 1));
+        bits >>= count;
+        used -= count;
+        return value;
+    }
+
+    void alignToByte() {
+        bits >>= used % 8;
+        used -= used % 8;
+    }
+
+private:
+    const uint8_t* data;
+    size_t length;
+    size_t position = 0;
+    uint64_t bits = 0;
+    int used = 0;
+};
+
+// canonical decoding one bit at a time like zlib's puff, symbols sorted by code length
+struct Decoder {
+    std::array<int, 16> lengthCount = {};
+    std::vector<int> symbols;
+
+    explicit Decoder(const std::vector<uint8_t>& lengths) {
+        for (uint8_t length : lengths) lengthCount[length]++;
+        lengthCount[0] = 0;
+        std::array<int, 16> offsets = {};
+        for (int bits = 1; bits < 15; ++bits) offsets[bits + 1] = offsets[bits] + lengthCount[bits];
+        symbols.resize(lengths.size());
+        for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+            if (lengths[symbol] != 0) symbols[offsets[lengths[symbol]]++] = static_cast<int>(symbol);
+        }
+    }
+
+    int decode(BitReader& reader) const {
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (int bits = 1; bits < 16; ++bits) {
+            code |= reader.read(1);
+            int count = lengthCount[bits];
+            if (code - first < count) return symbols[index + code - first];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        throw std::runtime_error("Bad Huffman code in deflate data");
+    }
+};
+
+} // namespace
+
+void deflatePiece(const uint8_t* data, size_t start, size_t end, bool last, std::vector<uint8_t>& out) {
+    std::vector<int64_t> head(HASH_SIZE, -1);
+    std::vector<int64_t> previous(DEFLATE_WINDOW, -1);
+
+    auto insert = [&](size_t position) {
+        if (position + MIN_MATCH > end) return;
+        uint32_t hash = hashAt(data + position);
+        previous[position & WINDOW_MASK] = head[hash];
+        head[hash] = static_cast<int64_t>(position);
+    };
+
+    size_t dictionary = start > DEFLATE_WINDOW ? start - DEFLATE_WINDOW : 0;
+    for (size_t position = dictionary; position < start; ++position) insert(position);
+
+    std::vector<Token> tokens;
+    tokens.reserve(std::min<size_t>(end - start, TOKENS_PER_BLOCK * 4));
+    std::vector<size_t> tokenStarts; // where each token's bytes begin, for stored blocks
+    tokenStarts.reserve(tokens.capacity());
+
+    size_t position = start;
+    while (position < end) {
+        size_t available = std::min<size_t>(end - position, MAX_MATCH);
+        tokenStarts.push_back(position);
+
+        // the flat image fast path
+        if (position > 0) {
+            uint8_t repeated = data[position - 1];
+            size_t run = 0;
+            while (run < available && data[position + run] == repeated) ++run;
+            if (run >= RUN_THRESHOLD) {
+                tokens.push_back({ static_cast<uint16_t>(run), 1 });
+                position += run;
+                insert(position - 1);
+                continue;
+            }
+        }
+
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+        if (available >= MIN_MATCH) {
+            int64_t candidate = head[hashAt(data + position)];
+            for (int chain = 0; candidate >= 0 && chain < MAX_CHAIN; ++chain) {
+                size_t distance = position - static_cast<size_t>(candidate);
+                if (distance > DEFLATE_WINDOW || static_cast<size_t>(candidate) < dictionary) break;
+
+                const uint8_t* a = data + candidate;
+                const uint8_t* b = data + position;
+                if (a[bestLength] == b[bestLength]) {
+                    size_t length = 0;
+                    while (length < available && a[length] == b[length]) ++length;
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length >= NICE_MATCH) break;
+                    }
+                }
+                candidate = previous[candidate & WINDOW_MASK];
+            }
+        }
+
+        if (bestLength >= MIN_MATCH) {
+            tokens.push_back({ static_cast<uint16_t>(bestLength), static_cast<uint16_t>(bestDistance) });
+            if (bestLength <= MAX_INSERT) {
+                for (size_t i = 0; i < bestLength; ++i) insert(position + i);
+            }
+            else {
+                insert(position);
+            }
+            position += bestLength;
+        }
+        else {
+            tokens.push_back({ data[position], 0 });
+            insert(position);
+            ++position;
+        }
+    }
+
+    BitWriter writer(out);
+    size_t blockCount = std::max<size_t>(1, (tokens.size() + TOKENS_PER_BLOCK - 1) / TOKENS_PER_BLOCK);
+    for (size_t block = 0; block < blockCount; ++block) {
+        size_t first = block * TOKENS_PER_BLOCK;
+        size_t count = std::min<size_t>(tokens.size() - std::min(first, tokens.size()), TOKENS_PER_BLOCK);
+        size_t rawStart = count > 0 ? tokenStarts[first] : end;
+        size_t rawEnd = first + count < tokens.size() ? tokenStarts[first + count] : end;
+        writeBlock(writer, tokens.data() + first, count, data + rawStart, rawEnd - rawStart, last && block + 1 == blockCount);
+    }
+
+    // an empty stored block byte aligns the piece, like a zlib sync flush
+    if (!last) {
+        writer.write(0, 3);
+        writer.alignToByte();
+        writer.write(0, 16);
+        writer.write(0xffff, 16);
+    }
+    writer.alignToByte();
+}
+
+void inflate(const uint8_t* data, size_t length, std::vector<uint8_t>& out) {
+    BitReader reader(data, length);
+    bool final = false;
+    while (!final) {
+        final = reader.read(1) != 0;
+        int type = reader.read(2);
+
+        if (type == 0) {
+            reader.alignToByte();
+            uint32_t size = reader.read(16);
+            if ((reader.read(16) ^ 0xffff) != size) throw std::runtime_error("Bad stored block in deflate data");
+            for (uint32_t i = 0; i < size; ++i) out.push_back(static_cast<uint8_t>(reader.read(8)));
+            continue;
+        }
+        if (type == 3) throw std::runtime_error("Bad block type in deflate data");
+
+        std::vector<uint8_t> literalLengths(288, 0);
+        std::vector<uint8_t> distanceLengths(DISTANCE_CODES, 0);
+        if (type == 1) {
+            // the fixed codes of RFC 1951 3.2.6
+            std::fill(literalLengths.begin(), literalLengths.begin() + 144, 8);
+            std::fill(literalLengths.begin() + 144, literalLengths.begin() + 256, 9);
+            std::fill(literalLengths.begin() + 256, literalLengths.begin() + 280, 7);
+            std::fill(literalLengths.begin() + 280, literalLengths.end(), 8);
+            std::fill(distanceLengths.begin(), distanceLengths.end(), 5);
+        }
+        else {
+            int literalCount = reader.read(5) + 257;
+            int distanceCount = reader.read(5) + 1;
+            int lengthCount = reader.read(4) + 4;
+            std::vector<uint8_t> lengthLengths(LENGTH_CODES, 0);
+            for (int i = 0; i < lengthCount; ++i) lengthLengths[LENGTH_CODE_ORDER[i]] = static_cast<uint8_t>(reader.read(3));
+            Decoder lengthDecoder(lengthLengths);
+
+            std::vector<uint8_t> allLengths;
+            while (static_cast<int>(allLengths.size()) < literalCount + distanceCount) {
+                int symbol = lengthDecoder.decode(reader);
+                if (symbol < 16) {
+                    allLengths.push_back(static_cast<uint8_t>(symbol));
+                    continue;
+                }
+                if (symbol == 16 && allLengths.empty()) throw std::runtime_error("Bad code lengths in deflate data");
+                uint8_t repeated = symbol == 16 ? allLengths.back() : 0;
+                int run = symbol == 16 ? 3 + reader.read(2) : symbol == 17 ? 3 + reader.read(3) : 11 + reader.read(7);
+                allLengths.insert(allLengths.end(), run, repeated);
+            }
+            if (static_cast<int>(allLengths.size()) != literalCount + distanceCount) throw std::runtime_error("Bad code lengths in deflate data");
+            std::copy(allLengths.begin(), allLengths.begin() + literalCount, literalLengths.begin());
+            std::copy(allLengths.begin() + literalCount, allLengths.end(), distanceLengths.begin());
+        }
+
+        Decoder literals(literalLengths);
+        Decoder distances(distanceLengths);
+        while (true) {
+            int symbol = literals.decode(reader);
+            if (symbol < 256) {
+                out.push_back(static_cast<uint8_t>(symbol));
+                continue;
+            }
+            if (symbol == 256) break;
+
+            symbol -= 257;
+            if (symbol >= 29) throw std::runtime_error("Bad length in deflate data");
+            size_t matchLength = LENGTH_BASE[symbol] + reader.read(LENGTH_EXTRA[symbol]);
+            int distanceCode = distances.decode(reader);
+            if (distanceCode >= DISTANCE_CODES) throw std::runtime_error("Bad distance in deflate data");
+            size_t distance = DISTANCE_BASE[distanceCode] + reader.read(DISTANCE_EXTRA[distanceCode]);
+            if (distance > out.size()) throw std::runtime_error("Deflate distance reaches before the data");
+
+            size_t from = out.size() - distance;
+            for (size_t i = 0; i < matchLength; ++i) out.push_back(out[from + i]);
+        }
+    }
+}
+
+uint32_t adler32(uint32_t adler, const uint8_t* data, size_t length) {
+    const uint32_t BASE = 65521;
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (length > 0) {
+        // 5552 bytes is the most that can be summed before b could overflow
+        size_t block = std::min<size_t>(length, 5552);
+        length -= block;
+        for (size_t i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        data += block;
+        a %= BASE;
+        b %= BASE;
+    }
+    return a | (b << 16);
+}
+
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondLength) {
+    const uint32_t BASE = 65521;
+    uint32_t remainder = static_cast<uint32_t>(secondLength % BASE);
+    uint32_t sum1 = first & 0xffff;
+    uint32_t sum2 = (remainder * sum1) % BASE;
+    sum1 += (second & 0xffff) + BASE - 1;
+    sum2 += ((first >> 16) & 0xffff) + ((second >> 16) & 0xffff) + BASE - remainder;
+    if (sum1 >= BASE) sum1 -= BASE;
+    if (sum1 >= BASE) sum1 -= BASE;
+    if (sum2 >= BASE * 2) sum2 -= BASE * 2;
+    if (sum2 >= BASE) sum2 -= BASE;
+    return sum1 | (sum2 << 16);
+}
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> values = {};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            values[n] = c;
+        }
+        return values;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,32 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A small DEFLATE (RFC 1951) compressor for the PNG writer. Input is compressed in independent
+// pieces the way pigz does it: every piece may match against up to 32 KB of the data before
+// it, and ends on a byte boundary with an empty stored block, so the compressed pieces are
+// simply concatenated into one stream. Runs of a repeated byte, what flat image regions
+// filter down to, are emitted as distance 1 matches without searching the hash chains.
+
+#define DEFLATE_WINDOW 32768
+
+// Compresses data[start, end) and appends it to out, data[0, start) is only the dictionary
+// and should be at most DEFLATE_WINDOW bytes. The last piece of a stream ends with the
+// final block instead of the empty stored block.
+void deflatePiece(const uint8_t* data, size_t start, size_t end, bool last, std::vector<uint8_t>& out);
+
+// Decompresses a whole raw deflate stream and appends it to out, for reading back files this
+// program wrote. Throws std::runtime_error when the data is damaged.
+void inflate(const uint8_t* data, size_t length, std::vector<uint8_t>& out);
+
+uint32_t adler32(uint32_t adler, const uint8_t* data, size_t length);
+
+// the adler32 of two pieces in a row from their own checksums, as zlib's adler32_combine
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondLength);
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length);
+
+#endif // DEFLATE_H
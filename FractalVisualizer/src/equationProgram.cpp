@@ -0,0 +1,375 @@
+#include "equationProgram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+enum EquationFunction {
+    FUNCTION_SQRT, FUNCTION_EXP, FUNCTION_LOG, FUNCTION_ABS, FUNCTION_MOD, FUNCTION_CONJ, FUNCTION_REAL, FUNCTION_IMAG,
+    FUNCTION_SIN, FUNCTION_COS, FUNCTION_TAN, FUNCTION_SINH, FUNCTION_COSH, FUNCTION_TANH,
+    FUNCTION_ASIN, FUNCTION_ACOS, FUNCTION_ATAN, FUNCTION_ASINH, FUNCTION_ACOSH, FUNCTION_ATANH
+};
+
+struct Complex {
+    double real;
+    double imag;
+};
+
+Complex multiply(Complex a, Complex b) {
+    return { a.real * b.real - a.imag * b.imag, a.real * b.imag + a.imag * b.real };
+}
+
+Complex divide(Complex a, Complex b) {
+    double d = b.real * b.real + b.imag * b.imag;
+    return { (a.real * b.real + a.imag * b.imag) / d, (a.imag * b.real - a.real * b.imag) / d };
+}
+
+// vec2 * vec2 and sqrt(vec2) in GLSL work per component, the inverse functions below rely on it
+Complex componentMultiply(Complex a, Complex b) {
+    return { a.real * b.real, a.imag * b.imag };
+}
+
+Complex componentSqrt(Complex a) {
+    return { std::sqrt(a.real), std::sqrt(a.imag) };
+}
+
+Complex complexSqrt(Complex a) {
+    double r = std::sqrt(std::hypot(a.real, a.imag));
+    double angle = std::atan2(a.imag, a.real) / 2.0;
+    return { r * std::cos(angle), r * std::sin(angle) };
+}
+
+Complex complexExp(Complex a) {
+    double scale = std::exp(a.real);
+    return { scale * std::cos(a.imag), scale * std::sin(a.imag) };
+}
+
+Complex complexLog(Complex a) {
+    return { std::log(std::hypot(a.real, a.imag)), std::atan2(a.imag, a.real) };
+}
+
+Complex complexSin(Complex a) {
+    return { std::sin(a.real) * std::cosh(a.imag), std::cos(a.real) * std::sinh(a.imag) };
+}
+
+Complex complexCos(Complex a) {
+    return { std::cos(a.real) * std::cosh(a.imag), -std::sin(a.real) * std::sinh(a.imag) };
+}
+
+Complex complexSinh(Complex a) {
+    return { std::sinh(a.real) * std::cos(a.imag), std::cosh(a.real) * std::sin(a.imag) };
+}
+
+Complex complexCosh(Complex a) {
+    return { std::cosh(a.real) * std::cos(a.imag), std::sinh(a.real) * std::sin(a.imag) };
+}
+
+Complex add(Complex a, Complex b) {
+    return { a.real + b.real, a.imag + b.imag };
+}
+
+Complex subtract(Complex a, Complex b) {
+    return { a.real - b.real, a.imag - b.imag };
+}
+
+// complex* functions of fractalFrag.frag, written the same way
+Complex applyFunction(int function, Complex a) {
+    const Complex i = { 0.0, 1.0 };
+    const Complex one = { 1.0, 0.0 };
+    const Complex minusI = { -0.0, -1.0 };
+
+    switch (function) {
+        case FUNCTION_SQRT: return complexSqrt(a);
+        case FUNCTION_EXP: return complexExp(a);
+        case FUNCTION_LOG: return complexLog(a);
+        case FUNCTION_ABS: return { std::abs(a.real), std::abs(a.imag) };
+        case FUNCTION_MOD: return { std::hypot(a.real, a.imag), 0.0 };
+        case FUNCTION_CONJ: return { a.real, -a.imag };
+        case FUNCTION_REAL: return { a.real, 0.0 };
+        case FUNCTION_IMAG: return { 0.0, a.imag };
+        case FUNCTION_SIN: return complexSin(a);
+        case FUNCTION_COS: return complexCos(a);
+        case FUNCTION_TAN: return divide(complexSin(a), complexCos(a));
+        case FUNCTION_SINH: return complexSinh(a);
+        case FUNCTION_COSH: return complexCosh(a);
+        case FUNCTION_TANH: return divide(complexSinh(a), complexCosh(a));
+        case FUNCTION_ASIN: return componentMultiply(minusI, complexLog(add(componentMultiply(i, a), complexSqrt(subtract(one, componentMultiply(a, a))))));
+        case FUNCTION_ACOS: return componentMultiply(minusI, complexLog(add(a, componentMultiply(i, complexSqrt(subtract(one, componentMultiply(a, a)))))));
+        case FUNCTION_ATAN: {
+            Complex difference = subtract(complexLog(subtract(one, componentMultiply(i, a))), complexLog(add(one, componentMultiply(i, a))));
+            return componentMultiply({ 0.0, 0.5 }, difference);
+        }
+        case FUNCTION_ASINH: return complexLog(add(a, componentSqrt(add(componentMultiply(a, a), one))));
+        case FUNCTION_ACOSH: return complexLog(add(a, componentMultiply(componentSqrt(add(a, one)), componentSqrt(subtract(a, one)))));
+        default: {
+            Complex difference = subtract(complexLog(add(one, a)), complexLog(subtract(one, a)));
+            return { 0.5 * difference.real, 0.5 * difference.imag };
+        }
+    }
+}
+
+// float overloads, only the functions that have one in the shader
+double applyScalarFunction(int function, double a) {
+    switch (function) {
+        case FUNCTION_SQRT: return std::sqrt(a);
+        case FUNCTION_EXP: return std::exp(a);
+        case FUNCTION_LOG: return std::log(a);
+        case FUNCTION_ABS: return std::abs(a);
+        case FUNCTION_SIN: return std::sin(a);
+        case FUNCTION_COS: return std::cos(a);
+        case FUNCTION_TAN: return std::tan(a);
+        case FUNCTION_SINH: return std::sinh(a);
+        case FUNCTION_COSH: return std::cosh(a);
+        case FUNCTION_TANH: return std::tanh(a);
+        case FUNCTION_ASIN: return std::asin(a);
+        case FUNCTION_ACOS: return std::acos(a);
+        case FUNCTION_ATAN: return std::atan(a);
+        case FUNCTION_ASINH: return std::asinh(a);
+        case FUNCTION_ACOSH: return std::acosh(a);
+        default: return std::atanh(a);
+    }
+}
+
+const ExpressionNode& stripParentheses(const ExpressionNode& node) {
+    return node.type == ExpressionNode::Parentheses ? stripParentheses(node.children[0]) : node;
+}
+
+// literals without a decimal point are ints in GLSL, z^2 calls the repeated multiplication overload
+bool isIntegerLiteral(const ExpressionNode& node) {
+    const ExpressionNode& inner = stripParentheses(node);
+    return inner.type == ExpressionNode::Number && inner.value.find('.') == std::string::npos;
+}
+
+} // namespace
+
+EquationProgram::EquationProgram(const std::string& equation) {
+    ComplexExpressionParser parser;
+    *this = EquationProgram(parser.parse(equation));
+}
+
+EquationProgram::EquationProgram(const ExpressionNode& root) {
+    if (compile(root, 0)) {
+        throw std::runtime_error("Equation must depend on z, c or a variable");
+    }
+}
+
+bool EquationProgram::compile(const ExpressionNode& node, int depth) {
+    if (depth >= MAX_STACK) {
+        throw std::runtime_error("Equation is nested too deeply");
+    }
+
+    switch (node.type) {
+        case ExpressionNode::Number: {
+            Instruction instruction = { Op::PushNumber };
+            instruction.number = std::stod(node.value);
+            instructions.push_back(instruction);
+            return true;
+        }
+
+        case ExpressionNode::Variable: {
+            if (node.value == "z") {
+                instructions.push_back({ Op::PushZ });
+                return false;
+            }
+            if (node.value == "c") {
+                instructions.push_back({ Op::PushC });
+                return false;
+            }
+            if (node.value == "dz") {
+                instructions.push_back({ Op::PushDz });
+                return false;
+            }
+            if (node.value == "dc") {
+                instructions.push_back({ Op::PushOne });
+                return false;
+            }
+
+            Instruction instruction = { Op::PushVariable };
+            auto it = std::find(variableNames.begin(), variableNames.end(), node.value);
+            instruction.index = static_cast<int>(it - variableNames.begin());
+            if (it == variableNames.end()) {
+                variableNames.push_back(node.value);
+                variableValues.push_back(0.0);
+                variableValues.push_back(0.0);
+            }
+            instructions.push_back(instruction);
+            return false;
+        }
+
+        case ExpressionNode::Parentheses:
+            return compile(node.children[0], depth);
+
+        case ExpressionNode::Function: {
+            static const std::unordered_map<std::string, EquationFunction> functions = {
+                {"sqrt", FUNCTION_SQRT}, {"exp", FUNCTION_EXP}, {"log", FUNCTION_LOG}, {"ln", FUNCTION_LOG},
+                {"abs", FUNCTION_ABS}, {"mod", FUNCTION_MOD}, {"conj", FUNCTION_CONJ},
+                {"real", FUNCTION_REAL}, {"imag", FUNCTION_IMAG},
+                {"sin", FUNCTION_SIN}, {"cos", FUNCTION_COS}, {"tan", FUNCTION_TAN},
+                {"sinh", FUNCTION_SINH}, {"cosh", FUNCTION_COSH}, {"tanh", FUNCTION_TANH},
+                {"asin", FUNCTION_ASIN}, {"acos", FUNCTION_ACOS}, {"atan", FUNCTION_ATAN},
+                {"asinh", FUNCTION_ASINH}, {"acosh", FUNCTION_ACOSH}, {"atanh", FUNCTION_ATANH}
+            };
+
+            auto it = functions.find(node.value);
+            if (it == functions.end()) {
+                throw std::runtime_error("Unknown function: " + node.value);
+            }
+
+            bool scalar = compile(node.children[0], depth);
+            EquationFunction function = it->second;
+
+            // mod, conj, real and imag only have vec2 versions
+            if (function == FUNCTION_MOD || function == FUNCTION_CONJ || function == FUNCTION_REAL || function == FUNCTION_IMAG) {
+                scalar = false;
+            }
+
+            Instruction instruction = { Op::Function, scalar };
+            instruction.index = function;
+            instructions.push_back(instruction);
+            return scalar;
+        }
+
+        default: {
+            const ExpressionNode& right = node.children[1];
+            bool leftScalar = compile(node.children[0], depth);
+
+            if (node.value == "^" && !leftScalar && isIntegerLiteral(right)) {
+                Instruction instruction = { Op::PowerInteger };
+                instruction.number = std::stod(stripParentheses(right).value);
+                instructions.push_back(instruction);
+                return false;
+            }
+
+            bool rightScalar = compile(right, depth + 1);
+
+            Op op = Op::Add;
+            if (node.value == "-") op = Op::Subtract;
+            else if (node.value == "*") op = Op::Multiply;
+            else if (node.value == "/") op = Op::Divide;
+            else if (node.value == "^") op = Op::Power;
+
+            instructions.push_back({ op, leftScalar, rightScalar });
+            return leftScalar && rightScalar;
+        }
+    }
+}
+
+void EquationProgram::setVariable(const std::string& name, double real, double imag) {
+    auto it = std::find(variableNames.begin(), variableNames.end(), name);
+    if (it == variableNames.end()) return;
+
+    size_t index = (it - variableNames.begin()) * 2;
+    variableValues[index] = real;
+    variableValues[index + 1] = imag;
+}
+
+void EquationProgram::evaluate(double zReal, double zImag, double cReal, double cImag, double& outReal, double& outImag) const {
+    evaluate(zReal, zImag, cReal, cImag, 0.0, 0.0, outReal, outImag);
+}
+
+void EquationProgram::evaluate(double zReal, double zImag, double cReal, double cImag, double dzReal, double dzImag, double& outReal, double& outImag) const {
+    // floats are kept with a zero imaginary part
+    Complex stack[MAX_STACK];
+    int top = -1;
+
+    for (const Instruction& instruction : instructions) {
+        switch (instruction.op) {
+            case Op::PushNumber:
+                stack[++top] = { instruction.number, 0.0 };
+                break;
+
+            case Op::PushZ:
+                stack[++top] = { zReal, zImag };
+                break;
+
+            case Op::PushC:
+                stack[++top] = { cReal, cImag };
+                break;
+
+            case Op::PushDz:
+                stack[++top] = { dzReal, dzImag };
+                break;
+
+            case Op::PushOne:
+                stack[++top] = { 1.0, 0.0 };
+                break;
+
+            case Op::PushVariable:
+                stack[++top] = { variableValues[instruction.index * 2], variableValues[instruction.index * 2 + 1] };
+                break;
+
+            case Op::PowerInteger: {
+                Complex result = { 1.0, 0.0 };
+                for (int i = 0; i < static_cast<int>(instruction.number); ++i) result = multiply(result, stack[top]);
+                stack[top] = result;
+                break;
+            }
+
+            case Op::Function: {
+                Complex& a = stack[top];
+                a = instruction.leftScalar
+                    ? Complex{ applyScalarFunction(instruction.index, a.real), 0.0 }
+                    : applyFunction(instruction.index, a);
+                break;
+            }
+
+            default: {
+                Complex b = stack[top--];
+                Complex& a = stack[top];
+
+                switch (instruction.op) {
+                    // a float added to a vec2 goes to both components
+                    case Op::Add:
+                        if (instruction.leftScalar && !instruction.rightScalar) a = { a.real + b.real, a.real + b.imag };
+                        else if (instruction.rightScalar && !instruction.leftScalar) a = { a.real + b.real, a.imag + b.real };
+                        else a = add(a, b);
+                        break;
+
+                    case Op::Subtract:
+                        if (instruction.leftScalar && !instruction.rightScalar) a = { a.real - b.real, a.real - b.imag };
+                        else if (instruction.rightScalar && !instruction.leftScalar) a = { a.real - b.real, a.imag - b.real };
+                        else a = subtract(a, b);
+                        break;
+
+                    case Op::Multiply:
+                        if (instruction.leftScalar) a = { a.real * b.real, a.real * b.imag };
+                        else if (instruction.rightScalar) a = { a.real * b.real, a.imag * b.real };
+                        else a = multiply(a, b);
+                        break;
+
+                    case Op::Divide:
+                        if (instruction.rightScalar && !instruction.leftScalar) a = { a.real / b.real, a.imag / b.real };
+                        else if (instruction.leftScalar && instruction.rightScalar) a = { a.real / b.real, 0.0 };
+                        else a = divide(a, b);
+                        break;
+
+                    default: // Power
+                        if (instruction.leftScalar && instruction.rightScalar) {
+                            a = { std::pow(a.real, b.real), 0.0 };
+                        }
+                        else if (instruction.rightScalar) {
+                            double r = std::pow(std::hypot(a.real, a.imag), b.real);
+                            double theta = std::atan2(a.imag, a.real);
+                            a = { r * std::cos(b.real * theta), r * std::sin(b.real * theta) };
+                        }
+                        else if (instruction.leftScalar) {
+                            double logN = std::log(a.real);
+                            double scale = std::exp(b.real * logN);
+                            a = { scale * std::cos(b.imag * logN), scale * std::sin(b.imag * logN) };
+                        }
+                        else {
+                            a = complexExp(multiply(b, complexLog(a)));
+                        }
+                        break;
+                }
+                break;
+            }
+        }
+    }
+
+    outReal = stack[0].real;
+    outImag = stack[0].imag;
+}
@@ -0,0 +1,56 @@
+#ifndef EQUATION_PROGRAM_H
+#define EQUATION_PROGRAM_H
+
+#include <string>
+#include <vector>
+
+#include "complexParser.h"
+
+// A parsed equation compiled to a small stack program so the CPU renderers can evaluate
+// customEquation(z, c) without a shader. Types follow the GLSL translation: number literals
+// are floats, z, c and custom variables are vec2, and operators pick the same overloads
+// as in fractalFrag.frag, including integer powers and float + vec2 adding to both components.
+
+class EquationProgram {
+public:
+    EquationProgram() = default;
+
+    // throws std::runtime_error for equations the shader wouldn't compile either
+    explicit EquationProgram(const std::string& equation);
+    explicit EquationProgram(const ExpressionNode& root);
+
+    // custom variables are uniforms in the shader and start at zero here too
+    void setVariable(const std::string& name, double real, double imag);
+
+    void evaluate(double zReal, double zImag, double cReal, double cImag, double& outReal, double& outImag) const;
+
+    // for programs compiled from ComplexExpressionParser::derivative, which also read dz and dc
+    void evaluate(double zReal, double zImag, double cReal, double cImag, double dzReal, double dzImag, double& outReal, double& outImag) const;
+
+private:
+    enum class Op {
+        PushNumber, PushZ, PushC, PushDz, PushOne, PushVariable,
+        Add, Subtract, Multiply, Divide,
+        PowerInteger, Power,
+        Function
+    };
+
+    struct Instruction {
+        Op op;
+        bool leftScalar = false; // for functions, the argument
+        bool rightScalar = false;
+        double number = 0.0; // literal value, or the exponent of PowerInteger
+        int index = 0; // variable slot or function
+    };
+
+    static constexpr int MAX_STACK = 64;
+
+    std::vector<Instruction> instructions;
+    std::vector<std::string> variableNames;
+    std::vector<double> variableValues; // real, imag pairs
+
+    // returns true when the node evaluates to a float in GLSL
+    bool compile(const ExpressionNode& node, int depth);
+};
+
+#endif // EQUATION_PROGRAM_H
@@ -0,0 +1,52 @@
+#ifndef ESCAPE_TIME_H
+#define ESCAPE_TIME_H
+
+#include <algorithm>
+#include <cmath>
+
+// Pieces of getSmoothIterations in fractalFrag.frag shared by the CPU renderers
+
+#define LOG2 0.69314718055994530941723212145818
+
+inline double getEscapeIterations(int n, double magnitudeSq) {
+    double logZn = std::log(magnitudeSq) / 2.0;
+    double nu = std::log(logZn / LOG2) / LOG2;
+    return n + 1.0 - nu;
+}
+
+// |z_n+1 - z_n| below which an orbit counts as settled on a root
+#define CONVERGENCE_EPSILON 1e-5
+
+// Smooth count for converging orbits, how far between the last two steps
+// log|z_n+1 - z_n| crossed log(epsilon)
+inline double getConvergenceIterations(int n, double stepSq, double previousStepSq) {
+    double logEpsilon = std::log(CONVERGENCE_EPSILON * CONVERGENCE_EPSILON);
+    double logStep = std::log(stepSq);
+    double logPrevious = std::log(previousStepSq);
+    if (!(logPrevious > logStep)) return n;
+    double t = (logEpsilon - logPrevious) / (logStep - logPrevious);
+    return n - 1.0 + std::clamp(t, 0.0, 1.0);
+}
+
+// |z|^2 the orbit is followed to when estimating distance, the estimate is only good for large |z|
+#define DISTANCE_BAILOUT 1e6
+
+// 0.5 |z| log|z| / |dz| in pixels, on the iteration scale so the coloring stays the same:
+// 0 on the boundary up to just under iterations at range pixels and farther
+inline double getDistanceIterations(double magnitudeSq, double derivativeSq, double pixelSize, double range, int iterations) {
+    double distance = 0.25 * std::sqrt(magnitudeSq / derivativeSq) * std::log(magnitudeSq);
+    return std::clamp(distance / (pixelSize * range), 0.0, 0.999) * iterations;
+}
+
+// Closed form membership of the main cardioid and the period 2 bulb of z^2 + c
+inline bool isInMainCardioidOrBulb(double real, double imag) {
+    double imagSq = imag * imag;
+    double shifted = real - 0.25;
+    double q = shifted * shifted + imagSq;
+    if (q * (q + shifted) <= 0.25 * imagSq) return true;
+
+    double bulb = real + 1.0;
+    return bulb * bulb + imagSq <= 0.0625;
+}
+
+#endif // ESCAPE_TIME_H
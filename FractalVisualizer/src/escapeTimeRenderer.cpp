@@ -0,0 +1,684 @@
+#include "escapeTimeRenderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+#include "escapeTime.h"
+#include "parallelFor.h"
+
+namespace {
+
+using Tile = TiledFramebuffer::Tile;
+
+// subdivision and boundary tracing work on 2x2 framebuffer tiles, four neighbouring Morton slots
+const int FILL_TILE_SIZE = TiledFramebuffer::TILE_SIZE * 2;
+
+// rectangles this thin are cheaper to iterate than to split again
+const int SUBDIVISION_MIN_SIZE = 6;
+
+// spacing of the first grid solid guessing iterates, halved every pass down to single pixels
+const int SOLID_GUESSING_STEP = 8;
+
+float evaluatePixel(const EscapeTimeKernel& kernel, TiledFramebuffer& image, int x, int y, size_t index) {
+    double finalReal, finalImag;
+    bool periodic = false;
+    float value = kernel.evaluate(x, y, finalReal, finalImag, &periodic);
+    image.smoothIterations[index] = value;
+    image.finalReal[index] = static_cast<float>(finalReal);
+    image.finalImag[index] = static_cast<float>(finalImag);
+    image.periodic[index] = periodic;
+    return value;
+}
+
+// filled and guessed pixels take z from the pixel their value came from
+void copyPixel(TiledFramebuffer& image, size_t to, size_t from) {
+    image.smoothIterations[to] = image.smoothIterations[from];
+    image.finalReal[to] = image.finalReal[from];
+    image.finalImag[to] = image.finalImag[from];
+    image.periodic[to] = image.periodic[from];
+}
+
+// pixels marked like the shader's alpha 0, filled pixels count with the pixel they came from
+int countPeriodicPixels(const TiledFramebuffer& image) {
+    return static_cast<int>(std::count(image.periodic.begin(), image.periodic.end(), 1));
+}
+
+// Mariani-Silver subdivision. A border at the iteration limit only encloses the set when every
+// pixel of it was proven interior by the periodicity check or the cardioid test, pixels that
+// merely ran out of iterations can have escaping pixels between them.
+class Subdivision {
+public:
+    Subdivision(const EscapeTimeKernel& kernel, TiledFramebuffer& image, std::vector<char>& known, int iterations)
+        : kernel(kernel), image(image), known(known), limit(static_cast<float>(iterations)) {
+    }
+
+    int evaluatedPixels = 0;
+
+    // x1 and y1 are inclusive, neighbouring rectangles share their edge
+    void rectangle(int x0, int y0, int x1, int y1) {
+        float value = at(x0, y0);
+        bool uniform = true;
+        for (int x = x0; x <= x1; ++x) {
+            uniform &= matches(x, y0, value);
+            uniform &= matches(x, y1, value);
+        }
+        for (int y = y0 + 1; y < y1; ++y) {
+            uniform &= matches(x0, y, value);
+            uniform &= matches(x1, y, value);
+        }
+
+        if (uniform) {
+            size_t corner = image.index(x0, y0);
+            for (int y = y0 + 1; y < y1; ++y) {
+                for (int x = x0 + 1; x < x1; ++x) {
+                    size_t index = image.index(x, y);
+                    copyPixel(image, index, corner);
+                    known[index] = 1;
+                }
+            }
+            return;
+        }
+
+        if (x1 - x0 <= SUBDIVISION_MIN_SIZE || y1 - y0 <= SUBDIVISION_MIN_SIZE) {
+            for (int y = y0 + 1; y < y1; ++y) {
+                for (int x = x0 + 1; x < x1; ++x) at(x, y);
+            }
+            return;
+        }
+
+        if (x1 - x0 >= y1 - y0) {
+            int middle = (x0 + x1) / 2;
+            rectangle(x0, y0, middle, y1);
+            rectangle(middle, y0, x1, y1);
+        }
+        else {
+            int middle = (y0 + y1) / 2;
+            rectangle(x0, y0, x1, middle);
+            rectangle(x0, middle, x1, y1);
+        }
+    }
+
+private:
+    const EscapeTimeKernel& kernel;
+    TiledFramebuffer& image;
+    std::vector<char>& known;
+    float limit;
+
+    bool matches(int x, int y, float value) {
+        if (at(x, y) != value) return false;
+        return value < limit || image.periodic[image.index(x, y)] || kernel.skipsPixel(x, y);
+    }
+
+    float at(int x, int y) {
+        size_t index = image.index(x, y);
+        if (!known[index]) {
+            evaluatePixel(kernel, image, x, y, index);
+            known[index] = 1;
+            ++evaluatedPixels;
+        }
+        return image.smoothIterations[index];
+    }
+};
+
+// Fractint style successive refinement. Each pass fills the pixels halfway between the points
+// of the previous grid, a pixel is only iterated when the corners of its grid cell fall in
+// different iteration bands, otherwise it is interpolated from them. Tiles start on a multiple
+// of every cell size, so each pass runs tile by tile and only reads corners of earlier passes.
+int solidGuessing(const EscapeTimeSettings& settings, const EscapeTimeKernel& kernel, TiledFramebuffer& image, std::vector<char>& guessed) {
+    const int width = settings.width;
+    const int height = settings.height;
+    std::atomic<int> evaluatedPixels = 0;
+
+    parallelFor(image.getTileCount(), settings.threadCount, [&](int begin, int end) {
+        int evaluated = 0;
+        for (int slot = begin; slot < end; ++slot) {
+            const Tile& tile = image.getTile(slot);
+            for (int y = tile.y0; y < tile.y0 + tile.height; y += SOLID_GUESSING_STEP) {
+                for (int x = tile.x0; x < tile.x0 + tile.width; x += SOLID_GUESSING_STEP) {
+                    evaluatePixel(kernel, image, x, y, image.index(x, y));
+                    ++evaluated;
+                }
+            }
+        }
+        evaluatedPixels += evaluated;
+    });
+
+    for (int step = SOLID_GUESSING_STEP / 2; step >= 1; step /= 2) {
+        const int cell = step * 2;
+
+        parallelFor(image.getTileCount(), settings.threadCount, [&](int begin, int end) {
+            int evaluated = 0;
+            for (int slot = begin; slot < end; ++slot) {
+                const Tile& tile = image.getTile(slot);
+                for (int y = tile.y0; y < tile.y0 + tile.height; y += step) {
+                    bool onPreviousRow = y % cell == 0;
+
+                    // rows of the previous grid only miss every other pixel
+                    for (int x = tile.x0 + (onPreviousRow ? step : 0); x < tile.x0 + tile.width; x += onPreviousRow ? cell : step) {
+                        int x0 = x - x % cell;
+                        int y0 = y - y % cell;
+                        int x1 = x0 + cell < width && x != x0 ? x0 + cell : x0;
+                        int y1 = y0 + cell < height && y != y0 ? y0 + cell : y0;
+
+                        size_t topLeftIndex = image.index(x0, y0);
+                        float topLeft = image.smoothIterations[topLeftIndex];
+                        float topRight = image.smoothIterations[image.index(x1, y0)];
+                        float bottomLeft = image.smoothIterations[image.index(x0, y1)];
+                        float bottomRight = image.smoothIterations[image.index(x1, y1)];
+
+                        size_t index = image.index(x, y);
+                        float band = std::floor(topLeft);
+                        if (band != std::floor(topRight) || band != std::floor(bottomLeft) || band != std::floor(bottomRight)) {
+                            evaluatePixel(kernel, image, x, y, index);
+                            ++evaluated;
+                            continue;
+                        }
+
+                        guessed[index] = 1;
+                        copyPixel(image, index, topLeftIndex);
+                        if (topLeft == topRight && topLeft == bottomLeft && topLeft == bottomRight) {
+                            continue;
+                        }
+
+                        double fractionX = x1 != x0 ? static_cast<double>(x - x0) / cell : 0.0;
+                        double fractionY = y1 != y0 ? static_cast<double>(y - y0) / cell : 0.0;
+                        double top = topLeft + (topRight - topLeft) * fractionX;
+                        double bottom = bottomLeft + (bottomRight - bottomLeft) * fractionX;
+                        image.smoothIterations[index] = static_cast<float>(top + (bottom - top) * fractionY);
+                    }
+                }
+            }
+            evaluatedPixels += evaluated;
+        });
+    }
+
+    return evaluatedPixels;
+}
+
+// Traces the edges between regions of equal value. Each tile's border is iterated first, and
+// every iterated pixel that differs from an iterated neighbour queues the unknown neighbours of
+// both, so iteration spreads along the boundaries only; pairs across tile borders are compared
+// afterwards and traced on from there. Pixels at the iteration limit that neither the
+// periodicity check nor the cardioid test proved interior differ from everything, since
+// escaping pixels next to them may be cut off from the rest. Whatever is left unknown is filled
+// region by region, once every pixel around the region is checked to have one value.
+class BoundaryTracing {
+public:
+    BoundaryTracing(const EscapeTimeKernel& kernel, TiledFramebuffer& image, std::vector<char>& state, int iterations)
+        : kernel(kernel), image(image), state(state), limit(static_cast<float>(iterations)) {
+    }
+
+    int evaluatedPixels = 0;
+
+    // x1 and y1 are inclusive, tiles only trace inside themselves so they can run in parallel
+    void traceTile(int x0, int y0, int x1, int y1) {
+        setBounds(x0, y0, x1, y1);
+        for (int x = x0; x <= x1; ++x) {
+            enqueue(x, y0);
+            enqueue(x, y1);
+        }
+        for (int y = y0 + 1; y < y1; ++y) {
+            enqueue(x0, y);
+            enqueue(x1, y);
+        }
+        drain();
+    }
+
+    // after every tile, with the whole image as bounds
+    void traceSeams(int tileSize) {
+        int width = image.getWidth();
+        int height = image.getHeight();
+        setBounds(0, 0, width - 1, height - 1);
+        for (int x = tileSize; x < width; x += tileSize) {
+            for (int y = 0; y < height; ++y) {
+                for (int dy = -1; dy <= 1; ++dy) compare(x - 1, y, x, y + dy);
+            }
+        }
+        for (int y = tileSize; y < height; y += tileSize) {
+            for (int x = 0; x < width; ++x) {
+                for (int dx = -1; dx <= 1; ++dx) compare(x, y - 1, x + dx, y);
+            }
+        }
+        drain();
+    }
+
+    // Unknown regions never touch a tile border, so tiles fill in parallel. A region whose
+    // surrounding pixels don't share a value has an edge inside, its pixels next to them are
+    // iterated and traced on from, and what is still unknown is filled as the scan reaches it.
+    void fillTile(int x0, int y0, int x1, int y1) {
+        setBounds(x0, y0, x1, y1);
+        for (int y = y0 + 1; y < y1; ++y) {
+            for (int x = x0 + 1; x < x1; ++x) {
+                if (state[image.index(x, y)] == UNKNOWN) fillRegion(x, y);
+            }
+        }
+    }
+
+private:
+    // BOUNDARY pixels are done and have queued their neighbours already, REGION marks the
+    // pixels of the region being filled
+    enum PixelState : char { UNKNOWN = 0, QUEUED = 1, DONE = 2, BOUNDARY = 3, REGION = 4 };
+
+    const EscapeTimeKernel& kernel;
+    TiledFramebuffer& image;
+    std::vector<char>& state;
+    float limit;
+    std::vector<std::pair<int, int>> queue;
+    std::vector<std::pair<int, int>> region;
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    void setBounds(int left, int bottom, int right, int top) {
+        x0 = left;
+        y0 = bottom;
+        x1 = right;
+        y1 = top;
+    }
+
+    bool inBounds(int x, int y) const {
+        return x >= x0 && x <= x1 && y >= y0 && y <= y1;
+    }
+
+    bool isDone(size_t index) const {
+        return state[index] == DONE || state[index] == BOUNDARY;
+    }
+
+    // a pixel at the limit is only settled when something proved it interior
+    bool isSettled(size_t index, int x, int y) const {
+        return image.smoothIterations[index] < limit || image.periodic[index] || kernel.skipsPixel(x, y);
+    }
+
+    bool differs(size_t index, int x, int y, size_t other, int otherX, int otherY) const {
+        return image.smoothIterations[index] != image.smoothIterations[other] || !isSettled(index, x, y) || !isSettled(other, otherX, otherY);
+    }
+
+    void enqueue(int x, int y) {
+        if (!inBounds(x, y)) return;
+        size_t index = image.index(x, y);
+        if (state[index] != UNKNOWN) return;
+        state[index] = QUEUED;
+        queue.push_back({ x, y });
+    }
+
+    void drain() {
+        while (!queue.empty()) {
+            auto [x, y] = queue.back();
+            queue.pop_back();
+            trace(x, y);
+        }
+    }
+
+    void markBoundary(int x, int y) {
+        size_t index = image.index(x, y);
+        if (state[index] == BOUNDARY) return;
+        state[index] = BOUNDARY;
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) enqueue(x + dx, y + dy);
+        }
+    }
+
+    void compare(int x, int y, int otherX, int otherY) {
+        if (!inBounds(x, y) || !inBounds(otherX, otherY)) return;
+        size_t index = image.index(x, y);
+        size_t other = image.index(otherX, otherY);
+        if (isDone(index) && isDone(other) && differs(index, x, y, other, otherX, otherY)) {
+            markBoundary(x, y);
+            markBoundary(otherX, otherY);
+        }
+    }
+
+    void trace(int x, int y) {
+        size_t index = image.index(x, y);
+        evaluatePixel(kernel, image, x, y, index);
+        state[index] = DONE;
+        ++evaluatedPixels;
+
+        // 8 neighbours, so regions touching only at a corner are still told apart
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                if (dx != 0 || dy != 0) compare(x, y, x + dx, y + dy);
+            }
+        }
+        if (!isSettled(index, x, y)) markBoundary(x, y);
+    }
+
+    void fillRegion(int startX, int startY) {
+        region.clear();
+        region.push_back({ startX, startY });
+        state[image.index(startX, startY)] = REGION;
+
+        size_t source = 0;
+        int sourceX = 0, sourceY = 0;
+        bool found = false;
+        bool uniform = true;
+        for (size_t i = 0; i < region.size(); ++i) {
+            auto [x, y] = region[i];
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int nx = x + dx;
+                    int ny = y + dy;
+                    if (!inBounds(nx, ny)) continue;
+                    size_t neighbour = image.index(nx, ny);
+                    if (state[neighbour] == UNKNOWN) {
+                        state[neighbour] = REGION;
+                        region.push_back({ nx, ny });
+                    }
+                    else if (isDone(neighbour)) {
+                        if (!found) {
+                            source = neighbour;
+                            sourceX = nx;
+                            sourceY = ny;
+                            found = true;
+                        }
+                        uniform = uniform && !differs(source, sourceX, sourceY, neighbour, nx, ny);
+                    }
+                }
+            }
+        }
+
+        if (found && uniform) {
+            for (auto [x, y] : region) {
+                size_t index = image.index(x, y);
+                copyPixel(image, index, source);
+                state[index] = DONE;
+            }
+            return;
+        }
+
+        for (auto [x, y] : region) state[image.index(x, y)] = UNKNOWN;
+        for (auto [x, y] : region) {
+            bool edge = false;
+            for (int dy = -1; dy <= 1 && !edge; ++dy) {
+                for (int dx = -1; dx <= 1 && !edge; ++dx) {
+                    edge = inBounds(x + dx, y + dy) && isDone(image.index(x + dx, y + dy));
+                }
+            }
+            if (edge) enqueue(x, y);
+        }
+        drain();
+    }
+};
+
+} // namespace
+
+CompiledEquation::CompiledEquation(const std::string& equation, bool withDerivative)
+    : equation(equation), hasDerivative(withDerivative) {
+    ComplexExpressionParser parser;
+    ExpressionNode root = parser.parse(equation);
+    program = EquationProgram(root);
+    if (withDerivative) {
+        derivativeProgram = EquationProgram(ComplexExpressionParser::derivative(root));
+    }
+    traits = analyzeEquation(equation);
+}
+
+EscapeTimeKernel::EscapeTimeKernel(const EscapeTimeSettings& settings)
+    : settings(settings) {
+    std::shared_ptr<const CompiledEquation> compiled = settings.compiledEquation;
+    if (!compiled || compiled->equation != settings.equation || (settings.distanceEstimation && !compiled->hasDerivative)) {
+        compiled = std::make_shared<CompiledEquation>(settings.equation, settings.distanceEstimation);
+    }
+    program = compiled->program;
+    derivativeProgram = compiled->derivativeProgram;
+    traits = compiled->traits;
+
+    for (const auto& [name, value] : settings.variables) {
+        program.setVariable(name, value.first, value.second);
+        derivativeProgram.setVariable(name, value.first, value.second);
+    }
+
+    imageWidth = settings.imageWidth > 0 ? settings.imageWidth : settings.width;
+    imageHeight = settings.imageHeight > 0 ? settings.imageHeight : settings.height;
+
+    // same tolerance as the GPU shader, 1/1024 of a pixel
+    pixelSize = settings.zoom * 2.0 / std::max(imageHeight, 1.0);
+    double tolerance = pixelSize / 1024.0;
+    periodicityToleranceSq = tolerance * tolerance;
+}
+
+float EscapeTimeKernel::evaluate(int x, int y) const {
+    double finalReal, finalImag;
+    return evaluate(x, y, finalReal, finalImag);
+}
+
+void EscapeTimeKernel::pixelConstant(int x, int y, double& real, double& imag) const {
+    real = (((x + settings.originX + 0.5) / imageWidth - 0.5) * settings.zoom + settings.centerX) * 2.0;
+    imag = (((y + settings.originY + 0.5) / imageHeight - 0.5) * settings.zoom + settings.centerY) * 2.0;
+}
+
+float EscapeTimeKernel::evaluate(int x, int y, double& finalReal, double& finalImag, bool* periodic) const {
+    double real, imag;
+    pixelConstant(x, y, real, imag);
+    return evaluatePoint(real, imag, finalReal, finalImag, periodic);
+}
+
+bool EscapeTimeKernel::skipsPixel(int x, int y) const {
+    double real, imag;
+    pixelConstant(x, y, real, imag);
+    return traits.isQuadraticMandelbrot && isInMainCardioidOrBulb(real, imag);
+}
+
+float EscapeTimeKernel::evaluatePoint(double constReal, double constImag, double& finalReal, double& finalImag, bool* periodic) const {
+    double real = constReal;
+    double imag = constImag;
+
+    // every return leaves z where the loop stopped
+    auto finish = [&](double value) {
+        finalReal = real;
+        finalImag = imag;
+        return static_cast<float>(value);
+    };
+
+    if (traits.isQuadraticMandelbrot && isInMainCardioidOrBulb(constReal, constImag)) {
+        return finish(settings.iterations);
+    }
+
+    double savedReal = real;
+    double savedImag = imag;
+    int checkLength = settings.periodicityInterval;
+    int checkCounter = 0;
+
+    double previousStepSq = 0.0;
+
+    // dz/dc starts at 1 because z starts at the pixel
+    double derivativeReal = 1.0;
+    double derivativeImag = 0.0;
+    double escapedDistance = -1.0;
+    const double farDistance = 0.999 * settings.iterations;
+
+    for (int n = 0; n < settings.iterations; ) {
+        double magnitudeSq = real * real + imag * imag;
+        if (magnitudeSq > settings.escapeRadius) {
+            if (!settings.distanceEstimation) {
+                return finish(getEscapeIterations(n, magnitudeSq));
+            }
+
+            // far pixels are already past the range, only pixels near the boundary iterate on to the larger bailout
+            double derivativeSq = derivativeReal * derivativeReal + derivativeImag * derivativeImag;
+            escapedDistance = getDistanceIterations(magnitudeSq, derivativeSq, pixelSize, settings.distanceRange, settings.iterations);
+            if (escapedDistance >= farDistance || magnitudeSq > DISTANCE_BAILOUT) {
+                return finish(escapedDistance);
+            }
+        }
+
+        double lastReal = real;
+        double lastImag = imag;
+        if (settings.distanceEstimation) {
+            derivativeProgram.evaluate(real, imag, constReal, constImag, derivativeReal, derivativeImag, derivativeReal, derivativeImag);
+        }
+        program.evaluate(real, imag, constReal, constImag, real, imag);
+        ++n;
+
+        if (traits.converges) {
+            double stepReal = real - lastReal;
+            double stepImag = imag - lastImag;
+            double stepSq = stepReal * stepReal + stepImag * stepImag;
+            if (stepSq < CONVERGENCE_EPSILON * CONVERGENCE_EPSILON) {
+                return finish(getConvergenceIterations(n, stepSq, previousStepSq));
+            }
+            previousStepSq = stepSq;
+        }
+
+        // inf and nan never compare greater than the escape radius, stop on them as escaped
+        if (traits.canOverflow && !(std::isfinite(real) && std::isfinite(imag))) {
+            if (settings.distanceEstimation) return finish(escapedDistance >= 0.0 ? escapedDistance : farDistance);
+            return finish(n);
+        }
+
+        if (settings.periodicityInterval > 0) {
+            double differenceReal = real - savedReal;
+            double differenceImag = imag - savedImag;
+            if (differenceReal * differenceReal + differenceImag * differenceImag < periodicityToleranceSq) {
+                if (periodic) *periodic = true;
+                return finish(settings.iterations);
+            }
+            if (++checkCounter == checkLength) {
+                savedReal = real;
+                savedImag = imag;
+                checkCounter = 0;
+                checkLength *= 2;
+            }
+        }
+    }
+
+    // escaped but ran out of iterations before the distance bailout
+    if (escapedDistance >= 0.0) return finish(escapedDistance);
+    return finish(settings.iterations);
+}
+
+FillMode selectFillMode(FillMode requested, const EquationTraits& traits) {
+    if (requested == FillMode::Automatic || requested == FillMode::Subdivision) {
+        return traits.hasConnectedLevelSets ? FillMode::Subdivision : FillMode::BruteForce;
+    }
+    return requested;
+}
+
+const char* fillModeName(FillMode mode) {
+    switch (mode) {
+        case FillMode::Subdivision: return "subdivision";
+        case FillMode::SolidGuessing: return "solid guessing";
+        case FillMode::BoundaryTracing: return "boundary tracing";
+        default: return "brute force";
+    }
+}
+
+void renderEscapeTime(const EscapeTimeSettings& settings, TiledFramebuffer& image, FrameStatistics& statistics, std::vector<char>* guessedPixels) {
+    auto frameStart = std::chrono::steady_clock::now();
+
+    EscapeTimeKernel kernel(settings);
+
+    statistics = FrameStatistics();
+    image.resize(settings.width, settings.height);
+    size_t storage = image.smoothIterations.size();
+    if (guessedPixels) guessedPixels->assign(storage, 0);
+    int pixelCount = image.getWidth() * image.getHeight();
+    if (pixelCount <= 0) return;
+
+    FillMode mode = selectFillMode(settings.fillMode, kernel.getTraits());
+    statistics.fillMode = fillModeName(mode);
+
+    std::atomic<int> evaluatedPixels = 0;
+
+    if (mode == FillMode::Subdivision) {
+        std::vector<char> known(storage, 0);
+        int tilesX = (settings.width + FILL_TILE_SIZE - 1) / FILL_TILE_SIZE;
+        int tilesY = (settings.height + FILL_TILE_SIZE - 1) / FILL_TILE_SIZE;
+
+        parallelFor(tilesX * tilesY, settings.threadCount, [&](int begin, int end) {
+            Subdivision subdivision(kernel, image, known, settings.iterations);
+            for (int tile = begin; tile < end; ++tile) {
+                int x0 = (tile % tilesX) * FILL_TILE_SIZE;
+                int y0 = (tile / tilesX) * FILL_TILE_SIZE;
+                int x1 = std::min(x0 + FILL_TILE_SIZE, settings.width) - 1;
+                int y1 = std::min(y0 + FILL_TILE_SIZE, settings.height) - 1;
+                subdivision.rectangle(x0, y0, x1, y1);
+            }
+            evaluatedPixels += subdivision.evaluatedPixels;
+        });
+    }
+    else if (mode == FillMode::BoundaryTracing) {
+        std::vector<char> state(storage, 0);
+        int tilesX = (settings.width + FILL_TILE_SIZE - 1) / FILL_TILE_SIZE;
+        int tilesY = (settings.height + FILL_TILE_SIZE - 1) / FILL_TILE_SIZE;
+
+        auto eachTile = [&](auto function) {
+            parallelFor(tilesX * tilesY, settings.threadCount, [&](int begin, int end) {
+                BoundaryTracing tracing(kernel, image, state, settings.iterations);
+                for (int tile = begin; tile < end; ++tile) {
+                    int x0 = (tile % tilesX) * FILL_TILE_SIZE;
+                    int y0 = (tile / tilesX) * FILL_TILE_SIZE;
+                    function(tracing, x0, y0, std::min(x0 + FILL_TILE_SIZE, settings.width) - 1, std::min(y0 + FILL_TILE_SIZE, settings.height) - 1);
+                }
+                evaluatedPixels += tracing.evaluatedPixels;
+            });
+        };
+
+        eachTile([](BoundaryTracing& tracing, int x0, int y0, int x1, int y1) { tracing.traceTile(x0, y0, x1, y1); });
+        BoundaryTracing seams(kernel, image, state, settings.iterations);
+        seams.traceSeams(FILL_TILE_SIZE);
+        evaluatedPixels += seams.evaluatedPixels;
+        eachTile([](BoundaryTracing& tracing, int x0, int y0, int x1, int y1) { tracing.fillTile(x0, y0, x1, y1); });
+    }
+    else if (mode == FillMode::SolidGuessing) {
+        std::vector<char> guessed(storage, 0);
+        evaluatedPixels = solidGuessing(settings, kernel, image, guessed);
+        statistics.guessedPixels = pixelCount - evaluatedPixels;
+
+        if (settings.exactFinalPass) {
+            statistics.evaluatedPixels = evaluatedPixels;
+            statistics.renderMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            statistics.periodicPixels = countPeriodicPixels(image);
+            refineGuessedPixels(settings, guessed, image, statistics);
+            return;
+        }
+        if (guessedPixels) *guessedPixels = std::move(guessed);
+    }
+    else {
+        parallelFor(image.getTileCount(), settings.threadCount, [&](int begin, int end) {
+            for (int slot = begin; slot < end; ++slot) {
+                const Tile& tile = image.getTile(slot);
+                for (int y = tile.y0; y < tile.y0 + tile.height; ++y) {
+                    size_t index = image.index(tile.x0, y);
+                    for (int x = tile.x0; x < tile.x0 + tile.width; ++x, ++index) {
+                        evaluatePixel(kernel, image, x, y, index);
+                    }
+                }
+            }
+        });
+        evaluatedPixels = pixelCount;
+    }
+
+    statistics.evaluatedPixels = evaluatedPixels;
+    statistics.periodicPixels = countPeriodicPixels(image);
+    statistics.renderMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+}
+
+void refineGuessedPixels(const EscapeTimeSettings& settings, std::vector<char>& guessedPixels, TiledFramebuffer& image, FrameStatistics& statistics) {
+    auto passStart = std::chrono::steady_clock::now();
+
+    EscapeTimeKernel kernel(settings);
+    std::atomic<int> refinedPixels = 0;
+
+    parallelFor(image.getTileCount(), settings.threadCount, [&](int begin, int end) {
+        int refined = 0;
+        for (int slot = begin; slot < end; ++slot) {
+            const Tile& tile = image.getTile(slot);
+            for (int y = tile.y0; y < tile.y0 + tile.height; ++y) {
+                size_t index = image.index(tile.x0, y);
+                for (int x = tile.x0; x < tile.x0 + tile.width; ++x, ++index) {
+                    if (!guessedPixels[index]) continue;
+                    evaluatePixel(kernel, image, x, y, index);
+                    guessedPixels[index] = 0;
+                    ++refined;
+                }
+            }
+        }
+        refinedPixels += refined;
+    });
+
+    statistics.evaluatedPixels += refinedPixels;
+    statistics.guessedPixels = 0;
+    statistics.periodicPixels = countPeriodicPixels(image);
+    statistics.renderMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - passStart).count();
+}
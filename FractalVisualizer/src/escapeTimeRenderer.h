@@ -0,0 +1,123 @@
+#ifndef ESCAPE_TIME_RENDERER_H
+#define ESCAPE_TIME_RENDERER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "frameStatistics.h"
+#include "complexParser.h"
+#include "equationProgram.h"
+#include "tiledFramebuffer.h"
+
+// CPU renderer for any equation the parser accepts, the same iteration as getSmoothIterations
+// in fractalFrag.frag but in double precision. Equations whose iteration bands are connected
+// (z^n + c) are rendered by Mariani-Silver subdivision: only rectangle borders are iterated,
+// and a rectangle whose whole border has one value is filled with it, a border at the iteration
+// limit only when the periodicity check or the cardioid test proved all of it interior.
+// Solid guessing works for any equation but is approximate: it iterates a coarse grid and
+// guesses finer pixels whose surrounding grid points share an iteration band.
+// Boundary tracing iterates only pixels next to a change in value and fills what they enclose,
+// matching brute force: pixels at the iteration limit that no check proved interior count as a
+// change, so escaping pixels can't hide behind them.
+
+enum class FillMode {
+    Automatic, // subdivision when it is exact for the equation, brute force otherwise
+    BruteForce,
+    Subdivision,
+    SolidGuessing,
+    BoundaryTracing
+};
+
+// An equation parsed and compiled once, so renders of the same equation can share it
+struct CompiledEquation {
+    // throws std::runtime_error when the equation can't be evaluated
+    CompiledEquation(const std::string& equation, bool withDerivative);
+
+    std::string equation;
+    EquationProgram program;
+    EquationProgram derivativeProgram; // only with withDerivative
+    bool hasDerivative;
+    EquationTraits traits;
+};
+
+struct EscapeTimeSettings {
+    int width = 0;
+    int height = 0;
+
+    double centerX = 0.0;
+    double centerY = 0.0;
+    double zoom = 1.0;
+
+    // the render is this width x height window of a larger image when imageWidth and imageHeight
+    // are set, so images too large for memory can be rendered in pieces
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int originX = 0; // from the left
+    int originY = 0; // from the bottom, like the framebuffer's rows
+
+    int iterations = 100;
+    float escapeRadius = 5.0f;
+    int periodicityInterval = 0; // 0 turns cycle detection off
+
+    bool distanceEstimation = false; // shade escaping pixels by distance to the boundary instead of iterations
+    float distanceRange = 8.0f; // in pixels, where the distance shading reaches the last color
+
+    FillMode fillMode = FillMode::Automatic;
+    bool exactFinalPass = false; // solid guessing iterates every guessed pixel afterwards
+
+    std::string equation = "z^2 + c";
+    std::map<std::string, std::pair<double, double>> variables; // values of the custom uniforms
+    std::shared_ptr<const CompiledEquation> compiledEquation; // used when it matches equation, compiled per render otherwise
+
+    int threadCount = 0; // 0 uses every hardware thread
+
+    bool operator==(const EscapeTimeSettings&) const = default;
+};
+
+// One pixel of the escape time loop, shared by every fill mode
+class EscapeTimeKernel {
+public:
+    // throws std::runtime_error when the equation can't be evaluated
+    explicit EscapeTimeKernel(const EscapeTimeSettings& settings);
+
+    // periodic, when given, is set when the periodicity check stopped the orbit
+    float evaluate(int x, int y) const;
+    float evaluate(int x, int y, double& finalReal, double& finalImag, bool* periodic = nullptr) const;
+
+    // any c, for samples off the pixel grid, the settings' zoom and height still set the pixel size
+    float evaluatePoint(double constReal, double constImag, double& finalReal, double& finalImag, bool* periodic = nullptr) const;
+
+    // the pixel's c is in the main cardioid or period 2 bulb of z^2 + c, which the loop skips as interior
+    bool skipsPixel(int x, int y) const;
+
+    const EquationTraits& getTraits() const { return traits; }
+
+private:
+    const EscapeTimeSettings& settings;
+
+    void pixelConstant(int x, int y, double& real, double& imag) const;
+
+    EquationProgram program;
+    EquationProgram derivativeProgram; // only compiled for distance estimation
+    EquationTraits traits;
+    double periodicityToleranceSq;
+    double pixelSize;
+    double imageWidth; // of the whole image when rendering a window
+    double imageHeight;
+};
+
+// the mode renderEscapeTime will use, subdivision needs connected iteration bands
+FillMode selectFillMode(FillMode requested, const EquationTraits& traits);
+const char* fillModeName(FillMode mode);
+
+// Fills the smooth iteration, final z and periodic planes. guessedPixels, when given, marks the pixels
+// solid guessing filled in without iterating them, indexed like the framebuffer's planes.
+void renderEscapeTime(const EscapeTimeSettings& settings, TiledFramebuffer& image, FrameStatistics& statistics, std::vector<char>* guessedPixels = nullptr);
+
+// The exact pass of solid guessing on its own, so a preview can be shown before it runs
+void refineGuessedPixels(const EscapeTimeSettings& settings, std::vector<char>& guessedPixels, TiledFramebuffer& image, FrameStatistics& statistics);
+
+#endif // ESCAPE_TIME_RENDERER_H
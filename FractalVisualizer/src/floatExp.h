@@ -0,0 +1,127 @@
+#ifndef FLOAT_EXP_H
+#define FLOAT_EXP_H
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <climits>
+
+// Floating point number with a double mantissa and a separate int exponent,
+// value = mantissa * 2^exponent with 1 <= |mantissa| < 2.
+// Keeps 53 bits of precision far outside the 1e-308 range of a double,
+// shaders/fractalFrag.frag has the same type with a float mantissa.
+
+class FloatExp {
+public:
+    double mantissa = 0.0;
+    int exponent = ZERO_EXPONENT;
+
+    FloatExp() = default;
+
+    FloatExp(double value) {
+        *this = normalize(value, 0);
+    }
+
+    FloatExp(double mantissa, int exponent) {
+        *this = normalize(mantissa, exponent);
+    }
+
+    explicit operator double() const {
+        if (exponent >= -1022 && exponent <= 1023) {
+            return mantissa * std::bit_cast<double>(static_cast<uint64_t>(exponent + 1023) << 52);
+        }
+        if (mantissa == 0.0 || exponent < -1100) return 0.0;
+        if (exponent > 1100) return mantissa * INFINITY;
+        return std::ldexp(mantissa, exponent);
+    }
+
+    explicit operator float() const {
+        return static_cast<float>(static_cast<double>(*this));
+    }
+
+    bool operator==(const FloatExp& other) const = default;
+
+    bool isZero() const {
+        return mantissa == 0.0;
+    }
+
+    FloatExp operator-() const {
+        FloatExp result = *this;
+        result.mantissa = -mantissa;
+        return result;
+    }
+
+    friend FloatExp operator*(const FloatExp& a, const FloatExp& b) {
+        if (a.isZero() || b.isZero()) return FloatExp();
+        return normalize(a.mantissa * b.mantissa, a.exponent + b.exponent);
+    }
+
+    friend FloatExp operator/(const FloatExp& a, const FloatExp& b) {
+        if (a.isZero()) return FloatExp();
+        return normalize(a.mantissa / b.mantissa, a.exponent - b.exponent);
+    }
+
+    friend FloatExp operator+(const FloatExp& a, const FloatExp& b) {
+        if (a.isZero()) return b;
+        if (b.isZero()) return a;
+
+        // align to the larger exponent, anything more than 64 bits below it can't change the sum
+        int difference = a.exponent - b.exponent;
+        if (difference > 64) return a;
+        if (difference < -64) return b;
+        if (difference >= 0) return normalize(a.mantissa + scale(b.mantissa, -difference), a.exponent);
+        return normalize(scale(a.mantissa, difference) + b.mantissa, b.exponent);
+    }
+
+    friend FloatExp operator-(const FloatExp& a, const FloatExp& b) {
+        return a + (-b);
+    }
+
+    FloatExp& operator+=(const FloatExp& other) { return *this = *this + other; }
+    FloatExp& operator-=(const FloatExp& other) { return *this = *this - other; }
+    FloatExp& operator*=(const FloatExp& other) { return *this = *this * other; }
+
+    // multiplies by 2^power without touching the mantissa
+    FloatExp timesPowerOfTwo(int power) const {
+        FloatExp result = *this;
+        if (!isZero()) result.exponent += power;
+        return result;
+    }
+
+    // log2 of the magnitude, used to pick number formats from a zoom level
+    double log2Magnitude() const {
+        if (isZero()) return -INFINITY;
+        return exponent + std::log2(std::abs(mantissa));
+    }
+
+private:
+    static constexpr int ZERO_EXPONENT = INT_MIN / 4;
+
+    static FloatExp normalize(double mantissa, int exponent) {
+        FloatExp result;
+        if (mantissa == 0.0) return result;
+
+        uint64_t bits = std::bit_cast<uint64_t>(mantissa);
+        int biased = static_cast<int>((bits >> 52) & 0x7FF);
+
+        if (biased == 0 || biased == 0x7FF) {
+            // subnormal or inf/nan mantissas take the slow path
+            int shift = 0;
+            result.mantissa = std::frexp(mantissa, &shift) * 2.0;
+            result.exponent = exponent + shift - 1;
+            return result;
+        }
+
+        bits = (bits & ~(0x7FFull << 52)) | (1023ull << 52);
+        result.mantissa = std::bit_cast<double>(bits);
+        result.exponent = exponent + biased - 1023;
+        return result;
+    }
+
+    // mantissa * 2^power for power in [-64, 0]
+    static double scale(double mantissa, int power) {
+        return mantissa * std::bit_cast<double>(static_cast<uint64_t>(1023 + power) << 52);
+    }
+};
+
+#endif // FLOAT_EXP_H
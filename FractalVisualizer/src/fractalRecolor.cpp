@@ -0,0 +1,203 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "imageFile.h"
+#include "iterationFile.h"
+#include "palette.h"
+#include "parallelFor.h"
+#include "pngWriter.h"
+#include "renderJobs.h"
+
+// Colors the iteration data fractal-render --iteration-data saved with a new palette, without
+// iterating anything. The file is memory mapped and colored one row of tiles at a time.
+
+namespace {
+
+const char* USAGE =
+    "usage: fractal-recolor [options] data.iter --output image.png\n"
+    "  --color R,G,B               gradient color from 0 to 1, repeatable, replaces the render's colors\n"
+    "  --positions P,P,...         where each gradient color sits, from 0 to 1\n"
+    "  --contrast C                the render's contrast otherwise, turns equalization off\n"
+    "  --equalize                  spread the gradient by the iteration histogram, in place of contrast\n"
+    "  --interpolation linear|smooth|step\n"
+    "  --repeats N                 wrap the gradient around and run it N times, 0 runs it once\n"
+    "  --palette-size N            colors in the baked palette\n"
+    "  --threads N                 0 uses every hardware thread\n"
+    "  --output FILE               PNG for .png, binary PPM otherwise\n";
+
+std::vector<double> parseNumbers(const std::string& text, size_t count) {
+    std::vector<double> numbers;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        numbers.push_back(std::stod(item));
+    }
+    if (count != 0 && numbers.size() != count) {
+        throw std::runtime_error("Expected " + std::to_string(count) + " numbers in " + text);
+    }
+    return numbers;
+}
+
+// the stored pixels of every tile, counted a row of tiles per call
+IterationHistogram countStoredIterations(const IterationFile& data, int threadCount) {
+    const int tileSize = IterationFile::TILE_SIZE;
+    return countInParallel(data.getTilesDown(), data.getIterations(), threadCount, [&](int tileY, IterationHistogram& histogram) {
+        int rows = std::min(tileSize, data.getHeight() - tileY * tileSize);
+        for (int tileX = 0; tileX < data.getTilesAcross(); ++tileX) {
+            const float* smooth = data.smoothTile(tileX, tileY);
+            if (!smooth) continue;
+            int columns = std::min(tileSize, data.getWidth() - tileX * tileSize);
+            for (int y = 0; y < rows; ++y) {
+                for (int x = 0; x < columns; ++x) histogram.add(smooth[y * tileSize + x]);
+            }
+        }
+    });
+}
+
+// one row of tiles, top row first, pixels of tiles the file doesn't have stay transparent black
+void colorTileRow(const IterationFile& data, int tileY, const Palette& palette, const std::vector<uint32_t>& lut, const std::vector<float>& cumulative, int threadCount, std::vector<uint8_t>& rgba) {
+    const int tileSize = IterationFile::TILE_SIZE;
+    int width = data.getWidth();
+    int rows = std::min(tileSize, data.getHeight() - tileY * tileSize);
+    rgba.assign(static_cast<size_t>(width) * rows * 4, 0);
+
+    parallelFor(data.getTilesAcross(), threadCount, [&](int begin, int end) {
+        for (int tileX = begin; tileX < end; ++tileX) {
+            const float* smooth = data.smoothTile(tileX, tileY);
+            if (!smooth) continue;
+            const float* basins = data.getBasinRadius() > 0.0f ? data.magnitudeTile(tileX, tileY) : nullptr;
+            int columns = std::min(tileSize, width - tileX * tileSize);
+            for (int y = 0; y < rows; ++y) {
+                uint8_t* out = rgba.data() + (static_cast<size_t>(y) * width + tileX * tileSize) * 4;
+                for (int x = 0; x < columns; ++x) {
+                    int at = y * tileSize + x;
+                    uint32_t color = shadeSmoothIterations(smooth[at], data.getIterations(), palette, lut, &cumulative, basins ? basins[at] : -1.0f);
+                    out[x * 4] = static_cast<uint8_t>(color);
+                    out[x * 4 + 1] = static_cast<uint8_t>(color >> 8);
+                    out[x * 4 + 2] = static_cast<uint8_t>(color >> 16);
+                    out[x * 4 + 3] = static_cast<uint8_t>(color >> 24);
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string input;
+    std::string output;
+    std::vector<Color> colors;
+    std::vector<float> positions;
+    bool positionsGiven = false;
+    float contrast = 0.0f;
+    bool contrastGiven = false;
+    bool equalize = false;
+    std::string interpolation;
+    int repeats = -1;
+    int paletteSize = 0;
+    int threadCount = 0;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            auto next = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + option);
+                return argv[++i];
+            };
+
+            if (option == "--help" || option == "-h") {
+                std::cout << USAGE;
+                return 0;
+            }
+            else if (option == "--output" || option == "-o") output = next();
+            else if (option == "--color") {
+                std::vector<double> rgb = parseNumbers(next(), 3);
+                colors.push_back({ static_cast<float>(rgb[0]), static_cast<float>(rgb[1]), static_cast<float>(rgb[2]), 1.0f });
+            }
+            else if (option == "--positions") {
+                positionsGiven = true;
+                for (double position : parseNumbers(next(), 0)) positions.push_back(static_cast<float>(position));
+            }
+            else if (option == "--contrast") {
+                contrastGiven = true;
+                contrast = std::stof(next());
+            }
+            else if (option == "--equalize") equalize = true;
+            else if (option == "--interpolation") interpolation = next();
+            else if (option == "--repeats") {
+                repeats = std::stoi(next());
+                if (repeats < 0) throw std::runtime_error("--repeats can't be negative");
+            }
+            else if (option == "--palette-size") {
+                paletteSize = std::stoi(next());
+                if (paletteSize < 1) throw std::runtime_error("--palette-size must be positive");
+            }
+            else if (option == "--threads") threadCount = std::stoi(next());
+            else if (!option.empty() && option[0] == '-') throw std::runtime_error("Unknown option: " + option);
+            else if (input.empty()) input = option;
+            else throw std::runtime_error("Only one iteration data file at a time");
+        }
+        if (input.empty() || output.empty()) {
+            std::cerr << USAGE;
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        IterationFile data;
+        data.open(input);
+
+        // the render's own palette, for whatever the options leave out
+        Palette palette;
+        try {
+            palette = parseRenderJob(data.getDescription(), input, RenderJob()).request.palette;
+        }
+        catch (const std::runtime_error&) {
+            // written by something else, the GUI's defaults will do
+        }
+        if (!colors.empty()) palette.colors = colors;
+        if (positionsGiven) palette.positions = positions;
+        if (contrastGiven) {
+            palette.contrast = contrast;
+            palette.equalize = false;
+        }
+        if (equalize) palette.equalize = true;
+        if (!interpolation.empty()) palette.interpolation = parsePaletteInterpolation(interpolation);
+        if (repeats >= 0) palette.repeats = repeats;
+        if (paletteSize > 0) palette.lutSize = paletteSize;
+        std::vector<uint32_t> lut = bakePalette(palette);
+        std::vector<float> cumulative;
+        if (palette.equalize) cumulative = countStoredIterations(data, threadCount).cumulative();
+
+        std::vector<uint8_t> band;
+        if (isPNGPath(output)) {
+            PngWriter writer(output, data.getWidth(), data.getHeight(), false, threadCount);
+            for (int tileY = 0; tileY < data.getTilesDown(); ++tileY) {
+                colorTileRow(data, tileY, palette, lut, cumulative, threadCount, band);
+                writer.addRows(band.data(), static_cast<int>(band.size() / (static_cast<size_t>(data.getWidth()) * 4)));
+            }
+            writer.finish();
+        }
+        else {
+            std::vector<uint8_t> rgba;
+            rgba.reserve(static_cast<size_t>(data.getWidth()) * data.getHeight() * 4);
+            for (int tileY = 0; tileY < data.getTilesDown(); ++tileY) {
+                colorTileRow(data, tileY, palette, lut, cumulative, threadCount, band);
+                rgba.insert(rgba.end(), band.begin(), band.end());
+            }
+            writeImage(output, data.getWidth(), data.getHeight(), rgba, threadCount);
+        }
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << output << ": " << data.getWidth() << "x" << data.getHeight() << " recolored in " << milliseconds << " ms\n";
+    }
+    catch (const std::exception& e) {
+        std::cerr << "fractal-recolor: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
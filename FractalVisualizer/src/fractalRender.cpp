@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "imageFile.h"
+#include "iterationFile.h"
+#include "pngWriter.h"
+#include "posterRender.h"
+#include "renderCore.h"
+#include "renderJobs.h"
+#include "supersampling.h"
+#include "workStealing.h"
+#include "zoomVideo.h"
+
+// Headless renderer, renders one still, a batch of them or a zoom video on the CPU and writes PNG, PPM, tiled TIFF or Y4M files
+
+namespace {
+
+const char* USAGE =
+    "usage: fractal-render [options] --output image.png\n"
+    "       fractal-render [options] --jobs jobs.json\n"
+    "       fractal-render [--threads N] [--memory MB] --resume poster.tif\n"
+    "  --size WIDTHxHEIGHT         default 1080x1080, both sides span the same range of c, so other shapes stretch\n"
+    "  --center REAL IMAG          view center in the complex plane, any number of digits\n"
+    "  --zoom LOG2                 the view is 2^(LOG2 + 1) wide, 0 shows the whole set\n"
+    "  --equation TEXT             default \"z^2 + c\"\n"
+    "  --var NAME=REAL,IMAG        value of a custom variable, repeatable\n"
+    "  --iterations N              default 100\n"
+    "  --escape-radius R           default 5\n"
+    "  --periodicity N             Brent check interval, 0 turns it off\n"
+    "  --distance PIXELS           shade by distance to the boundary\n"
+    "  --color R,G,B               gradient color from 0 to 1, repeatable, replaces the defaults\n"
+    "  --positions P,P,...         where each gradient color sits, from 0 to 1\n"
+    "  --contrast C                default 0.5\n"
+    "  --interpolation linear|smooth|step\n"
+    "  --repeats N                 wrap the gradient around and run it N times, default 0 runs it once\n"
+    "  --palette-size N            colors in the baked palette, default 1024\n"
+    "  --equalize                  spread the gradient by the image's iteration histogram, in place of contrast\n"
+    "  --supersample N             iterate pixels on edges again at N jittered sub-samples, a square such as 4, 9 or 16\n"
+    "  --supersample-threshold T   smooth iterations between neighbours that make an edge, default 1, negative for every pixel\n"
+    "  --backend auto|escape|perturbation\n"
+    "  --fill auto|brute|subdivision|guessing|tracing\n"
+    "  --threads N                 0 uses every hardware thread\n"
+    "  --jobs FILE                 render every job in a JSON or JSON Lines file, the other options are their defaults\n"
+    "  --no-pinning                leave worker threads unpinned\n"
+    "  --output FILE               PNG for .png, tiled TIFF rendered in batches for .tif, binary PPM otherwise\n"
+    "  --iteration-data FILE       also save the smooth iterations and final |z|, for fractal-recolor\n"
+    "  --pyramid                   add reduced resolution levels to a TIFF\n"
+    "  --memory MB                 how much a TIFF batch may use, default 1024\n"
+    "  --video SECONDS             zoom from --start-zoom in to --zoom, --output is a .y4m or a frame pattern like frame%05d.png\n"
+    "  --fps N                     video frames per second, default 30\n"
+    "  --start-zoom LOG2           zoom of the first video frame, default 0\n"
+    "  --keyframe-octaves N        zoom between the video's fully rendered frames, default 1\n"
+    "  --path FILE                 make the video follow the views of a JSON or JSON Lines file instead, one job per waypoint,\n"
+    "                              written to the first waypoint's output unless --output is given\n"
+    "  --keyframe-scale N          resolution of the path's keyframes, in frames, default 2\n"
+    "  --reuse-error PIXELS        how far apart keyframe samples may get in frame pixels before the next keyframe, default 1\n"
+    "  --resume FILE               finish a TIFF render that was stopped, with the settings stored in it\n"
+    "  --encode-benchmark MAX_THREADS  time PNG encoding of the render at 1, 2, 4, ... threads\n"
+    "  --scaling MAX_THREADS       time the standard scenes at 1, 2, 4, ... threads instead of rendering\n";
+
+std::vector<double> parseNumbers(const std::string& text, size_t count) {
+    std::vector<double> numbers;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        numbers.push_back(std::stod(item));
+    }
+    if (count != 0 && numbers.size() != count) {
+        throw std::runtime_error("Expected " + std::to_string(count) + " numbers in " + text);
+    }
+    return numbers;
+}
+
+struct Scene {
+    const char* name;
+    const char* equation;
+    const char* centerReal;
+    const char* centerImag;
+    double logZoom;
+    int iterations;
+};
+
+// cheap and expensive regions side by side, so a static split would leave threads waiting
+const Scene SCALING_SCENES[] = {
+    { "whole set", "z^2 + c", "-0.5", "0", 0.0, 1000 },
+    { "seahorse valley", "z^2 + c", "-0.7436447860", "0.1318252536", -12.0, 4000 },
+    { "cubic", "z^3 + c", "0", "0", 0.0, 500 },
+    { "deep zoom", "z^2 + c", "-1.7497219817834534", "0.0000000000000000", -50.0, 3000 }
+};
+
+void runScalingReport(const RenderRequest& base, int maxThreads) {
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    std::cout << base.width << "x" << base.height << ", " << std::thread::hardware_concurrency() << " hardware threads\n";
+    for (const Scene& scene : SCALING_SCENES) {
+        RenderRequest request = base;
+        request.equation = scene.equation;
+        request.view.logZoom = scene.logZoom;
+        request.iterations = scene.iterations;
+        setViewCenter(request, scene.centerReal, scene.centerImag);
+
+        // one untimed render first so first touch costs don't land on the single thread time
+        request.threadCount = 1;
+        render(request);
+
+        std::cout << scene.name << "\n";
+        double single = 0.0;
+        for (int threads : threadCounts) {
+            request.threadCount = threads;
+            auto start = std::chrono::steady_clock::now();
+            render(request);
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (threads == 1) single = milliseconds;
+
+            std::cout << "  " << std::setw(4) << threads << " threads " << std::fixed << std::setprecision(1) << std::setw(10) << milliseconds << " ms  "
+                << std::setprecision(2) << single / milliseconds << "x  " << single / milliseconds / threads * 100.0 << "% efficiency\n";
+        }
+    }
+}
+
+void runEncodeBenchmark(const RenderResult& result, const std::string& output, int maxThreads) {
+    double megabytes = static_cast<double>(result.width) * result.height * 3 / (1024.0 * 1024.0);
+    std::cout << result.width << "x" << result.height << ", " << std::fixed << std::setprecision(1) << megabytes << " MB of RGB\n";
+
+    double single = 0.0;
+    for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+        auto start = std::chrono::steady_clock::now();
+        writePNG(output, result.width, result.height, result.rgba, threads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) single = seconds;
+
+        std::ifstream written(output, std::ios::binary | std::ios::ate);
+        double size = static_cast<double>(written.tellg());
+        std::cout << "  " << std::setw(4) << threads << " threads " << std::setprecision(1) << std::setw(8) << megabytes / seconds << " MB/s  "
+            << std::setprecision(2) << single / seconds << "x  " << std::setprecision(1) << size / (megabytes * 1024.0 * 1024.0) * 100.0 << "% of raw\n";
+        if (threads == maxThreads) break;
+    }
+}
+
+void printPosterSummary(const std::string& output, const PosterSummary& summary) {
+    std::cout << output << ": " << summary.width << "x" << summary.height << ", " << summary.levels << (summary.levels == 1 ? " level, " : " levels, ")
+        << summary.tilesRendered << " tiles rendered in " << summary.batches << " batches";
+    if (summary.tilesResumed > 0) std::cout << ", " << summary.tilesResumed << " already in the file";
+    std::cout << ", " << summary.milliseconds << " ms\n";
+}
+
+void printVideoSummary(const std::string& output, const ZoomVideoSummary& summary) {
+    double frameByFrame = static_cast<double>(summary.width) * summary.height * summary.frames;
+    std::cout << output << ": " << summary.frames << " frames of " << summary.width << "x" << summary.height << ", " << summary.keyframes << " keyframes, ";
+    if (summary.stripWidth > 0) std::cout << summary.stripWidth << "x" << summary.stripRows << " strip, ";
+    std::cout << summary.iteratedPoints / 1e6 << "M points iterated (" << frameByFrame / 1e6 << "M frame by frame), " << summary.milliseconds << " ms\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    RenderRequest request;
+    std::string output;
+    std::string centerReal = "0";
+    std::string centerImag = "0";
+    std::vector<Color> colors;
+    int scalingThreads = 0;
+    int encodeThreads = 0;
+    std::string jobFile;
+    PosterOptions posterOptions;
+    std::string resumeFile;
+    std::string iterationData;
+    bool video = false;
+    ZoomVideoOptions videoOptions;
+    std::string pathFile;
+    ZoomPathOptions pathOptions;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            auto next = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + option);
+                return argv[++i];
+            };
+
+            if (option == "--help" || option == "-h") {
+                std::cout << USAGE;
+                return 0;
+            }
+            else if (option == "--output" || option == "-o") output = next();
+            else if (option == "--iteration-data") iterationData = next();
+            else if (option == "--size") {
+                std::string size = next();
+                if (std::sscanf(size.c_str(), "%dx%d", &request.width, &request.height) != 2 || request.width <= 0 || request.height <= 0) {
+                    throw std::runtime_error("Size must look like 1920x1080");
+                }
+            }
+            else if (option == "--center") {
+                centerReal = next();
+                centerImag = next();
+            }
+            else if (option == "--zoom") request.view.logZoom = std::stod(next());
+            else if (option == "--equation") request.equation = next();
+            else if (option == "--var") {
+                std::string assignment = next();
+                size_t equals = assignment.find('=');
+                if (equals == std::string::npos) throw std::runtime_error("Variables look like name=real,imag");
+                std::vector<double> value = parseNumbers(assignment.substr(equals + 1), 2);
+                request.variables[assignment.substr(0, equals)] = { value[0], value[1] };
+            }
+            else if (option == "--iterations") request.iterations = std::stoi(next());
+            else if (option == "--escape-radius") request.escapeRadius = std::stof(next());
+            else if (option == "--periodicity") request.periodicityInterval = std::stoi(next());
+            else if (option == "--distance") {
+                request.distanceEstimation = true;
+                request.distanceRange = std::stof(next());
+            }
+            else if (option == "--color") {
+                std::vector<double> rgb = parseNumbers(next(), 3);
+                colors.push_back({ static_cast<float>(rgb[0]), static_cast<float>(rgb[1]), static_cast<float>(rgb[2]), 1.0f });
+            }
+            else if (option == "--positions") {
+                request.palette.positions.clear();
+                for (double position : parseNumbers(next(), 0)) request.palette.positions.push_back(static_cast<float>(position));
+            }
+            else if (option == "--contrast") request.palette.contrast = std::stof(next());
+            else if (option == "--interpolation") request.palette.interpolation = parsePaletteInterpolation(next());
+            else if (option == "--repeats") {
+                request.palette.repeats = std::stoi(next());
+                if (request.palette.repeats < 0) throw std::runtime_error("--repeats can't be negative");
+            }
+            else if (option == "--palette-size") {
+                request.palette.lutSize = std::stoi(next());
+                if (request.palette.lutSize < 1) throw std::runtime_error("--palette-size must be positive");
+            }
+            else if (option == "--equalize") request.palette.equalize = true;
+            else if (option == "--supersample") {
+                request.supersamples = std::stoi(next());
+                subsampleGrid(request.supersamples);
+            }
+            else if (option == "--supersample-threshold") request.supersampleThreshold = std::stof(next());
+            else if (option == "--backend") request.backend = parseRenderBackend(next());
+            else if (option == "--fill") request.fillMode = parseFillMode(next());
+            else if (option == "--threads") request.threadCount = std::stoi(next());
+            else if (option == "--jobs") jobFile = next();
+            else if (option == "--pyramid") posterOptions.pyramid = true;
+            else if (option == "--memory") {
+                int megabytes = std::stoi(next());
+                if (megabytes < 1) throw std::runtime_error("--memory needs at least 1 MB");
+                posterOptions.memoryLimit = static_cast<size_t>(megabytes) << 20;
+            }
+            else if (option == "--video") {
+                video = true;
+                videoOptions.seconds = std::stod(next());
+            }
+            else if (option == "--fps") videoOptions.fps = std::stoi(next());
+            else if (option == "--start-zoom") videoOptions.startZoom = std::stod(next());
+            else if (option == "--keyframe-octaves") videoOptions.keyframeOctaves = std::stod(next());
+            else if (option == "--path") pathFile = next();
+            else if (option == "--keyframe-scale") pathOptions.keyframeScale = std::stoi(next());
+            else if (option == "--reuse-error") pathOptions.maxError = std::stod(next());
+            else if (option == "--resume") resumeFile = next();
+            else if (option == "--encode-benchmark") {
+                encodeThreads = std::stoi(next());
+                if (encodeThreads < 1) throw std::runtime_error("--encode-benchmark needs at least one thread");
+            }
+            else if (option == "--no-pinning") WorkStealingPool::instance().setPinning(false);
+            else if (option == "--scaling") {
+                scalingThreads = std::stoi(next());
+                if (scalingThreads < 1) throw std::runtime_error("--scaling needs at least one thread");
+            }
+            else throw std::runtime_error("Unknown option: " + option);
+        }
+
+        if (!colors.empty()) request.palette.colors = colors;
+        if (scalingThreads > 0) {
+            runScalingReport(request, scalingThreads);
+            return 0;
+        }
+        if (!resumeFile.empty()) {
+            PosterSummary summary = resumePoster(resumeFile, posterOptions, request.threadCount, std::cout);
+            printPosterSummary(resumeFile, summary);
+            return 0;
+        }
+        if (!jobFile.empty()) {
+            RenderJob defaults;
+            defaults.request = request;
+            defaults.centerReal = centerReal;
+            defaults.centerImag = centerImag;
+
+            std::vector<RenderJob> jobs = readRenderJobs(jobFile, defaults);
+            BatchSummary summary = renderJobs(jobs, request.threadCount, std::cout);
+            std::cout << summary.rendered << " of " << jobs.size() << " jobs rendered in " << summary.milliseconds << " ms\n";
+            return summary.failed > 0 ? 1 : 0;
+        }
+        // a path's waypoints name the video themselves
+        if (output.empty() && !(video && !pathFile.empty())) {
+            std::cerr << USAGE;
+            return 1;
+        }
+
+        RenderJob job;
+        job.request = request;
+        job.centerReal = centerReal;
+        job.centerImag = centerImag;
+        job.output = output;
+        job.iterationData = iterationData;
+        if (video && !pathFile.empty()) {
+            pathOptions.seconds = videoOptions.seconds;
+            pathOptions.fps = videoOptions.fps;
+            // --output wins over the video file the waypoints were saved with
+            std::vector<RenderJob> waypoints = readRenderJobs(pathFile, job);
+            if (!output.empty()) {
+                for (RenderJob& waypoint : waypoints) waypoint.output = output;
+            }
+            if (waypoints.empty()) throw std::runtime_error(pathFile + " has no waypoints");
+            printVideoSummary(waypoints.front().output, renderZoomPath(waypoints, pathOptions, std::cout));
+            return 0;
+        }
+        if (video) {
+            printVideoSummary(output, renderZoomVideo(job, videoOptions, std::cout));
+            return 0;
+        }
+        if (isPosterPath(output) && encodeThreads == 0) {
+            printPosterSummary(output, renderPoster(job, posterOptions, std::cout));
+            return 0;
+        }
+
+        setViewCenter(request, centerReal, centerImag);
+
+        RenderResult result = render(request);
+        if (encodeThreads > 0) {
+            runEncodeBenchmark(result, output, encodeThreads);
+            return 0;
+        }
+        writeImage(output, result.width, result.height, result.rgba, request.threadCount);
+        if (!iterationData.empty()) {
+            writeIterationFile(iterationData, result.image, request.iterations, formatRenderJob(job), request.threadCount, rootBasinRadius(request));
+        }
+
+        std::cout << output << ": " << result.width << "x" << result.height << " in " << result.statistics.renderMilliseconds << " ms ("
+            << (result.backend == RenderBackend::Perturbation ? "perturbation" : result.statistics.fillMode) << ")\n";
+        if (request.supersamples > 1) std::cout << result.statistics.supersampledPixels << " pixels supersampled\n";
+        if (!result.warning.empty()) std::cerr << "fractal-render: warning: " << result.warning << "\n";
+    }
+    catch (const std::exception& e) {
+        std::cerr << "fractal-render: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef FRAME_STATISTICS_H
+#define FRAME_STATISTICS_H
+
+// Counters filled in by the renderers for the last finished frame
+
+struct FrameStatistics {
+    double renderMilliseconds = 0.0;
+
+    // interior pixels stopped early by the periodicity check
+    int periodicPixels = 0;
+
+    // CPU escape time, pixels iterated rather than filled
+    const char* fillMode = "";
+    int evaluatedPixels = 0;
+    int guessedPixels = 0; // solid guessing, until the exact pass iterates them
+
+    // perturbation glitch correction
+    const char* deltaPrecision = "";
+    int glitchedPixels = 0;
+    int correctedPixels = 0;
+    int referencesUsed = 0;
+    double correctionMilliseconds = 0.0;
+
+    // edge-adaptive supersampling, pixels that got sub-samples
+    int supersampledPixels = 0;
+};
+
+#endif // FRAME_STATISTICS_H
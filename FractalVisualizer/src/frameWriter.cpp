@@ -0,0 +1,106 @@
+#include "frameWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+#include "imageFile.h"
+#include "parallelFor.h"
+
+namespace {
+
+uint8_t studioRange(double value) {
+    return static_cast<uint8_t>(std::clamp(std::lround(value), 0L, 255L));
+}
+
+} // namespace
+
+bool FrameWriter::isY4MPath(const std::string& path) {
+    if (path.size() < 4) return false;
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".y4m";
+}
+
+FrameWriter::FrameWriter(const std::string& path, int width, int height, int fps, int threadCount)
+    : path(path), width(width), height(height), threadCount(threadCount) {
+    if (isY4MPath(path)) {
+        stream.open(path, std::ios::binary);
+        if (!stream) throw std::runtime_error("Can't open " + path);
+        stream << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C420jpeg\n";
+        return;
+    }
+
+    // %d with an optional zero padded width, nothing else is taken as a format
+    size_t percent = path.find('%');
+    size_t end = percent;
+    if (percent != std::string::npos) {
+        end = percent + 1;
+        while (end < path.size() && std::isdigit(static_cast<unsigned char>(path[end]))) ++end;
+    }
+    if (percent == std::string::npos || end >= path.size() || path[end] != 'd' || path.find('%', end) != std::string::npos) {
+        throw std::runtime_error(path + ": numbered frames need one %d where the number goes, like frames/%05d.png");
+    }
+    prefix = path.substr(0, percent);
+    suffix = path.substr(end + 1);
+    digits = end > percent + 1 ? std::stoi(path.substr(percent + 1, end - percent - 1)) : 0;
+}
+
+std::string FrameWriter::framePath(int frame) const {
+    if (prefix.empty() && suffix.empty()) return path;
+    std::string number = std::to_string(frame);
+    if (static_cast<int>(number.size()) < digits) number.insert(0, digits - number.size(), '0');
+    return prefix + number + suffix;
+}
+
+void FrameWriter::addFrame(const std::vector<uint8_t>& rgba) {
+    if (!stream.is_open()) {
+        writeImage(framePath(frames), width, height, rgba, threadCount);
+        ++frames;
+        return;
+    }
+
+    // chroma is the average of each 2x2 block, edge blocks of odd sizes have fewer pixels
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    size_t lumaSize = static_cast<size_t>(width) * height;
+    size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+    planes.resize(lumaSize + chromaSize * 2);
+    uint8_t* luma = planes.data();
+    uint8_t* blue = luma + lumaSize;
+    uint8_t* red = blue + chromaSize;
+
+    parallelFor(chromaHeight, threadCount, [&](int begin, int end) {
+        for (int chromaY = begin; chromaY < end; ++chromaY) {
+            for (int chromaX = 0; chromaX < chromaWidth; ++chromaX) {
+                double sumBlue = 0.0, sumRed = 0.0;
+                int count = 0;
+                for (int y = chromaY * 2; y < std::min(chromaY * 2 + 2, height); ++y) {
+                    for (int x = chromaX * 2; x < std::min(chromaX * 2 + 2, width); ++x) {
+                        const uint8_t* pixel = rgba.data() + (static_cast<size_t>(y) * width + x) * 4;
+                        double r = pixel[0] / 255.0, g = pixel[1] / 255.0, b = pixel[2] / 255.0;
+                        luma[static_cast<size_t>(y) * width + x] = studioRange(16.0 + 65.481 * r + 128.553 * g + 24.966 * b);
+                        sumBlue += -37.797 * r - 74.203 * g + 112.0 * b;
+                        sumRed += 112.0 * r - 93.786 * g - 18.214 * b;
+                        ++count;
+                    }
+                }
+                blue[static_cast<size_t>(chromaY) * chromaWidth + chromaX] = studioRange(128.0 + sumBlue / count);
+                red[static_cast<size_t>(chromaY) * chromaWidth + chromaX] = studioRange(128.0 + sumRed / count);
+            }
+        }
+    });
+
+    stream << "FRAME\n";
+    stream.write(reinterpret_cast<const char*>(planes.data()), static_cast<std::streamsize>(planes.size()));
+    if (!stream) throw std::runtime_error("Can't write " + path);
+    ++frames;
+}
+
+void FrameWriter::finish() {
+    if (stream.is_open()) {
+        stream.close();
+        if (!stream) throw std::runtime_error("Can't write " + path);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Frames of a video, written one at a time as they are finished. A path ending in .y4m gets a
+// YUV4MPEG2 stream (4:2:0, BT.601 studio range) that ffmpeg and most players read as is; any
+// other path is a pattern for one image per frame, with a %d (or %05d and the like) where the
+// frame number goes, written as PNG or PPM by writeImage.
+
+class FrameWriter {
+public:
+    // throws std::runtime_error when the file can't be written or the pattern has no %d
+    FrameWriter(const std::string& path, int width, int height, int fps, int threadCount = 0);
+
+    // RGBA8 with the top row first, alpha is dropped
+    void addFrame(const std::vector<uint8_t>& rgba);
+
+    void finish();
+
+    int getFrameCount() const { return frames; }
+
+    // the pattern with its %d replaced, or path itself for a Y4M stream
+    std::string framePath(int frame) const;
+
+    static bool isY4MPath(const std::string& path);
+
+private:
+    std::string path;
+    std::ofstream stream; // only for Y4M
+    int width;
+    int height;
+    int threadCount;
+    int frames = 0;
+
+    // the pattern split around its %d
+    std::string prefix;
+    std::string suffix;
+    int digits = 0;
+
+    std::vector<uint8_t> planes; // Y, then Cb and Cr at half size
+};
+
+#endif // FRAME_WRITER_H
@@ -1,6 +1,8 @@
 ﻿#include "gui.h"
 
 std::unordered_map<std::string, ComplexVariableControl> variableControls;
+std::string activeEquation;
+EquationTraits activeEquationTraits;
 
 const std::unordered_set<std::string> BUILT_IN_FUNCTIONS = {
     "abs", "exp", "log", "ln", "conj",
@@ -76,6 +78,17 @@ std::string translateEquationToGLSL(const std::string& equation) {
     }
 }
 
+// only used for distance estimation, a broken equation already shows its error through translateEquationToGLSL
+std::string translateDerivativeToGLSL(const std::string& equation) {
+    try {
+        ComplexExpressionParser parser;
+        return parser.translateDerivative(equation);
+    }
+    catch (const std::exception&) {
+        return "dz";
+    }
+}
+
 std::vector<std::string> extractVariables(const std::string& equation) {
 	std::vector<std::string> variables;
 	std::regex variableRegex(R"(\b[a-zA-Z_][a-zA-Z0-9_]*\b)");
@@ -137,13 +150,33 @@ void createVariableSliders() {
 
 void applyEquationTwice(Shader& fractalShader, const char* equation) {
     // For some reason, the functions needs to be applied twice for OpenGL and ImGUI to sync up.
+    EquationTraits traits = analyzeEquation(equation);
 
     for (int i = 0; i < 2; ++i) {
         auto variables = extractVariables(equation);
         updateVariableExistence(variables);
         auto customEquation = translateEquationToGLSL(equation);
-        fractalShader.reload(variables, customEquation);
+        auto customDerivative = translateDerivativeToGLSL(equation);
+        fractalShader.reload(variables, customEquation, customDerivative, selectUnrollFactor(unrollFactor, traits));
+    }
+    activeEquation = equation;
+    activeEquationTraits = traits;
+}
+
+// longer blocks for cheap equations, expensive ones gain little and cost a lot of shader code
+int selectUnrollFactor(int requested, const EquationTraits& traits) {
+    if (requested > 0) return requested;
+    if (traits.cost <= 24) return 8;
+    if (traits.cost <= 64) return 4;
+    return 2;
+}
+
+std::vector<std::string> presetEquations() {
+    std::vector<std::string> equations;
+    for (int i = 0; i < IM_ARRAYSIZE(equationTypes) - 1; ++i) {
+        equations.push_back(equationTypes[i].expression);
     }
+    return equations;
 }
 
 void componentsForGUI(Shader& fractalShader) {
@@ -163,13 +196,31 @@ void componentsForGUI(Shader& fractalShader) {
     if (ImGui::CollapsingHeader("Color Stops", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Indent(20.0f);
 
+        int removed = -1;
         for (int i = 0; i < colorStops.size(); ++i) {
             ImGui::PushID(i);
             ImGui::ColorEdit3(("Color " + std::to_string(i + 1)).c_str(), &colorStops[i].x);
             ImGui::SliderFloat(("Stop " + std::to_string(i + 1)).c_str(), &stopPositions[i], 0.0f, 1.0f, "%.2f");
+            if (colorStops.size() > 2) {
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Remove")) removed = i;
+            }
             ImGui::Spacing();
             ImGui::PopID();
         }
+        if (removed >= 0) {
+            colorStops.erase(colorStops.begin() + removed);
+            stopPositions.erase(stopPositions.begin() + removed);
+        }
+        if (ImGui::Button("Add Color")) {
+            colorStops.push_back(colorStops.back());
+            stopPositions.push_back(1.0f);
+        }
+
+        static const char* interpolationLabels[] = { "Linear", "Smooth", "Step" };
+        ImGui::Combo("Interpolation", &paletteInterpolation, interpolationLabels, IM_ARRAYSIZE(interpolationLabels));
+        ImGui::SliderInt("Repeats", &paletteRepeats, 0, 32, paletteRepeats == 0 ? "Once" : "%d");
+        ImGui::SliderInt("Palette Size", &paletteSize, 16, 4096);
         ImGui::Spacing();
         ImGui::Separator();
 
@@ -179,18 +230,173 @@ void componentsForGUI(Shader& fractalShader) {
     if (ImGui::CollapsingHeader("Visual Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Indent(20.0f);
 
+        ImGui::BeginDisabled(equalizeColors);
         ImGui::SliderFloat("Contrast", &contrast, 0.1f, 5.0f, "%.2f");
-        ImGui::SliderFloat("Zoom", &zoom, 0.000001f, 10.0f, "%.6f");
+        ImGui::EndDisabled();
+        ImGui::Checkbox("Histogram Equalization", &equalizeColors);
+
+        // zoom is edited as log2, the center is shown with as many digits as a pixel needs
+        double logZoom = view.logZoom;
+        if (ImGui::DragScalar("Zoom (log2)", ImGuiDataType_Double, &logZoom, 0.05f, nullptr, nullptr, "%.2f")) {
+            view.setLogZoom(logZoom);
+        }
+        double logZoom10 = view.logZoom * std::log10(2.0);
+        double zoomExponent10 = std::floor(logZoom10);
+        ImGui::Text("Zoom: %.4fe%d", std::pow(10.0, logZoom10 - zoomExponent10), static_cast<int>(zoomExponent10));
+
+        int centerDigits = std::max(6, static_cast<int>(-logZoom10) + 6);
+        ImGui::TextWrapped("Center: %s", view.centerX.toString(centerDigits).c_str());
+        ImGui::TextWrapped("        %s", view.centerY.toString(centerDigits).c_str());
+        ImGui::Text("Center Precision: %d bits", view.centerX.fractionalBits());
+
         ImGui::SliderInt("Iterations", &iterations, 10, 1000);
         ImGui::DragFloat("Escape Radius", &escapeRadius, 0.005f, 0.0, 10000.0f, "%.4f");
+        ImGui::SliderInt("Periodicity Interval", &periodicityInterval, 0, 200, periodicityInterval == 0 ? "Off" : "%d");
+
+        ImGui::Checkbox("Distance Estimation", &distanceEstimation);
+        if (distanceEstimation) {
+            ImGui::SliderFloat("Distance Range (px)", &distanceRange, 1.0f, 64.0f, "%.1f");
+            ImGui::TextDisabled("Perturbation still colors by iterations");
+        }
+
+        if (ImGui::SliderInt("Unroll Factor", &unrollFactor, 0, 16, unrollFactor == 0 ? "Auto" : "%d")) {
+            std::string current = activeEquation;
+            applyEquationTwice(fractalShader, current.c_str());
+        }
+        ImGui::Checkbox("Specialize Shader", &specializeShader);
+
+        static const char* rendererLabels[] = { "GPU Shader", "CPU Perturbation", "CPU Escape Time", "Iteration Data" };
+        ImGui::Combo("Renderer", &rendererMode, rendererLabels, IM_ARRAYSIZE(rendererLabels));
+        if (!precisionStatus.empty()) {
+            ImGui::TextWrapped("Warning: %s", precisionStatus.c_str());
+        }
+        if (rendererMode == RENDERER_CPU_PERTURBATION && !isPerturbationSupported(activeEquationTraits)) {
+            ImGui::TextDisabled("Perturbation needs z^2 + c, using the GPU shader");
+        }
+        if (rendererMode == RENDERER_CPU_ESCAPE_TIME) {
+            static const char* fillModeLabels[] = { "Automatic", "Brute Force", "Subdivision", "Solid Guessing", "Boundary Tracing" };
+            ImGui::Combo("Fill Mode", &fillMode, fillModeLabels, IM_ARRAYSIZE(fillModeLabels));
+            if (fillMode == static_cast<int>(FillMode::SolidGuessing)) {
+                ImGui::Checkbox("Exact Final Pass", &exactFinalPass);
+            }
+            else if (fillMode != static_cast<int>(FillMode::BruteForce) && fillMode != static_cast<int>(FillMode::BoundaryTracing)
+                && !activeEquationTraits.hasConnectedLevelSets) {
+                ImGui::TextDisabled("Subdivision needs z^n + c, iterating every pixel");
+            }
+        }
+        if (rendererMode == RENDERER_GPU_SHADER) {
+            // only pixels on an edge of the frame are iterated again, at grid x grid jittered sub-samples
+            ImGui::SliderInt("Edge Antialiasing", &supersampleGrid, 1, 4, supersampleGrid <= 1 ? "Off" : "%d per side");
+            if (supersampleGrid > 1) {
+                ImGui::SliderFloat("Edge Threshold", &supersampleThreshold, 0.0f, 32.0f, "%.2f");
+            }
+        }
+        if (rendererMode == RENDERER_ITERATION_DATA) {
+            static char pathBuffer[512] = "";
+            ImGui::InputText("File", pathBuffer, IM_ARRAYSIZE(pathBuffer));
+            if (ImGui::Button("Load")) {
+                iterationDataPath = pathBuffer;
+                iterationDataRequested = true;
+            }
+            if (!iterationDataStatus.empty()) {
+                ImGui::TextDisabled("%s", iterationDataStatus.c_str());
+            }
+        }
         
         if (ImGui::Button("Reset")) {
             contrast = 0.5f;
-            zoom = 1.0f;
+            equalizeColors = false;
             iterations = 100;
             escapeRadius = 5.0f;
-            centerX = 0.0;
-            centerY = 0.0;
+            periodicityInterval = 20;
+            distanceEstimation = false;
+            distanceRange = 8.0f;
+            supersampleGrid = 1;
+            supersampleThreshold = 1.0f;
+            view.reset();
+        }
+
+        ImGui::Spacing();
+        ImGui::Separator();
+
+        ImGui::Unindent();
+    }
+
+    if (ImGui::CollapsingHeader("Zoom Path")) {
+        ImGui::Indent(20.0f);
+
+        // the current view becomes the next waypoint, fractal-render --path animates between them
+        ImGui::Text("Waypoints: %d", static_cast<int>(pathWaypoints.size()));
+        if (ImGui::Button("Add Waypoint")) {
+            pathWaypoints.push_back(view);
+        }
+        ImGui::BeginDisabled(pathWaypoints.empty());
+        ImGui::SameLine();
+        if (ImGui::Button("Remove Last")) {
+            pathWaypoints.pop_back();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Go To Last") && !pathWaypoints.empty()) {
+            view = pathWaypoints.back();
+        }
+        ImGui::EndDisabled();
+
+        static char pathBuffer[512] = "path.jsonl";
+        static char videoBuffer[512] = "zoom.y4m";
+        ImGui::InputText("Path File", pathBuffer, IM_ARRAYSIZE(pathBuffer));
+        ImGui::InputText("Video File", videoBuffer, IM_ARRAYSIZE(videoBuffer));
+        ImGui::BeginDisabled(pathWaypoints.empty() || videoBuffer[0] == '\0');
+        if (ImGui::Button("Save Path")) {
+            pathFile = pathBuffer;
+            pathVideoFile = videoBuffer;
+            pathSaveRequested = true;
+        }
+        ImGui::EndDisabled();
+        if (!pathSaveStatus.empty()) {
+            ImGui::TextDisabled("%s", pathSaveStatus.c_str());
+        }
+
+        ImGui::Spacing();
+        ImGui::Separator();
+
+        ImGui::Unindent();
+    }
+
+    if (ImGui::CollapsingHeader("Statistics")) {
+        ImGui::Indent(20.0f);
+
+        ImGui::Checkbox("Collect GPU Statistics", &collectStatistics);
+        ImGui::Text("Render Time: %.2f ms", frameStatistics.renderMilliseconds);
+        ImGui::Text("Histogram Time: %.3f ms", histogramMilliseconds);
+        ImGui::Text("Stopped By Periodicity: %d", frameStatistics.periodicPixels);
+        ImGui::Text("Fill Mode: %s", frameStatistics.fillMode);
+        ImGui::Text("Evaluated Pixels: %d (%.1f%%)", frameStatistics.evaluatedPixels, 100.0 * frameStatistics.evaluatedPixels / std::max(OPENGL_WIDTH * HEIGHT, 1));
+        ImGui::Text("Guessed Pixels: %d", frameStatistics.guessedPixels);
+        ImGui::Text("Delta Precision: %s", frameStatistics.deltaPrecision);
+        ImGui::Text("Glitched Pixels: %d", frameStatistics.glitchedPixels);
+        ImGui::Text("Corrected Pixels: %d", frameStatistics.correctedPixels);
+        ImGui::Text("References Used: %d", frameStatistics.referencesUsed);
+        ImGui::Text("Correction Time: %.2f ms", frameStatistics.correctionMilliseconds);
+        ImGui::Text("Supersampled Pixels: %d", frameStatistics.supersampledPixels);
+
+        if (ImGui::Button("Benchmark Unroll Factors")) {
+            unrollBenchmarkRequested = true;
+        }
+        if (!unrollBenchmarkResults.empty() && ImGui::BeginTable("##UnrollBenchmark", 3, ImGuiTableFlags_Borders)) {
+            ImGui::TableSetupColumn("Equation");
+            ImGui::TableSetupColumn("Unroll");
+            ImGui::TableSetupColumn("GPU ms");
+            ImGui::TableHeadersRow();
+            for (const auto& result : unrollBenchmarkResults) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(result.equation.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", result.unrollFactor);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", result.milliseconds);
+            }
+            ImGui::EndTable();
         }
 
         ImGui::Spacing();
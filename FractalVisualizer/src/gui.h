@@ -9,6 +9,7 @@
 #include <unordered_map>
 #include <array>
 #include <stack>
+#include <cmath>
 
 
 #include "glad/glad.h"
@@ -22,6 +23,8 @@
 #include "state.h"
 #include "shader.h"
 #include "complexParser.h"
+#include "perturbation.h"
+#include "escapeTimeRenderer.h"
 
 struct NamedEquation {
     const char* label;
@@ -36,9 +39,13 @@ void removeFrame();
 void componentsForGUI(Shader& fractalShader);
 
 std::string translateEquationToGLSL(const std::string& equation);
+std::string translateDerivativeToGLSL(const std::string& equation);
 std::vector<std::string> extractVariables(const std::string& equation);
 void updateVariableExistence(const std::vector<std::string>& variables);
 void createVariableSliders();
 void applyEquationTwice(Shader& fractalShader, const char* equation);
 
+int selectUnrollFactor(int requested, const EquationTraits& traits);
+std::vector<std::string> presetEquations();
+
 #endif // !GUI_H
\ No newline at end of file
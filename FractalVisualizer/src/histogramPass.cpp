@@ -0,0 +1,137 @@
+#include "histogramPass.h"
+
+#include "palette.h"
+
+namespace {
+
+unsigned int createCountTexture(int width, int height) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+} // namespace
+
+HistogramPass::HistogramPass() {
+    glGenVertexArrays(1, &pointArray);
+    glGenFramebuffers(1, &framebuffer);
+    glGenQueries(1, &timer);
+}
+
+HistogramPass::~HistogramPass() {
+    resize(0);
+    glDeleteQueries(1, &timer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteVertexArrays(1, &pointArray);
+}
+
+void HistogramPass::resize(int bins) {
+    if (laneTexture != 0) {
+        glDeleteTextures(1, &laneTexture);
+        glDeleteTextures(2, sumTextures);
+        laneTexture = 0;
+        sumTextures[0] = sumTextures[1] = 0;
+        cumulativeTexture = 0;
+    }
+    binCount = bins;
+    if (bins > 0) {
+        laneTexture = createCountTexture(bins, LANES);
+        sumTextures[0] = createCountTexture(bins, 1);
+        sumTextures[1] = createCountTexture(bins, 1);
+    }
+}
+
+void HistogramPass::run(unsigned int iterationTexture, int width, int height, int iterations, unsigned int quadArray) {
+    int bins = histogramBinCount(iterations);
+    if (bins != binCount) {
+        resize(bins);
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // the timer of the last run is still in flight, this one goes untimed
+    bool timed = !timerPending;
+    if (timed) {
+        glBeginQuery(GL_TIME_ELAPSED, timer);
+    }
+
+    // counts, one point per stride x stride block of pixels
+    int stride = 1;
+    while (static_cast<long long>((width + stride - 1) / stride) * ((height + stride - 1) / stride) > MAX_POINTS) {
+        ++stride;
+    }
+    int columns = (width + stride - 1) / stride;
+    int rows = (height + stride - 1) / stride;
+
+    const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, laneTexture, 0);
+    glViewport(0, 0, binCount, LANES);
+    glClearBufferfv(GL_COLOR, 0, zero);
+
+    scatterShader.useShader();
+    scatterShader.setInt("iterationTexture", 0);
+    scatterShader.setInt("sampleColumns", columns);
+    scatterShader.setInt("sampleStride", stride);
+    scatterShader.setFloat("iterations", iterations);
+    scatterShader.setInt("binCount", binCount);
+    scatterShader.setInt("laneCount", LANES);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, iterationTexture);
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glBindVertexArray(pointArray);
+    glDrawArrays(GL_POINTS, 0, columns * rows);
+    glDisable(GL_BLEND);
+
+    // the lanes added up, then running totals with offsets of 1, 2, 4, ...
+    prefixShader.useShader();
+    prefixShader.setInt("source", 0);
+    prefixShader.setInt("laneCount", LANES);
+    glViewport(0, 0, binCount, 1);
+    glBindVertexArray(quadArray);
+
+    unsigned int source = laneTexture;
+    int target = 0;
+    for (int offset = 0; offset < binCount; offset = offset == 0 ? 1 : offset * 2) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sumTextures[target], 0);
+        glBindTexture(GL_TEXTURE_2D, source);
+        prefixShader.setInt("offset", offset);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        source = sumTextures[target];
+        target ^= 1;
+    }
+    cumulativeTexture = source;
+
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        timerPending = true;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+double HistogramPass::getMilliseconds() {
+    if (timerPending) {
+        GLint available = 0;
+        glGetQueryObjectiv(timer, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &nanoseconds);
+            milliseconds = nanoseconds / 1e6;
+            timerPending = false;
+        }
+    }
+    return milliseconds;
+}
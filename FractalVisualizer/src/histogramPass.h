@@ -0,0 +1,55 @@
+#ifndef HISTOGRAM_PASS_H
+#define HISTOGRAM_PASS_H
+
+#include "glad/glad.h"
+
+#include "shader.h"
+
+// IterationHistogram counted on the GPU, so equalized colors never read the iteration texture
+// back. Pixels are drawn as points on their bins with additive blending, spread over LANES rows
+// of bins, then prefixSumFrag.frag adds the rows up and turns the counts into running totals in
+// log2(bins) passes. The result is a bins x 1 R32F texture that colorFrag.frag reads. Float
+// counts are exact up to 2^24 pixels per bin.
+// colorFrag.frag only reads the totals as a fraction of the last one, so above MAX_POINTS pixels
+// one pixel in every stride x stride block is counted, a 4K frame draws 0.9M points, not 8.3M.
+
+class HistogramPass {
+public:
+    HistogramPass();
+    ~HistogramPass();
+
+    HistogramPass(const HistogramPass&) = delete;
+    HistogramPass& operator=(const HistogramPass&) = delete;
+
+    // Counts the red channel of iterationTexture, drawing the prefix sums with quadArray (the
+    // full screen quad). Framebuffer 0 is bound and the viewport restored afterwards.
+    void run(unsigned int iterationTexture, int width, int height, int iterations, unsigned int quadArray);
+
+    unsigned int getCumulativeTexture() const { return cumulativeTexture; }
+    int getBinCount() const { return binCount; }
+
+    // GPU time of the last run whose timer has come back, without waiting for it
+    double getMilliseconds();
+
+private:
+    static constexpr int LANES = 64;
+    static constexpr int MAX_POINTS = 1 << 20;
+
+    Shader scatterShader{ "shaders/histogramFrag.frag", "shaders/histogramVert.vert" };
+    Shader prefixShader{ "shaders/prefixSumFrag.frag" };
+
+    unsigned int pointArray = 0; // no attributes, histogramVert.vert goes by gl_VertexID
+    unsigned int framebuffer = 0;
+    unsigned int laneTexture = 0;
+    unsigned int sumTextures[2] = { 0, 0 };
+    unsigned int cumulativeTexture = 0; // one of sumTextures
+    int binCount = 0;
+
+    unsigned int timer = 0;
+    bool timerPending = false;
+    double milliseconds = 0.0;
+
+    void resize(int bins);
+};
+
+#endif // HISTOGRAM_PASS_H
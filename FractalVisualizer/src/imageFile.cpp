@@ -0,0 +1,44 @@
+#include "imageFile.h"
+#include "pngWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+void writePPM(const std::string& path, int width, int height, const std::vector<uint8_t>& rgba) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<char> row(static_cast<size_t>(width) * 3);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* source = rgba.data() + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; ++x) {
+            row[x * 3] = static_cast<char>(source[x * 4]);
+            row[x * 3 + 1] = static_cast<char>(source[x * 4 + 1]);
+            row[x * 3 + 2] = static_cast<char>(source[x * 4 + 2]);
+        }
+        file.write(row.data(), row.size());
+    }
+    if (!file) {
+        throw std::runtime_error("Can't write " + path);
+    }
+}
+
+bool isPNGPath(const std::string& path) {
+    std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".png";
+}
+
+void writeImage(const std::string& path, int width, int height, const std::vector<uint8_t>& rgba, int threadCount) {
+    if (isPNGPath(path)) {
+        writePNG(path, width, height, rgba, threadCount);
+    }
+    else {
+        writePPM(path, width, height, rgba);
+    }
+}
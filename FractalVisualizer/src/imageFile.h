@@ -0,0 +1,19 @@
+#ifndef IMAGE_FILE_H
+#define IMAGE_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Image files written without image libraries, rgba is RGBA8 with the top row first
+
+// binary P6, alpha is dropped
+void writePPM(const std::string& path, int width, int height, const std::vector<uint8_t>& rgba);
+
+// case-insensitive .png
+bool isPNGPath(const std::string& path);
+
+// PNG for paths ending in .png (see pngWriter.h), PPM otherwise
+void writeImage(const std::string& path, int width, int height, const std::vector<uint8_t>& rgba, int threadCount = 0);
+
+#endif // IMAGE_FILE_H
@@ -0,0 +1,366 @@
+#include "iterationFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "palette.h"
+#include "parallelFor.h"
+
+namespace {
+
+const char MAGIC[8] = { 'F', 'R', 'A', 'C', 'I', 'T', 'E', 'R' };
+const uint32_t VERSION = 1;
+const size_t HEADER_BYTES = 64;
+const uint64_t PAGE_BYTES = 4096;
+
+void put(uint8_t* data, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) data[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint64_t get(const uint8_t* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    return value;
+}
+
+uint32_t spreadBits(uint32_t value) {
+    value &= 0xffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
+
+uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(uint64_t bits) {
+    uint32_t narrow = static_cast<uint32_t>(bits);
+    float value;
+    std::memcpy(&value, &narrow, sizeof(value));
+    return value;
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+void IterationFileWriter::layOut() {
+    tilesAcross = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesDown = (height + TILE_SIZE - 1) / TILE_SIZE;
+    indexOffset = alignUp(HEADER_BYTES + description.size(), 8);
+    dataOffset = alignUp(indexOffset + static_cast<uint64_t>(tilesAcross) * tilesDown * 8, PAGE_BYTES);
+    pending.clear();
+
+    // the grid is rarely a power of two, so tiles are sorted by Morton code and numbered in that order
+    std::vector<std::pair<uint32_t, int>> order;
+    for (int tileY = 0; tileY < tilesDown; ++tileY) {
+        for (int tileX = 0; tileX < tilesAcross; ++tileX) order.push_back({ spreadBits(tileX) | (spreadBits(tileY) << 1), tileY * tilesAcross + tileX });
+    }
+    std::sort(order.begin(), order.end());
+    slotOfTile.assign(order.size(), 0);
+    for (size_t slot = 0; slot < order.size(); ++slot) slotOfTile[order[slot].second] = static_cast<int>(slot);
+}
+
+void IterationFileWriter::create(const std::string& path, int width, int height, int iterations, const std::string& description, float basinRadius) {
+    if (width <= 0 || height <= 0 || width > 0xffff * TILE_SIZE || height > 0xffff * TILE_SIZE) {
+        throw std::runtime_error("Can't store iteration data of a " + std::to_string(width) + "x" + std::to_string(height) + " image");
+    }
+    this->path = path;
+    this->width = width;
+    this->height = height;
+    this->iterations = iterations;
+    this->description = description;
+    this->basinRadius = basinRadius;
+    layOut();
+    offsets.assign(static_cast<size_t>(tilesAcross) * tilesDown, 0);
+
+    std::vector<uint8_t> head(indexOffset, 0);
+    std::memcpy(head.data(), MAGIC, sizeof(MAGIC));
+    put(head.data() + 8, VERSION, 4);
+    put(head.data() + 12, TILE_SIZE, 4);
+    put(head.data() + 16, width, 4);
+    put(head.data() + 20, height, 4);
+    put(head.data() + 24, tilesAcross, 4);
+    put(head.data() + 28, tilesDown, 4);
+    put(head.data() + 32, iterations, 4);
+    put(head.data() + 36, description.size(), 4);
+    put(head.data() + 40, indexOffset, 8);
+    put(head.data() + 48, dataOffset, 8);
+    put(head.data() + 56, floatBits(basinRadius), 4);
+    std::memcpy(head.data() + HEADER_BYTES, description.data(), description.size());
+
+    file.close();
+    file.clear();
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    file.write(reinterpret_cast<const char*>(head.data()), head.size());
+    file.close();
+
+    // the index starts out all 0, and the records are left as a hole until they are written
+    std::filesystem::resize_file(path, dataOffset + offsets.size() * RECORD_BYTES);
+    file.clear();
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) fail("Can't write");
+}
+
+void IterationFileWriter::open(const std::string& path) {
+    this->path = path;
+    file.close();
+    file.clear();
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+
+    uint8_t header[HEADER_BYTES];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) fail("Isn't iteration data");
+    if (get(header + 8, 4) != VERSION || get(header + 12, 4) != TILE_SIZE) fail("Is a version this can't add to");
+
+    width = static_cast<int>(get(header + 16, 4));
+    height = static_cast<int>(get(header + 20, 4));
+    iterations = static_cast<int>(get(header + 32, 4));
+    basinRadius = bitsFloat(get(header + 56, 4));
+    description.assign(get(header + 36, 4), '\0');
+    file.read(description.data(), static_cast<std::streamsize>(description.size()));
+    if (!file || width <= 0 || height <= 0) fail("Is damaged");
+
+    layOut();
+    if (get(header + 24, 4) != static_cast<uint64_t>(tilesAcross) || get(header + 28, 4) != static_cast<uint64_t>(tilesDown) ||
+        get(header + 40, 8) != indexOffset || get(header + 48, 8) != dataOffset) {
+        fail("Is damaged");
+    }
+
+    std::vector<uint8_t> index(static_cast<size_t>(tilesAcross) * tilesDown * 8);
+    file.seekg(static_cast<std::streamoff>(indexOffset));
+    file.read(reinterpret_cast<char*>(index.data()), static_cast<std::streamsize>(index.size()));
+    if (!file) fail("Is cut short");
+    offsets.resize(static_cast<size_t>(tilesAcross) * tilesDown);
+    for (size_t tile = 0; tile < offsets.size(); ++tile) offsets[tile] = get(index.data() + tile * 8, 8);
+}
+
+bool IterationFileWriter::hasTile(int tileX, int tileY) const {
+    return offsets[static_cast<size_t>(tileY) * tilesAcross + tileX] != 0;
+}
+
+void IterationFileWriter::writeTiles(const TiledFramebuffer& image, int left, int top, int threadCount) {
+    int right = left + image.getWidth();
+    int bottom = top + image.getHeight();
+    if (left < 0 || top < 0 || right > width || bottom > height || left % TILE_SIZE != 0 || top % TILE_SIZE != 0 ||
+        (right != width && right % TILE_SIZE != 0) || (bottom != height && bottom % TILE_SIZE != 0)) {
+        fail("Was given a part of the image that isn't whole tiles");
+    }
+
+    // in slot order, so a batch's records are written front to back
+    std::vector<std::pair<uint32_t, int>> tiles;
+    for (int tileY = top / TILE_SIZE; tileY * TILE_SIZE < bottom; ++tileY) {
+        for (int tileX = left / TILE_SIZE; tileX * TILE_SIZE < right; ++tileX) {
+            if (hasTile(tileX, tileY)) continue;
+            tiles.push_back({ spreadBits(tileX) | (spreadBits(tileY) << 1), tileY * tilesAcross + tileX });
+        }
+    }
+    std::sort(tiles.begin(), tiles.end());
+
+    // the framebuffer's rows go bottom up, the file's top down
+    const size_t recordFloats = RECORD_BYTES / sizeof(float);
+    std::vector<float> records(tiles.size() * recordFloats, 0.0f);
+    parallelFor(static_cast<int>(tiles.size()), threadCount, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            int tileX = tiles[i].second % tilesAcross;
+            int tileY = tiles[i].second / tilesAcross;
+            float* smooth = records.data() + i * recordFloats;
+            float* magnitude = smooth + TILE_SIZE * TILE_SIZE;
+
+            int x0 = tileX * TILE_SIZE - left;
+            int columns = std::min(TILE_SIZE, right - tileX * TILE_SIZE);
+            int rows = std::min(TILE_SIZE, bottom - tileY * TILE_SIZE);
+            for (int row = 0; row < rows; ++row) {
+                int y = image.getHeight() - 1 - (tileY * TILE_SIZE + row - top);
+                size_t index = image.index(x0, y);
+                std::memcpy(smooth + row * TILE_SIZE, &image.smoothIterations[index], columns * sizeof(float));
+                for (int x = 0; x < columns; ++x) {
+                    double real = image.finalReal[index + x];
+                    double imag = image.finalImag[index + x];
+                    magnitude[row * TILE_SIZE + x] = basinRadius > 0.0f
+                        ? rootBasin(image.smoothIterations[index + x], iterations, real, imag, basinRadius)
+                        : static_cast<float>(std::sqrt(real * real + imag * imag));
+                }
+            }
+        }
+    });
+
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        int tile = tiles[i].second;
+        uint64_t offset = dataOffset + static_cast<uint64_t>(slotOfTile[tile]) * RECORD_BYTES;
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(reinterpret_cast<const char*>(records.data() + i * recordFloats), static_cast<std::streamsize>(RECORD_BYTES));
+        if (!file) fail("Can't write");
+        offsets[tile] = offset;
+        pending.push_back(tile);
+    }
+}
+
+void IterationFileWriter::commit() {
+    file.flush();
+    for (int tile : pending) {
+        uint8_t bytes[8];
+        put(bytes, offsets[tile], 8);
+        file.seekp(static_cast<std::streamoff>(indexOffset + tile * 8ull));
+        file.write(reinterpret_cast<const char*>(bytes), 8);
+    }
+    file.flush();
+    if (!file) fail("Can't write");
+    pending.clear();
+}
+
+void IterationFileWriter::close() {
+    commit();
+    file.close();
+}
+
+void IterationFileWriter::fail(const std::string& message) const {
+    throw std::runtime_error(path + ": " + message);
+}
+
+void writeIterationFile(const std::string& path, const TiledFramebuffer& image, int iterations, const std::string& description, int threadCount,
+    float basinRadius) {
+    IterationFileWriter writer;
+    writer.create(path, image.getWidth(), image.getHeight(), iterations, description, basinRadius);
+    writer.writeTiles(image, 0, 0, threadCount);
+    writer.close();
+}
+
+IterationFile::~IterationFile() {
+    close();
+}
+
+void IterationFile::open(const std::string& path) {
+    close();
+
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    LARGE_INTEGER length;
+    if (GetFileSizeEx(handle, &length) && length.QuadPart > 0) {
+        mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            size = static_cast<size_t>(length.QuadPart);
+        }
+    }
+    CloseHandle(handle);
+#else
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) == 0 && status.st_size > 0) {
+        void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const uint8_t*>(mapped);
+            size = static_cast<size_t>(status.st_size);
+        }
+    }
+    ::close(descriptor);
+#endif
+    if (!data) {
+        close();
+        throw std::runtime_error("Can't map " + path);
+    }
+
+    auto fail = [&](const std::string& message) {
+        close();
+        throw std::runtime_error(path + ": " + message);
+    };
+
+    if (size < HEADER_BYTES || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) fail("Isn't iteration data");
+    if (get(data + 8, 4) != VERSION || get(data + 12, 4) != TILE_SIZE) fail("Is a version this can't read");
+
+    width = static_cast<int>(get(data + 16, 4));
+    height = static_cast<int>(get(data + 20, 4));
+    tilesAcross = static_cast<int>(get(data + 24, 4));
+    tilesDown = static_cast<int>(get(data + 28, 4));
+    iterations = static_cast<int>(get(data + 32, 4));
+    basinRadius = bitsFloat(get(data + 56, 4));
+    uint64_t descriptionLength = get(data + 36, 4);
+    uint64_t indexOffset = get(data + 40, 8);
+    uint64_t tileCount = static_cast<uint64_t>(tilesAcross) * tilesDown;
+    if (width <= 0 || height <= 0 || tilesAcross != (width + TILE_SIZE - 1) / TILE_SIZE || tilesDown != (height + TILE_SIZE - 1) / TILE_SIZE ||
+        HEADER_BYTES + descriptionLength > size || indexOffset % 8 != 0 || indexOffset > size || tileCount * 8 > size - indexOffset) {
+        fail("Is damaged");
+    }
+    description.assign(reinterpret_cast<const char*>(data + HEADER_BYTES), descriptionLength);
+    index = data + indexOffset;
+
+    // every record the index points to has to be whole and aligned for floats
+    for (uint64_t tile = 0; tile < tileCount; ++tile) {
+        uint64_t offset = get(index + tile * 8, 8);
+        if (offset != 0 && (offset % sizeof(float) != 0 || offset > size || IterationFileWriter::RECORD_BYTES > size - offset)) fail("Is damaged");
+    }
+}
+
+void IterationFile::close() {
+    if (data) {
+#if defined(_WIN32)
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<uint8_t*>(data), size);
+#endif
+    }
+#if defined(_WIN32)
+    if (mapping) CloseHandle(mapping);
+#endif
+    data = nullptr;
+    size = 0;
+    mapping = nullptr;
+    index = nullptr;
+    width = height = tilesAcross = tilesDown = iterations = 0;
+    basinRadius = 0.0f;
+    description.clear();
+}
+
+uint64_t IterationFile::recordOffset(int tileX, int tileY) const {
+    if (!data || tileX < 0 || tileY < 0 || tileX >= tilesAcross || tileY >= tilesDown) return 0;
+    return get(index + (static_cast<size_t>(tileY) * tilesAcross + tileX) * 8, 8);
+}
+
+const float* IterationFile::smoothTile(int tileX, int tileY) const {
+    uint64_t offset = recordOffset(tileX, tileY);
+    return offset == 0 ? nullptr : reinterpret_cast<const float*>(data + offset);
+}
+
+const float* IterationFile::magnitudeTile(int tileX, int tileY) const {
+    uint64_t offset = recordOffset(tileX, tileY);
+    return offset == 0 ? nullptr : reinterpret_cast<const float*>(data + offset) + TILE_PIXELS;
+}
+
+float IterationFile::smoothAt(int x, int y) const {
+    const float* tile = smoothTile(x / TILE_SIZE, y / TILE_SIZE);
+    return tile ? tile[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE] : 0.0f;
+}
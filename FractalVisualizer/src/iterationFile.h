@@ -0,0 +1,142 @@
+#ifndef ITERATION_FILE_H
+#define ITERATION_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tiledFramebuffer.h"
+
+// Raw iteration data of a render, so it can be colored again without iterating anything. The
+// file is made to be memory mapped: every tile is a fixed size record at a page aligned offset,
+// and the values are little-endian floats read in place.
+//
+//   offset  size  field
+//        0     8  magic "FRACITER"
+//        8     4  version, 1
+//       12     4  tile size, 64
+//       16     4  width
+//       20     4  height
+//       24     4  tiles across, (width + 63) / 64
+//       28     4  tiles down, (height + 63) / 64
+//       32     4  iteration limit of the render, smooth values at or above it are inside
+//       36     4  description length
+//       40     8  index offset
+//       48     8  data offset, a multiple of 4096
+//       56     4  basin radius, a float, 0 unless the equation converges
+//       60     4  reserved, 0
+//       64        description, the job as formatRenderJob writes it (UTF-8 JSON, no terminator)
+//
+// The index holds one uint64 per tile, tile rows from the top and tiles left to right in each
+// row, with the offset of the tile's record or 0 for a tile that hasn't been written yet. A
+// record is 64x64 floats of smooth iterations (what getSmoothIterations returns) followed by
+// 64x64 floats of |z| where the pixel stopped iterating, both with the top row first. When the
+// basin radius isn't 0 the second plane holds the root basin of each pixel instead, rootBasin in
+// palette.h with that escape radius, since the roots of converging equations differ by angle.
+// Pixels of edge tiles past the image are 0. Records are stored in Morton order of their tiles, but
+// readers only go by the index.
+
+class IterationFileWriter {
+public:
+    static constexpr int TILE_SIZE = TiledFramebuffer::TILE_SIZE;
+    static constexpr size_t RECORD_BYTES = static_cast<size_t>(TILE_SIZE) * TILE_SIZE * 2 * sizeof(float);
+
+    // creates path, replacing any file there, basinRadius is colorize's
+    void create(const std::string& path, int width, int height, int iterations, const std::string& description, float basinRadius = 0.0f);
+
+    // opens a file create wrote to add the missing tiles, throws std::runtime_error for anything else
+    void open(const std::string& path);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getIterations() const { return iterations; }
+    const std::string& getDescription() const { return description; }
+
+    bool hasTile(int tileX, int tileY) const;
+
+    // Writes every tile image covers, left and top being where its top left pixel is in the
+    // whole image. Both are multiples of the tile size, unless image reaches the right or the
+    // bottom edge. Tiles already in the file are kept, index entries are written by the next commit.
+    void writeTiles(const TiledFramebuffer& image, int left, int top, int threadCount = 0);
+
+    // flushes the records written so far and only then the index entries that point to them
+    void commit();
+
+    void close();
+
+private:
+    std::fstream file;
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int tilesAcross = 0;
+    int tilesDown = 0;
+    int iterations = 0;
+    std::string description;
+    float basinRadius = 0.0f;
+    uint64_t indexOffset = 0;
+    uint64_t dataOffset = 0;
+    std::vector<uint64_t> offsets; // the index as committed
+    std::vector<int> slotOfTile; // row-major tile grid to record number
+    std::vector<int> pending;
+
+    void layOut();
+    void fail(const std::string& message) const;
+};
+
+// the whole of a render in one go
+void writeIterationFile(const std::string& path, const TiledFramebuffer& image, int iterations, const std::string& description, int threadCount = 0,
+    float basinRadius = 0.0f);
+
+// Read only memory map of an iteration file. Tiles are read in place, so a render of any size
+// can be colored again in one pass over the mapping.
+class IterationFile {
+public:
+    static constexpr int TILE_SIZE = IterationFileWriter::TILE_SIZE;
+    static constexpr int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+
+    IterationFile() = default;
+    ~IterationFile();
+    IterationFile(const IterationFile&) = delete;
+    IterationFile& operator=(const IterationFile&) = delete;
+
+    // throws std::runtime_error for files that aren't iteration data or are damaged
+    void open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getTilesAcross() const { return tilesAcross; }
+    int getTilesDown() const { return tilesDown; }
+    int getIterations() const { return iterations; }
+    const std::string& getDescription() const { return description; }
+    float getBasinRadius() const { return basinRadius; } // magnitudeTile holds root basins when it isn't 0
+
+    // TILE_SIZE x TILE_SIZE values with the top row first, nullptr for tiles that weren't written
+    const float* smoothTile(int tileX, int tileY) const;
+    const float* magnitudeTile(int tileX, int tileY) const;
+
+    // x from the left and y from the top, 0 for pixels of missing tiles
+    float smoothAt(int x, int y) const;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    void* mapping = nullptr; // the mapping object on Windows
+
+    int width = 0;
+    int height = 0;
+    int tilesAcross = 0;
+    int tilesDown = 0;
+    int iterations = 0;
+    std::string description;
+    float basinRadius = 0.0f;
+    const uint8_t* index = nullptr;
+
+    uint64_t recordOffset(int tileX, int tileY) const;
+};
+
+#endif // ITERATION_FILE_H
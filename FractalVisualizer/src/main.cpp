@@ -1,5 +1,8 @@
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
 #include <vector>
 
 #include "imgui.h"
@@ -15,6 +18,18 @@
 #include "controls.h"
 #include "gui.h"
 #include "state.h"
+#include "perturbation.h"
+#include "escapeTimeRenderer.h"
+#include "escapeTime.h"
+#include "shaderVariants.h"
+#include "iterationFile.h"
+#include "parallelFor.h"
+#include "palette.h"
+#include "histogramPass.h"
+#include "supersamplePass.h"
+#include "renderJobs.h"
+
+#include <memory>
 
 int HEIGHT;
 int OPENGL_WIDTH;
@@ -23,10 +38,39 @@ int IMGUI_WIDTH;
 int iterations;
 float contrast;
 float escapeRadius;
+int periodicityInterval;
+bool distanceEstimation = false;
+float distanceRange = 8.0f;
+int unrollFactor = 0;
+bool specializeShader = true;
+int fillMode = static_cast<int>(FillMode::Automatic);
+bool exactFinalPass = false;
 
 std::vector<float> stopPositions;
 
 std::vector<glm::vec4> colorStops;
+int paletteInterpolation = static_cast<int>(PaletteInterpolation::Linear);
+int paletteRepeats = 0;
+int paletteSize = 1024;
+bool equalizeColors = false;
+double histogramMilliseconds = 0.0;
+int supersampleGrid = 1;
+float supersampleThreshold = 1.0f;
+
+int rendererMode = RENDERER_GPU_SHADER;
+FrameStatistics frameStatistics;
+bool collectStatistics = false;
+std::string precisionStatus;
+bool unrollBenchmarkRequested = false;
+std::vector<UnrollBenchmarkResult> unrollBenchmarkResults;
+std::string iterationDataPath;
+bool iterationDataRequested = false;
+std::string iterationDataStatus;
+std::vector<ViewState> pathWaypoints;
+std::string pathFile;
+std::string pathVideoFile;
+bool pathSaveRequested = false;
+std::string pathSaveStatus;
 
 float vertices[] = {
 	-1.0, -1.0, 0.0,
@@ -44,6 +88,203 @@ static void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
 	glViewport(0, 0, width, height);
 }
 
+// Z_n of the reference orbit as RG32F texels, rows of REFERENCE_TEXTURE_WIDTH in fractalFrag.frag
+static void uploadReferenceOrbit(unsigned int texture, const ReferenceOrbit& reference) {
+	const int textureWidth = 1024;
+	int length = static_cast<int>(reference.real.size());
+	int textureHeight = (length + textureWidth - 1) / textureWidth;
+
+	std::vector<float> texels(textureWidth * textureHeight * 2, 0.0f);
+	for (int i = 0; i < length; ++i) {
+		texels[i * 2] = static_cast<float>(reference.real[i]);
+		texels[i * 2 + 1] = static_cast<float>(reference.imag[i]);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, textureWidth, textureHeight, 0, GL_RG, GL_FLOAT, texels.data());
+}
+
+// the GUI's palette in the form the CPU renderers take
+static Palette currentPalette() {
+	Palette palette;
+	palette.colors.clear();
+	for (const glm::vec4& stop : colorStops) {
+		palette.colors.push_back({ stop.r, stop.g, stop.b, stop.a });
+	}
+	palette.positions = stopPositions;
+	palette.contrast = contrast;
+	palette.interpolation = static_cast<PaletteInterpolation>(paletteInterpolation);
+	palette.repeats = paletteRepeats;
+	palette.lutSize = paletteSize;
+	return palette;
+}
+
+// one job per waypoint, every one with the GUI's settings so the file renders as it looks here
+static void savePath(const std::string& path) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Can't write " + path);
+	}
+
+	for (const ViewState& waypoint : pathWaypoints) {
+		RenderJob job;
+		job.output = pathVideoFile;
+		job.request.width = OPENGL_WIDTH;
+		job.request.height = HEIGHT;
+		job.request.view.logZoom = waypoint.logZoom;
+		job.request.equation = activeEquation;
+		for (const auto& [name, control] : variableControls) {
+			job.request.variables[name] = { control.value.x, control.value.y };
+		}
+		job.request.iterations = iterations;
+		job.request.escapeRadius = escapeRadius;
+		job.request.periodicityInterval = periodicityInterval;
+		job.request.distanceEstimation = distanceEstimation;
+		job.request.distanceRange = distanceRange;
+		job.request.palette = currentPalette();
+		job.request.palette.equalize = equalizeColors;
+
+		// jobs take c, the view keeps half of it, written with every digit its bits hold
+		BigFixed centerReal = waypoint.centerX;
+		BigFixed centerImag = waypoint.centerY;
+		centerReal.shiftLeft(1);
+		centerImag.shiftLeft(1);
+		int digits = static_cast<int>(std::ceil(centerReal.fractionalBits() * std::log10(2.0)));
+		job.centerReal = centerReal.toString(digits);
+		job.centerImag = centerImag.toString(digits);
+		file << formatRenderJob(job) << "\n";
+	}
+	if (!file) {
+		throw std::runtime_error("Can't write " + path);
+	}
+}
+
+// the palette texture is bound to unit 2 and the running totals of the histogram to unit 3
+static void setColorUniforms(const Shader& shader, const HistogramPass& histogram) {
+	shader.setInt("paletteTexture", 2);
+	shader.setInt("paletteSize", std::max(paletteSize, 1));
+	shader.setInt("paletteRepeats", paletteRepeats);
+	shader.setInt("equalize", equalizeColors);
+	shader.setInt("cumulativeHistogram", 3);
+	shader.setInt("histogramBins", histogram.getBinCount());
+	shader.setFloat("iterations", iterations);
+	shader.setFloat("contrast", contrast);
+	shader.setVec2("iResolution", glm::vec2(OPENGL_WIDTH, HEIGHT));
+}
+
+// everything getSmoothIterations reads apart from perturbation
+static void setFractalUniforms(const Shader& shader) {
+	shader.setFloat("iterations", iterations);
+	shader.setVec2("iResolution", glm::vec2(OPENGL_WIDTH, HEIGHT));
+	shader.setFloat("zoom", static_cast<double>(view.getZoom()));
+	shader.setFloat("centerX", view.centerX.toDouble());
+	shader.setFloat("centerY", view.centerY.toDouble());
+	shader.setFloat("escapeRadius", escapeRadius);
+	shader.setInt("interiorTest", activeEquationTraits.isQuadraticMandelbrot);
+	shader.setInt("convergenceTest", activeEquationTraits.converges);
+	shader.setFloat("convergenceEpsilon", CONVERGENCE_EPSILON);
+	shader.setInt("nonFiniteBailout", activeEquationTraits.canOverflow);
+	shader.setInt("periodicityInterval", periodicityInterval);
+	shader.setFloat("periodicityTolerance", static_cast<double>(view.getZoom()) * 2.0 / HEIGHT / 1024.0);
+	shader.setInt("distanceEstimation", distanceEstimation);
+	shader.setFloat("distanceRange", distanceRange);
+
+	for (auto& [name, control] : variableControls) {
+		shader.setVec2(name.c_str(), control.value);
+	}
+}
+
+// What the shader's iteration pass reads. Its output is kept until one of these changes, so
+// editing the palette only reruns the coloring pass.
+struct IterationPassKey {
+	EscapeTimeSettings escapeTime; // view, equation, variables and the loop settings
+	PerturbationSettings perturbation; // the full precision center for deep views
+	int deltaMode = -1;
+	int unrollFactor = 0;
+	int supersampleGrid = 1; // the sub-sample pass runs after the iteration pass
+	float supersampleThreshold = 0.0f;
+
+	bool operator==(const IterationPassKey&) const = default;
+};
+
+// how long iterations and the escape radius have to stay the same before they are baked in
+static constexpr double FREEZE_SECONDS = 0.5;
+
+// iterations and the escape radius once they've settled, and the variables marked constant
+static ShaderSpecialization frozenUniforms() {
+	static int lastIterations = -1;
+	static float lastEscapeRadius = -1.0f;
+	static double lastChange = 0.0;
+
+	double now = glfwGetTime();
+	if (iterations != lastIterations || escapeRadius != lastEscapeRadius) {
+		lastIterations = iterations;
+		lastEscapeRadius = escapeRadius;
+		lastChange = now;
+	}
+
+	ShaderSpecialization specialization;
+	if (now - lastChange > FREEZE_SECONDS) {
+		specialization["iterations"] = Shader::floatLiteral(iterations);
+		specialization["escapeRadius"] = Shader::floatLiteral(escapeRadius);
+	}
+	for (auto& [name, control] : variableControls) {
+		if (control.isConstant) {
+			specialization[name] = "vec2(" + Shader::floatLiteral(control.value.x) + ", " + Shader::floatLiteral(control.value.y) + ")";
+		}
+	}
+	return specialization;
+}
+
+// Draws every preset at the current view with each unroll factor and keeps the fastest GPU time
+// of a few frames, then puts the active equation back
+static void runUnrollBenchmark(Shader& fractalShader, unsigned int VAO) {
+	const int unrollFactors[] = { 1, 2, 4, 8, 16 };
+	const int frames = 5;
+	std::string equation = activeEquation;
+	auto savedControls = variableControls;
+
+	unsigned int query;
+	glGenQueries(1, &query);
+	glBindVertexArray(VAO);
+	unrollBenchmarkResults.clear();
+
+	for (const std::string& preset : presetEquations()) {
+		EquationTraits traits = analyzeEquation(preset);
+		activeEquationTraits = traits;
+		std::vector<std::string> variables = extractVariables(preset);
+		updateVariableExistence(variables);
+
+		for (int factor : unrollFactors) {
+			fractalShader.reload(variables, translateEquationToGLSL(preset), translateDerivativeToGLSL(preset), factor);
+			fractalShader.useShader();
+			setFractalUniforms(fractalShader);
+			fractalShader.setInt("deltaMode", 0);
+
+			// the first draw compiles whatever the driver deferred
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+			glFinish();
+
+			double best = 0.0;
+			for (int i = 0; i < frames; ++i) {
+				glBeginQuery(GL_TIME_ELAPSED, query);
+				glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+				glEndQuery(GL_TIME_ELAPSED);
+
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+				double milliseconds = nanoseconds / 1e6;
+				best = i == 0 ? milliseconds : std::min(best, milliseconds);
+			}
+			unrollBenchmarkResults.push_back({ preset, factor, best });
+		}
+	}
+
+	glDeleteQueries(1, &query);
+	variableControls = savedControls;
+	applyEquationTwice(fractalShader, equation.c_str());
+}
+
 int main() {
 
 	if (!glfwInit()) {
@@ -104,12 +345,83 @@ int main() {
 	setupGUI(window);
 
 	Shader fractalShader;
-
-	std::vector<float> pixelData(OPENGL_WIDTH * HEIGHT * 3, 0.0f);
+	Shader colorShader("shaders/colorFrag.frag");
+	auto shaderVariants = std::make_unique<ShaderVariantCache>(window);
+	auto histogramPass = std::make_unique<HistogramPass>();
+	auto supersamplePass = std::make_unique<SupersamplePass>();
+
+	// smooth iterations from the CPU renderers, colored by colorShader
+	unsigned int iterationTexture;
+	glGenTextures(1, &iterationTexture);
+	glBindTexture(GL_TEXTURE_2D, iterationTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	std::vector<float> cpuIterations;
+	TiledFramebuffer cpuFramebuffer;
+	PerturbationSettings lastPerturbationSettings;
+	EscapeTimeSettings lastEscapeTimeSettings;
+	bool escapeTimeFailed = false;
+	std::vector<char> guessedPixels;
+	bool refinementPending = false;
+
+	// stays mapped while shown, and is sampled again at the window size when that changes
+	IterationFile iterationData;
+	int iterationDataWidth = 0;
+	int iterationDataHeight = 0;
+
+	// reference orbit for deep views in the GPU shader
+	unsigned int referenceTexture;
+	glGenTextures(1, &referenceTexture);
+	glBindTexture(GL_TEXTURE_2D, referenceTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	ReferenceOrbit shaderReference;
+	PerturbationSettings lastReferenceSettings;
+
+	// smooth iterations of the shader's iteration pass, see fractalFrag.frag for the second channel
+	unsigned int gpuIterationTexture;
+	glGenTextures(1, &gpuIterationTexture);
+	glBindTexture(GL_TEXTURE_2D, gpuIterationTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// bakePalette's table, baked again only when the palette changes
+	unsigned int paletteTexture;
+	glGenTextures(1, &paletteTexture);
+	glBindTexture(GL_TEXTURE_1D, paletteTexture);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_1D, 0);
+	Palette lastPalette;
+	lastPalette.lutSize = 0;
+
+	unsigned int iterationFramebuffer;
+	glGenFramebuffers(1, &iterationFramebuffer);
+	IterationPassKey lastIterationPass;
+	int gpuIterationWidth = 0;
+	int gpuIterationHeight = 0;
+
+	// counted again only when the colored iterations change
+	unsigned int histogramSource = 0;
+	int histogramIterations = 0;
+	bool histogramStale = true;
+
+	std::vector<unsigned char> statisticsReadback;
 
 	iterations = 100;
 	contrast = 0.5f;
 	escapeRadius = 5;
+	periodicityInterval = 20;
 
 	stopPositions = { 0.0f, 0.3f, 0.7f, 1.0f };
 
@@ -124,45 +436,313 @@ int main() {
 
 		glViewport(0, 0, OPENGL_WIDTH, HEIGHT);
 
+		if (unrollBenchmarkRequested) {
+			runUnrollBenchmark(fractalShader, VAO);
+			unrollBenchmarkRequested = false;
+			lastIterationPass = IterationPassKey();
+		}
+
+		if (iterationDataRequested) {
+			iterationDataRequested = false;
+			try {
+				iterationData.open(iterationDataPath);
+				iterations = iterationData.getIterations();
+				iterationDataStatus = std::to_string(iterationData.getWidth()) + "x" + std::to_string(iterationData.getHeight()) + ", " + std::to_string(iterations) + " iterations";
+			}
+			catch (const std::exception& e) {
+				iterationDataStatus = e.what();
+			}
+			iterationDataWidth = 0;
+		}
+
+		if (pathSaveRequested) {
+			pathSaveRequested = false;
+			try {
+				savePath(pathFile);
+				pathSaveStatus = std::to_string(pathWaypoints.size()) + " waypoints saved";
+			}
+			catch (const std::exception& e) {
+				pathSaveStatus = e.what();
+			}
+		}
+
 		glClearColor(0.003f, 0.04f, 0.15f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		fractalShader.useShader();
-
 		createFrame();
 		componentsForGUI(fractalShader);
 		renderFrame();
 
-		fractalShader.setFloat("zoom", zoom);
-		fractalShader.setFloat("centerX", centerX);
-		fractalShader.setFloat("centerY", centerY);
-		fractalShader.setFloat("iterations", iterations);
+		PerturbationSettings settings;
+		settings.width = OPENGL_WIDTH;
+		settings.height = HEIGHT;
+		settings.centerX = view.centerX;
+		settings.centerY = view.centerY;
+		settings.zoom = view.getZoom();
+		settings.iterations = iterations;
+		settings.escapeRadius = escapeRadius;
+		settings.periodicityInterval = periodicityInterval;
+		settings.distanceEstimation = distanceEstimation;
+		settings.distanceRange = distanceRange;
+
+		EscapeTimeSettings escapeTimeSettings;
+		escapeTimeSettings.width = OPENGL_WIDTH;
+		escapeTimeSettings.height = HEIGHT;
+		escapeTimeSettings.centerX = view.centerX.toDouble();
+		escapeTimeSettings.centerY = view.centerY.toDouble();
+		escapeTimeSettings.zoom = static_cast<double>(settings.zoom);
+		escapeTimeSettings.iterations = iterations;
+		escapeTimeSettings.escapeRadius = escapeRadius;
+		escapeTimeSettings.periodicityInterval = periodicityInterval;
+		escapeTimeSettings.distanceEstimation = distanceEstimation;
+		escapeTimeSettings.distanceRange = distanceRange;
+		escapeTimeSettings.fillMode = static_cast<FillMode>(fillMode);
+		escapeTimeSettings.exactFinalPass = exactFinalPass;
+		escapeTimeSettings.equation = activeEquation;
+		for (auto& [name, control] : variableControls) {
+			escapeTimeSettings.variables[name] = { control.value.x, control.value.y };
+		}
 
-		fractalShader.setVec4Array("colorStops", colorStops);
-		fractalShader.setFloatArray("stopPositions", stopPositions);
-		fractalShader.setInt("iterations", iterations);
-		fractalShader.setFloat("contrast", contrast);
-		fractalShader.setFloat("escapeRadius", escapeRadius);
+		// perturbation only takes over for z^2 + c, the direct renderers quantize past their precision
+		double viewPixelLog2 = view.logZoom + 1.0 - std::log2(std::max(OPENGL_WIDTH, HEIGHT));
+		bool perturbed = isPerturbationSupported(activeEquationTraits) && (rendererMode == RENDERER_GPU_SHADER || rendererMode == RENDERER_CPU_PERTURBATION);
+		if (perturbed || rendererMode == RENDERER_ITERATION_DATA) {
+			precisionStatus.clear();
+		}
+		else if (rendererMode == RENDERER_CPU_ESCAPE_TIME && !escapeTimeFailed) {
+			precisionStatus = quantizationWarning(viewPixelLog2, DOUBLE_PIXEL_LOG2, "doubles");
+		}
+		else {
+			precisionStatus = quantizationWarning(viewPixelLog2, FLOAT_PIXEL_LOG2, "the shader's floats");
+		}
 
-		fractalShader.setVec2("iResolution", glm::vec2(OPENGL_WIDTH, HEIGHT));
+		// an equation the CPU can't evaluate falls back to the shader, which shows the same error
+		if (escapeTimeSettings != lastEscapeTimeSettings) {
+			escapeTimeFailed = false;
+		}
 
-		for (auto& [name, control] : variableControls) {
-			fractalShader.setVec2(name.c_str(), control.value);
+		// the other renderers upload into the same texture
+		if (rendererMode != RENDERER_ITERATION_DATA) {
+			iterationDataWidth = 0;
+		}
+
+		bool cpuFrame = false;
+		bool iterationsChanged = false;
+		if (rendererMode == RENDERER_CPU_PERTURBATION && isPerturbationSupported(activeEquationTraits)) {
+			// only rerender when something that changes the iterations has changed
+			if (settings != lastPerturbationSettings) {
+				renderPerturbation(settings, cpuIterations, frameStatistics);
+				lastPerturbationSettings = settings;
+
+				glBindTexture(GL_TEXTURE_2D, iterationTexture);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, settings.width, settings.height, 0, GL_RED, GL_FLOAT, cpuIterations.data());
+				iterationsChanged = true;
+			}
+			lastEscapeTimeSettings = EscapeTimeSettings();
+			cpuFrame = true;
+		}
+		else if (rendererMode == RENDERER_CPU_ESCAPE_TIME && !escapeTimeFailed) {
+			if (escapeTimeSettings != lastEscapeTimeSettings) {
+				try {
+					// solid guessing shows the guess first and iterates the guessed pixels on the next frame
+					EscapeTimeSettings previewSettings = escapeTimeSettings;
+					previewSettings.exactFinalPass = false;
+					renderEscapeTime(previewSettings, cpuFramebuffer, frameStatistics, &guessedPixels);
+					refinementPending = escapeTimeSettings.exactFinalPass && frameStatistics.guessedPixels > 0;
+
+					cpuFramebuffer.readSmoothIterations(cpuIterations);
+					glBindTexture(GL_TEXTURE_2D, iterationTexture);
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, escapeTimeSettings.width, escapeTimeSettings.height, 0, GL_RED, GL_FLOAT, cpuIterations.data());
+					iterationsChanged = true;
+				}
+				catch (const std::exception&) {
+					escapeTimeFailed = true;
+				}
+				lastEscapeTimeSettings = escapeTimeSettings;
+			}
+			else if (refinementPending) {
+				refineGuessedPixels(escapeTimeSettings, guessedPixels, cpuFramebuffer, frameStatistics);
+				refinementPending = false;
+
+				cpuFramebuffer.readSmoothIterations(cpuIterations);
+				glBindTexture(GL_TEXTURE_2D, iterationTexture);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, escapeTimeSettings.width, escapeTimeSettings.height, 0, GL_RED, GL_FLOAT, cpuIterations.data());
+				iterationsChanged = true;
+			}
+			lastPerturbationSettings = PerturbationSettings();
+			cpuFrame = !escapeTimeFailed;
+		}
+		else if (rendererMode == RENDERER_ITERATION_DATA && iterationData.isOpen()) {
+			// nearest sample of the stored image stretched over the view, colorShader colors it like a CPU render
+			if (iterationDataWidth != OPENGL_WIDTH || iterationDataHeight != HEIGHT) {
+				iterationDataWidth = OPENGL_WIDTH;
+				iterationDataHeight = HEIGHT;
+				cpuIterations.assign(static_cast<size_t>(OPENGL_WIDTH) * HEIGHT, 0.0f);
+				parallelFor(HEIGHT, 0, [&](int rowBegin, int rowEnd) {
+					for (int y = rowBegin; y < rowEnd; ++y) {
+						int row = iterationData.getHeight() - 1 - static_cast<int>((y + 0.5) * iterationData.getHeight() / HEIGHT);
+						for (int x = 0; x < OPENGL_WIDTH; ++x) {
+							int column = static_cast<int>((x + 0.5) * iterationData.getWidth() / OPENGL_WIDTH);
+							cpuIterations[static_cast<size_t>(y) * OPENGL_WIDTH + x] = iterationData.smoothAt(column, row);
+						}
+					}
+				});
+
+				glBindTexture(GL_TEXTURE_2D, iterationTexture);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, OPENGL_WIDTH, HEIGHT, 0, GL_RED, GL_FLOAT, cpuIterations.data());
+				iterationsChanged = true;
+			}
+			lastPerturbationSettings = PerturbationSettings();
+			lastEscapeTimeSettings = EscapeTimeSettings();
+			cpuFrame = true;
+		}
+
+		if (!cpuFrame) {
+			lastPerturbationSettings = PerturbationSettings();
+			if (!escapeTimeFailed) {
+				lastEscapeTimeSettings = EscapeTimeSettings();
+			}
+
+			// a variant with the settled uniforms baked in once it has compiled, the generic program until then
+			ShaderSpecialization specialization = specializeShader ? frozenUniforms() : ShaderSpecialization();
+			unsigned int variant = specialization.empty() ? 0 : shaderVariants->request(fractalShader, specialization);
+
+			// past float precision the shader switches to perturbation, deltas go extended exponent when floats underflow
+			ShaderDeltaMode deltaMode = isPerturbationSupported(activeEquationTraits) ? selectShaderDeltaMode(settings) : SHADER_DELTA_NONE;
+
+			IterationPassKey iterationPass;
+			iterationPass.escapeTime = escapeTimeSettings;
+			iterationPass.escapeTime.fillMode = FillMode::Automatic;
+			iterationPass.escapeTime.exactFinalPass = false;
+			iterationPass.perturbation = settings;
+			iterationPass.deltaMode = deltaMode;
+			iterationPass.unrollFactor = unrollFactor;
+			iterationPass.supersampleGrid = supersampleGrid;
+			iterationPass.supersampleThreshold = supersampleThreshold;
+
+			if (iterationPass != lastIterationPass) {
+				if (gpuIterationWidth != OPENGL_WIDTH || gpuIterationHeight != HEIGHT) {
+					gpuIterationWidth = OPENGL_WIDTH;
+					gpuIterationHeight = HEIGHT;
+					glBindTexture(GL_TEXTURE_2D, gpuIterationTexture);
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, OPENGL_WIDTH, HEIGHT, 0, GL_RG, GL_FLOAT, nullptr);
+					glBindFramebuffer(GL_FRAMEBUFFER, iterationFramebuffer);
+					glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gpuIterationTexture, 0);
+				}
+
+				if (variant != 0) {
+					fractalShader.useVariant(variant);
+				}
+				else {
+					fractalShader.useShader();
+				}
+				setFractalUniforms(fractalShader);
+				fractalShader.setInt("deltaMode", deltaMode);
+
+				if (deltaMode != SHADER_DELTA_NONE) {
+					if (settings != lastReferenceSettings) {
+						shaderReference.compute(settings, FloatExp(), FloatExp());
+						uploadReferenceOrbit(referenceTexture, shaderReference);
+						lastReferenceSettings = settings;
+					}
+
+					FloatExp scaleX = settings.zoom.timesPowerOfTwo(1) * FloatExp(1.0 / settings.width);
+					FloatExp scaleY = settings.zoom.timesPowerOfTwo(1) * FloatExp(1.0 / settings.height);
+					fractalShader.setVec2("deltaScale", glm::vec2(scaleX.mantissa, static_cast<double>(scaleY.timesPowerOfTwo(-scaleX.exponent))));
+					fractalShader.setInt("deltaScaleExponent", scaleX.exponent);
+					fractalShader.setInt("referenceLength", static_cast<int>(shaderReference.real.size()));
+					fractalShader.setInt("referenceOrbit", 1);
+
+					glActiveTexture(GL_TEXTURE1);
+					glBindTexture(GL_TEXTURE_2D, referenceTexture);
+					glActiveTexture(GL_TEXTURE0);
+				}
+
+				glBindFramebuffer(GL_FRAMEBUFFER, iterationFramebuffer);
+				glViewport(0, 0, OPENGL_WIDTH, HEIGHT);
+				glBindVertexArray(VAO);
+				glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				if (supersampleGrid > 1) {
+					supersamplePass->run(fractalShader, gpuIterationTexture, OPENGL_WIDTH, HEIGHT, supersampleGrid, supersampleThreshold, iterations, VAO);
+				}
+				lastIterationPass = iterationPass;
+				iterationsChanged = true;
+			}
 		}
 
+		// both passes color one texture of smooth iterations, the CPU ones upload theirs
+		unsigned int coloredTexture = cpuFrame ? iterationTexture : gpuIterationTexture;
+		if (iterationsChanged || coloredTexture != histogramSource || iterations != histogramIterations) {
+			histogramStale = true;
+		}
+		if (equalizeColors && histogramStale) {
+			histogramPass->run(coloredTexture, OPENGL_WIDTH, HEIGHT, iterations, VAO);
+			histogramSource = coloredTexture;
+			histogramIterations = iterations;
+			histogramStale = false;
+		}
+		histogramMilliseconds = histogramPass->getMilliseconds();
+
+		colorShader.useShader();
+		setColorUniforms(colorShader, *histogramPass);
+		colorShader.setInt("iterationTexture", 0);
+
+		// the shader's sub-samples of edge pixels on unit 4 and where each pixel's are on unit 5, CPU frames have none
+		bool supersampled = !cpuFrame && supersampleGrid > 1;
+		colorShader.setInt("subsampleGrid", supersampled ? supersampleGrid : 0);
+		colorShader.setInt("subsampleTexture", 4);
+		colorShader.setInt("subsampleEntries", 5);
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_2D, supersampled ? supersamplePass->getSubsampleTexture() : 0);
+		glActiveTexture(GL_TEXTURE5);
+		glBindTexture(GL_TEXTURE_2D, supersampled ? supersamplePass->getIndexTexture() : 0);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, coloredTexture);
+
+		Palette palette = currentPalette();
+		if (palette != lastPalette) {
+			std::vector<uint32_t> lut = bakePalette(palette);
+			glBindTexture(GL_TEXTURE_1D, paletteTexture);
+			glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, static_cast<int>(lut.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, lut.data());
+			lastPalette = palette;
+		}
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_1D, paletteTexture);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, histogramPass->getCumulativeTexture());
+		glActiveTexture(GL_TEXTURE0);
+
 		glBindVertexArray(VAO);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
+		// the coloring pass marks interior pixels that stopped on a cycle with alpha 0
+		if (collectStatistics && rendererMode == RENDERER_GPU_SHADER) {
+			statisticsReadback.resize(OPENGL_WIDTH * HEIGHT);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, OPENGL_WIDTH, HEIGHT, GL_ALPHA, GL_UNSIGNED_BYTE, statisticsReadback.data());
+			frameStatistics = FrameStatistics();
+			frameStatistics.periodicPixels = static_cast<int>(std::count(statisticsReadback.begin(), statisticsReadback.end(), 0));
+			frameStatistics.supersampledPixels = supersampleGrid > 1 ? supersamplePass->getSupersampledPixels() : 0;
+		}
+
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 
-		glReadPixels(0, 0, OPENGL_WIDTH, HEIGHT, GL_DEPTH_COMPONENT, GL_FLOAT, pixelData.data());
-
 		exitWindow(window);
 	}
 
 	removeFrame();
-
+	shaderVariants.reset();
+	histogramPass.reset();
+	supersamplePass.reset();
+
+	glDeleteTextures(1, &iterationTexture);
+	glDeleteTextures(1, &gpuIterationTexture);
+	glDeleteTextures(1, &paletteTexture);
+	glDeleteFramebuffers(1, &iterationFramebuffer);
+	glDeleteTextures(1, &referenceTexture);
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
 	glDeleteBuffers(1, &EBO);
@@ -0,0 +1,211 @@
+#include "palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "parallelFor.h"
+
+namespace {
+
+float mix(float a, float b, float factor) {
+    return a + (b - a) * factor;
+}
+
+// framebuffer conversion of a normalized float
+uint8_t toByte(float value) {
+    return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+struct Stop {
+    float position;
+    Color color;
+};
+
+// positions that don't match the colors one to one are replaced by an even spread
+std::vector<Stop> sortStops(const Palette& palette) {
+    size_t count = palette.colors.size();
+    std::vector<Stop> stops(count);
+    for (size_t i = 0; i < count; ++i) {
+        float even = count > 1 ? static_cast<float>(i) / static_cast<float>(count - 1) : 0.0f;
+        stops[i] = { palette.positions.size() == count ? palette.positions[i] : even, palette.colors[i] };
+    }
+    std::stable_sort(stops.begin(), stops.end(), [](const Stop& a, const Stop& b) { return a.position < b.position; });
+    return stops;
+}
+
+// bins per iteration
+float binScale(int iterations, int binCount) {
+    return static_cast<float>(binCount) / static_cast<float>(iterations);
+}
+
+} // namespace
+
+PaletteInterpolation parsePaletteInterpolation(const std::string& name) {
+    if (name == "linear") return PaletteInterpolation::Linear;
+    if (name == "smooth") return PaletteInterpolation::Smooth;
+    if (name == "step") return PaletteInterpolation::Step;
+    throw std::runtime_error("Unknown interpolation: " + name);
+}
+
+Color getGradientColor(float t, const Palette& palette) {
+    std::vector<Stop> stops = sortStops(palette);
+    if (stops.empty()) return Color();
+    if (stops.size() == 1) return stops[0].color;
+
+    // the segment around t, a repeated gradient wraps from the last stop to the first
+    const Stop* from = nullptr;
+    const Stop* to = nullptr;
+    float start = 0.0f;
+    float end = 0.0f;
+    if (t < stops.front().position || t >= stops.back().position) {
+        bool before = t < stops.front().position;
+        if (palette.repeats <= 0) return before ? stops.front().color : stops.back().color;
+        from = &stops.back();
+        to = &stops.front();
+        start = stops.back().position - (before ? 1.0f : 0.0f);
+        end = stops.front().position + (before ? 0.0f : 1.0f);
+    }
+    else {
+        size_t i = 0;
+        while (t >= stops[i + 1].position) ++i;
+        from = &stops[i];
+        to = &stops[i + 1];
+        start = from->position;
+        end = to->position;
+    }
+
+    float factor = end > start ? std::clamp((t - start) / (end - start), 0.0f, 1.0f) : 1.0f;
+    if (palette.interpolation == PaletteInterpolation::Smooth) factor = factor * factor * (3.0f - 2.0f * factor);
+    else if (palette.interpolation == PaletteInterpolation::Step) factor = 0.0f;
+
+    return { mix(from->color.r, to->color.r, factor), mix(from->color.g, to->color.g, factor), mix(from->color.b, to->color.b, factor), mix(from->color.a, to->color.a, factor) };
+}
+
+uint32_t packColor(const Color& color) {
+    return toByte(color.r) | (toByte(color.g) << 8) | (toByte(color.b) << 16) | (static_cast<uint32_t>(toByte(color.a)) << 24);
+}
+
+std::vector<uint32_t> bakePalette(const Palette& palette) {
+    int size = std::max(palette.lutSize, 1);
+    std::vector<uint32_t> lut(size);
+    for (int i = 0; i < size; ++i) {
+        lut[i] = packColor(getGradientColor((static_cast<float>(i) + 0.5f) / static_cast<float>(size), palette));
+    }
+    return lut;
+}
+
+int histogramBinCount(int iterations) {
+    return std::clamp(iterations, 1, MAX_HISTOGRAM_BINS);
+}
+
+IterationHistogram::IterationHistogram(int iterations)
+    : iterations(std::max(iterations, 1)), counts(histogramBinCount(iterations), 0), scale(binScale(this->iterations, static_cast<int>(counts.size()))) {
+}
+
+void IterationHistogram::add(float smoothIterations) {
+    if (!(smoothIterations < static_cast<float>(iterations))) return;
+    int bin = static_cast<int>(std::max(smoothIterations, 0.0f) * scale);
+    ++counts[std::min(bin, static_cast<int>(counts.size()) - 1)];
+}
+
+IterationHistogram& IterationHistogram::operator+=(const IterationHistogram& other) {
+    for (size_t bin = 0; bin < counts.size(); ++bin) counts[bin] += other.counts[bin];
+    return *this;
+}
+
+std::vector<float> IterationHistogram::cumulative() const {
+    std::vector<float> totals(counts.size(), 0.0f);
+    uint64_t total = 0;
+    for (uint64_t count : counts) total += count;
+    if (total == 0) return totals;
+
+    uint64_t running = 0;
+    for (size_t bin = 0; bin < counts.size(); ++bin) {
+        running += counts[bin];
+        totals[bin] = static_cast<float>(static_cast<double>(running) / static_cast<double>(total));
+    }
+    return totals;
+}
+
+IterationHistogram countIterations(const TiledFramebuffer& image, int iterations, int threadCount) {
+    return countInParallel(image.getTileCount(), iterations, threadCount, [&](int slot, IterationHistogram& histogram) {
+        const TiledFramebuffer::Tile& tile = image.getTile(slot);
+        for (int y = tile.y0; y < tile.y0 + tile.height; ++y) {
+            size_t index = image.index(tile.x0, y);
+            for (int x = 0; x < tile.width; ++x, ++index) {
+                histogram.add(image.smoothIterations[index]);
+            }
+        }
+    });
+}
+
+float equalizedPosition(float smoothIterations, int iterations, const std::vector<float>& cumulative) {
+    int binCount = static_cast<int>(cumulative.size());
+    float position = std::max(smoothIterations, 0.0f) * binScale(iterations, binCount);
+    int bin = std::min(static_cast<int>(position), binCount - 1);
+    float before = bin > 0 ? cumulative[bin - 1] : 0.0f;
+    return mix(before, cumulative[bin], std::clamp(position - static_cast<float>(bin), 0.0f, 1.0f));
+}
+
+float rootBasin(float smoothIterations, int iterations, double finalReal, double finalImag, float escapeRadius) {
+    double magnitudeSq = finalReal * finalReal + finalImag * finalImag;
+    if (!(smoothIterations < static_cast<float>(iterations)) || !std::isfinite(magnitudeSq) || magnitudeSq > escapeRadius) {
+        return -1.0f;
+    }
+    return static_cast<float>(std::atan2(finalImag, finalReal) / (2.0 * 3.14159265358979) + 0.5);
+}
+
+int paletteIndex(float smoothIterations, int iterations, const Palette& palette, const std::vector<float>* cumulative, float basin) {
+    if (smoothIterations >= static_cast<float>(iterations)) {
+        return -1;
+    }
+
+    float t = 0.0f;
+    if (palette.equalize) {
+        t = equalizedPosition(smoothIterations, iterations, *cumulative);
+    }
+    else {
+        t = std::max(smoothIterations / static_cast<float>(iterations), 0.0f);
+        t = std::pow(t, palette.contrast);
+        t = std::clamp(t, 0.0f, 1.0f);
+        t = t * t * (3.0f - 2.0f * t);
+    }
+    if (palette.repeats > 0) {
+        t *= static_cast<float>(palette.repeats);
+        t -= std::floor(t);
+    }
+    if (basin >= 0.0f) {
+        t += basin;
+        t -= std::floor(t);
+    }
+
+    int size = std::max(palette.lutSize, 1);
+    return std::min(static_cast<int>(t * static_cast<float>(size)), size - 1);
+}
+
+uint32_t shadeSmoothIterations(float smoothIterations, int iterations, const Palette& palette, const std::vector<uint32_t>& lut,
+    const std::vector<float>* cumulative, float basin) {
+    int index = paletteIndex(smoothIterations, iterations, palette, cumulative, basin);
+    return index < 0 ? packColor({ 0.0f, 0.0f, 0.0f, 1.0f }) : lut[index];
+}
+
+void colorize(TiledFramebuffer& image, int iterations, const Palette& palette, int threadCount, float basinRadius) {
+    std::vector<uint32_t> lut = bakePalette(palette);
+    std::vector<float> cumulative;
+    if (palette.equalize) cumulative = countIterations(image, iterations, threadCount).cumulative();
+
+    parallelFor(image.getTileCount(), threadCount, [&](int begin, int end) {
+        for (int slot = begin; slot < end; ++slot) {
+            const TiledFramebuffer::Tile& tile = image.getTile(slot);
+            for (int y = tile.y0; y < tile.y0 + tile.height; ++y) {
+                size_t index = image.index(tile.x0, y);
+                for (int x = 0; x < tile.width; ++x, ++index) {
+                    float smooth = image.smoothIterations[index];
+                    float basin = basinRadius > 0.0f ? rootBasin(smooth, iterations, image.finalReal[index], image.finalImag[index], basinRadius) : -1.0f;
+                    image.colors[index] = shadeSmoothIterations(smooth, iterations, palette, lut, &cumulative, basin);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,122 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "parallelFor.h"
+#include "tiledFramebuffer.h"
+
+// Coloring of smooth iteration counts, shared by the CPU renderers and colorFrag.frag:
+// t = smooth / iterations, raised to contrast and smoothstepped, then looked up in the palette
+// baked into a table of lutSize colors. Pixels that reached the iteration limit are black.
+// An equalizing palette takes t from the image's iteration histogram instead: the share of the
+// escaped pixels with fewer iterations, so the gradient is spread evenly over whatever the view holds.
+
+struct Color {
+    float r = 0.0f;
+    float g = 0.0f;
+    float b = 0.0f;
+    float a = 1.0f;
+
+    bool operator==(const Color&) const = default;
+};
+
+enum class PaletteInterpolation {
+    Linear,
+    Smooth, // eased in and out at every stop
+    Step // each color holds until the next stop
+};
+
+struct Palette {
+    // the GUI's defaults
+    std::vector<Color> colors = {
+        { 0.0f, 0.01f, 0.28f, 1.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f },
+        { 0.29f, 0.32f, 0.69f, 1.0f },
+        { 1.0f, 1.0f, 1.0f, 1.0f }
+    };
+    std::vector<float> positions = { 0.0f, 0.3f, 0.7f, 1.0f }; // where each color sits, spread evenly when the counts differ
+    float contrast = 0.5f;
+
+    PaletteInterpolation interpolation = PaletteInterpolation::Linear;
+    int repeats = 0; // 0 runs the gradient once, otherwise it wraps from the last color to the first and runs this many times
+    int lutSize = 1024;
+    bool equalize = false; // histogram equalization in place of contrast
+
+    bool operator==(const Palette&) const = default;
+};
+
+PaletteInterpolation parsePaletteInterpolation(const std::string& name); // linear, smooth or step
+
+// the gradient at t in [0, 1], before it is baked
+Color getGradientColor(float t, const Palette& palette);
+
+// RGBA8 with red in the lowest byte, like TiledFramebuffer::colors
+uint32_t packColor(const Color& color);
+
+// lutSize packed colors, entry i covers t from i / lutSize, uploaded as is to colorFrag.frag
+std::vector<uint32_t> bakePalette(const Palette& palette);
+
+// one bin per iteration up to MAX_HISTOGRAM_BINS, wider bins past that, also used by histogramVert.vert
+constexpr int MAX_HISTOGRAM_BINS = 4096;
+int histogramBinCount(int iterations);
+
+// Escaped pixels counted by smooth iterations, pixels inside the set are left out
+struct IterationHistogram {
+    int iterations = 1;
+    std::vector<uint64_t> counts;
+    float scale = 1.0f; // bins per iteration
+
+    explicit IterationHistogram(int iterations = 1);
+
+    void add(float smoothIterations);
+    IterationHistogram& operator+=(const IterationHistogram& other);
+
+    // running totals over the bins divided by the total, what equalization reads
+    std::vector<float> cumulative() const;
+};
+
+// Splits [0, count) into one range per thread and calls countItem(index, histogram) for every
+// index, each range counting into its own histogram, then adds them up
+template <typename CountItem>
+IterationHistogram countInParallel(int count, int iterations, int threadCount, CountItem countItem) {
+    int parts = std::max(1, std::min(resolveThreadCount(threadCount), count));
+    std::vector<IterationHistogram> partial(parts, IterationHistogram(iterations));
+    parallelFor(parts, threadCount, [&](int begin, int end) {
+        for (int part = begin; part < end; ++part) {
+            int first = static_cast<int>(static_cast<int64_t>(count) * part / parts);
+            int last = static_cast<int>(static_cast<int64_t>(count) * (part + 1) / parts);
+            for (int index = first; index < last; ++index) countItem(index, partial[part]);
+        }
+    });
+    for (int part = 1; part < parts; ++part) partial[0] += partial[part];
+    return partial[0];
+}
+
+// every pixel of the smooth iteration plane
+IterationHistogram countIterations(const TiledFramebuffer& image, int iterations, int threadCount = 0);
+
+// t of an equalizing palette, between the running totals before and after the pixel's bin
+float equalizedPosition(float smoothIterations, int iterations, const std::vector<float>& cumulative);
+
+// The root an orbit of a converging equation (z - f(z)) settled on, as fractalFrag.frag's
+// rootBasin: the angle of final z from 0 to 1. -1 for pixels that didn't settle, those inside the
+// set and those that escaped past escapeRadius or stopped on something that isn't finite.
+float rootBasin(float smoothIterations, int iterations, double finalReal, double finalImag, float escapeRadius);
+
+// Where smooth falls in the table, -1 for pixels inside the set. cumulative is required when
+// the palette equalizes and ignored otherwise. A basin from rootBasin moves each root's pixels
+// to their own stretch of the gradient, like colorFrag.frag.
+int paletteIndex(float smoothIterations, int iterations, const Palette& palette, const std::vector<float>* cumulative = nullptr, float basin = -1.0f);
+
+uint32_t shadeSmoothIterations(float smoothIterations, int iterations, const Palette& palette, const std::vector<uint32_t>& lut,
+    const std::vector<float>* cumulative = nullptr, float basin = -1.0f);
+
+// Fills the color plane from the smooth iteration plane, tile by tile, counting it first to
+// equalize. Converging equations pass their escape radius as basinRadius, and each pixel's
+// basin is taken from final z; 0 leaves basins out.
+void colorize(TiledFramebuffer& image, int iterations, const Palette& palette, int threadCount = 0, float basinRadius = 0.0f);
+
+#endif // PALETTE_H
@@ -0,0 +1,26 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <algorithm>
+#include <thread>
+
+#include "workStealing.h"
+
+// CPU work split across the shared work-stealing pool, used by every CPU renderer
+
+inline int resolveThreadCount(int requested) {
+    if (requested > 0) return requested;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls function(begin, end) over [0, count) with up to threadCount threads. With more than one
+// thread every call gets a single index, so per call setup should be per tile or per row.
+template <typename Function>
+void parallelFor(int count, int threadCount, Function function) {
+    threadCount = std::min(resolveThreadCount(threadCount), std::max(count, 1));
+    WorkStealingPool::instance().run(count, threadCount, [](void* context, int begin, int end) {
+        (*static_cast<Function*>(context))(begin, end);
+    }, &function);
+}
+
+#endif // PARALLEL_FOR_H
@@ -0,0 +1,427 @@
+#include "perturbation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <type_traits>
+
+#include "escapeTime.h"
+#include "parallelFor.h"
+
+namespace {
+
+struct PixelResult {
+    float smoothIterations;
+    bool glitched;
+    double glitchMetric; // |z|^2 / |Z|^2 when the glitch was detected, smallest is the blob center
+    bool periodic = false;
+    double finalReal = 0.0; // z where the loop stopped, like EscapeTimeKernel::evaluate
+    double finalImag = 0.0;
+};
+
+int imageWidth(const PerturbationSettings& settings) {
+    return settings.imageWidth > 0 ? settings.imageWidth : settings.width;
+}
+
+int imageHeight(const PerturbationSettings& settings) {
+    return settings.imageHeight > 0 ? settings.imageHeight : settings.height;
+}
+
+FloatExp pixelOffsetReal(const PerturbationSettings& settings, int x) {
+    return FloatExp((x + settings.originX + 0.5) / imageWidth(settings) - 0.5) * settings.zoom.timesPowerOfTwo(1);
+}
+
+FloatExp pixelOffsetImag(const PerturbationSettings& settings, int y) {
+    return FloatExp((y + settings.originY + 0.5) / imageHeight(settings) - 0.5) * settings.zoom.timesPowerOfTwo(1);
+}
+
+// log2 of the distance between two pixels
+double pixelSpacingLog2(const PerturbationSettings& settings) {
+    return settings.zoom.log2Magnitude() + 1.0 - std::log2(std::max({ imageWidth(settings), imageHeight(settings), 1 }));
+}
+
+double log2Of(double value) {
+    return std::log2(value);
+}
+
+double log2Of(const FloatExp& value) {
+    return value.log2Magnitude();
+}
+
+// getDistanceIterations in escapeTime.h with |dz|^2 and the pixel as log2, past the range of a double
+double getDistanceIterationsLog2(double magnitudeSq, double derivativeSqLog2, double pixelLog2, double range, int iterations) {
+    double distanceLog2 = std::log2(0.25 * std::sqrt(magnitudeSq) * std::log(magnitudeSq)) - 0.5 * derivativeSqLog2;
+    return std::clamp(std::exp2(distanceLog2 - pixelLog2) / range, 0.0, 0.999) * iterations;
+}
+
+// Same loop and smoothing as getSmoothIterations in fractalFrag.frag, with z = Z_m + dz.
+// Real is the delta type, the reference and |z| itself always fit in a double.
+template <typename Real>
+PixelResult iteratePixel(const PerturbationSettings& settings, const ReferenceOrbit& reference, Real deltaCReal, Real deltaCImag) {
+    const double toleranceSq = settings.glitchTolerance * settings.glitchTolerance;
+    const int referenceLength = static_cast<int>(reference.real.size());
+
+    // dz/dc grows about as fast as the pixels shrink, so it needs the extended exponent with the deltas
+    using Derivative = std::conditional_t<std::is_same_v<Real, FloatExp>, FloatExp, double>;
+    Derivative derivativeReal = Derivative(0.0);
+    Derivative derivativeImag = Derivative(0.0);
+    double escapedDistance = -1.0;
+    const double farDistance = 0.999 * settings.iterations;
+
+    Real deltaReal = Real(0.0);
+    Real deltaImag = Real(0.0);
+    int m = 0;
+
+    // Brent's cycle detection on the full orbit, see periodicityInterval in fractalFrag.frag.
+    // A tolerance of a whole pixel stops exterior pixels near the boundary, 1/1024 of one doesn't
+    const double periodicityToleranceSq = std::exp2(2.0 * (pixelSpacingLog2(settings) - 10.0));
+    double savedReal = 0.0;
+    double savedImag = 0.0;
+    int checkLength = settings.periodicityInterval;
+    int checkCounter = 0;
+
+    for (int n = 0; n < settings.iterations; ++n) {
+        double referenceReal = reference.real[m];
+        double referenceImag = reference.imag[m];
+        double real = referenceReal + static_cast<double>(deltaReal);
+        double imag = referenceImag + static_cast<double>(deltaImag);
+        double magnitudeSq = real * real + imag * imag;
+
+        if (magnitudeSq > settings.escapeRadius) {
+            if (!settings.distanceEstimation) {
+                return { static_cast<float>(getEscapeIterations(n, magnitudeSq)), false, 0.0, false, real, imag };
+            }
+
+            // like EscapeTimeKernel, only pixels near the boundary iterate on to the larger bailout
+            double derivativeSqLog2 = log2Of(derivativeReal * derivativeReal + derivativeImag * derivativeImag);
+            escapedDistance = getDistanceIterationsLog2(magnitudeSq, derivativeSqLog2, pixelSpacingLog2(settings), settings.distanceRange, settings.iterations);
+            if (escapedDistance >= farDistance || magnitudeSq > DISTANCE_BAILOUT) {
+                return { static_cast<float>(escapedDistance), false, 0.0, false, real, imag };
+            }
+        }
+
+        // Pauldelbrot's criterion: the full orbit got much closer to zero than the reference,
+        // so the delta no longer carries enough significant bits
+        double referenceSq = referenceReal * referenceReal + referenceImag * referenceImag;
+        if (magnitudeSq < toleranceSq * referenceSq) {
+            return { static_cast<float>(settings.iterations), true, magnitudeSq / referenceSq, false, real, imag };
+        }
+
+        if (settings.periodicityInterval > 0 && n > 0) {
+            double differenceReal = real - savedReal;
+            double differenceImag = imag - savedImag;
+            if (differenceReal * differenceReal + differenceImag * differenceImag < periodicityToleranceSq) {
+                return { static_cast<float>(settings.iterations), false, 0.0, true, real, imag };
+            }
+            if (++checkCounter == checkLength) {
+                savedReal = real;
+                savedImag = imag;
+                checkCounter = 0;
+                checkLength *= 2;
+            }
+        }
+
+        // dz/dc' = 2z * dz/dc + 1
+        if (settings.distanceEstimation) {
+            Derivative nextReal = Derivative(2.0 * real) * derivativeReal - Derivative(2.0 * imag) * derivativeImag + Derivative(1.0);
+            Derivative nextImag = Derivative(2.0 * real) * derivativeImag + Derivative(2.0 * imag) * derivativeReal;
+            derivativeReal = nextReal;
+            derivativeImag = nextImag;
+        }
+
+        // rebase to the start of the reference once it has no next value
+        if (m + 1 >= referenceLength) {
+            deltaReal = Real(referenceReal) + deltaReal;
+            deltaImag = Real(referenceImag) + deltaImag;
+            referenceReal = 0.0;
+            referenceImag = 0.0;
+            m = 0;
+        }
+
+        // dz' = (2Z + dz) * dz + dc
+        Real sumReal = Real(2.0 * referenceReal) + deltaReal;
+        Real sumImag = Real(2.0 * referenceImag) + deltaImag;
+        Real nextReal = sumReal * deltaReal - sumImag * deltaImag + deltaCReal;
+        Real nextImag = sumReal * deltaImag + sumImag * deltaReal + deltaCImag;
+        deltaReal = nextReal;
+        deltaImag = nextImag;
+        ++m;
+    }
+
+    // escaped but ran out of iterations before the distance bailout
+    double finalReal = reference.real[m] + static_cast<double>(deltaReal);
+    double finalImag = reference.imag[m] + static_cast<double>(deltaImag);
+    if (escapedDistance >= 0.0) return { static_cast<float>(escapedDistance), false, 0.0, false, finalReal, finalImag };
+    return { static_cast<float>(settings.iterations), false, 0.0, false, finalReal, finalImag };
+}
+
+PixelResult iteratePixel(const PerturbationSettings& settings, DeltaPrecision precision, const ReferenceOrbit& reference, const FloatExp& deltaCReal, const FloatExp& deltaCImag) {
+    switch (precision) {
+        case DeltaPrecision::Float:
+            return iteratePixel(settings, reference, static_cast<float>(deltaCReal), static_cast<float>(deltaCImag));
+        case DeltaPrecision::Double:
+            return iteratePixel(settings, reference, static_cast<double>(deltaCReal), static_cast<double>(deltaCImag));
+        default:
+            return iteratePixel(settings, reference, deltaCReal, deltaCImag);
+    }
+}
+
+struct GlitchRegion {
+    std::vector<int> pixels;
+    int center; // the pixel with the smallest metric
+};
+
+bool isSmallerRegion(const GlitchRegion& a, const GlitchRegion& b) {
+    return a.pixels.size() < b.pixels.size();
+}
+
+// Collects the 4-connected glitched region containing start
+GlitchRegion collectRegion(const PerturbationSettings& settings, std::vector<char>& visited, const std::vector<char>& glitched, const std::vector<double>& metric, int start) {
+    GlitchRegion region = { {}, start };
+    std::vector<int> stack = { start };
+    visited[start] = 1;
+
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        region.pixels.push_back(index);
+        if (metric[index] < metric[region.center]) region.center = index;
+
+        int x = index % settings.width;
+        int y = index / settings.width;
+        const int neighbors[4][2] = { { x - 1, y }, { x + 1, y }, { x, y - 1 }, { x, y + 1 } };
+        for (const auto& neighbor : neighbors) {
+            if (neighbor[0] < 0 || neighbor[0] >= settings.width || neighbor[1] < 0 || neighbor[1] >= settings.height) continue;
+            int next = neighbor[1] * settings.width + neighbor[0];
+            if (glitched[next] == 1 && !visited[next]) {
+                visited[next] = 1;
+                stack.push_back(next);
+            }
+        }
+    }
+
+    return region;
+}
+
+} // namespace
+
+void ReferenceOrbit::compute(const PerturbationSettings& settings, const FloatExp& offsetReal, const FloatExp& offsetImag) {
+    this->offsetReal = offsetReal;
+    this->offsetImag = offsetImag;
+
+    // c = 2 * center + offset, with enough limbs to tell pixels apart at this zoom
+    int limbs = std::max({ settings.centerX.fractionalLimbs(), settings.centerY.fractionalLimbs(),
+        static_cast<int>(std::ceil((32.0 - pixelSpacingLog2(settings)) / 32.0)) });
+
+    BigFixed constReal = settings.centerX;
+    BigFixed constImag = settings.centerY;
+    constReal.reservePrecision(limbs);
+    constImag.reservePrecision(limbs);
+    constReal.shiftLeft(1);
+    constImag.shiftLeft(1);
+    constReal.add(offsetReal);
+    constImag.add(offsetImag);
+
+    BigFixed zReal(limbs);
+    BigFixed zImag(limbs);
+    BigFixed realSq(limbs);
+    BigFixed imagSq(limbs);
+    BigFixed cross(limbs);
+
+    real.clear();
+    imag.clear();
+    real.reserve(settings.iterations + 1);
+    imag.reserve(settings.iterations + 1);
+
+    for (int n = 0; n <= settings.iterations; ++n) {
+        double valueReal = zReal.toDouble();
+        double valueImag = zImag.toDouble();
+        if (valueReal * valueReal + valueImag * valueImag > settings.escapeRadius) break;
+        real.push_back(valueReal);
+        imag.push_back(valueImag);
+
+        BigFixed::multiply(zReal, zReal, realSq);
+        BigFixed::multiply(zImag, zImag, imagSq);
+        BigFixed::multiply(zReal, zImag, cross);
+
+        zReal = realSq;
+        zReal.subtract(imagSq);
+        zReal.add(constReal);
+
+        zImag = cross;
+        zImag.shiftLeft(1);
+        zImag.add(constImag);
+    }
+
+    if (real.empty()) {
+        real.push_back(0.0);
+        imag.push_back(0.0);
+    }
+}
+
+DeltaPrecision selectDeltaPrecision(const PerturbationSettings& settings) {
+    // float only while the GPU shader could still resolve a pixel directly (1e-6),
+    // past that keep a margin above the normal range of each type (1e-290)
+    double pixelSpacing = pixelSpacingLog2(settings);
+    if (pixelSpacing > -19.9) return DeltaPrecision::Float;
+    if (pixelSpacing > -963.0) return DeltaPrecision::Double;
+    return DeltaPrecision::FloatExp;
+}
+
+const char* deltaPrecisionName(DeltaPrecision precision) {
+    switch (precision) {
+        case DeltaPrecision::Float: return "float";
+        case DeltaPrecision::Double: return "double";
+        default: return "extended exponent";
+    }
+}
+
+ShaderDeltaMode selectShaderDeltaMode(const PerturbationSettings& settings) {
+    switch (selectDeltaPrecision(settings)) {
+        case DeltaPrecision::Float:
+            return SHADER_DELTA_NONE;
+        case DeltaPrecision::Double:
+            return pixelSpacingLog2(settings) > -99.6 ? SHADER_DELTA_FLOAT : SHADER_DELTA_FLOAT_EXP; // 1e-30
+        default:
+            return SHADER_DELTA_FLOAT_EXP;
+    }
+}
+
+bool isPerturbationSupported(const EquationTraits& traits) {
+    return traits.isQuadraticMandelbrot;
+}
+
+void renderPerturbation(const PerturbationSettings& settings, std::vector<float>& smoothIterations, FrameStatistics& statistics, std::vector<float>* finalReal, std::vector<float>* finalImag) {
+    SampleOffset pixelOffset = [&settings](int x, int y, FloatExp& real, FloatExp& imag) {
+        real = pixelOffsetReal(settings, x);
+        imag = pixelOffsetImag(settings, y);
+    };
+    renderPerturbationSamples(settings, pixelOffset, smoothIterations, statistics, finalReal, finalImag);
+}
+
+void renderPerturbationSamples(const PerturbationSettings& settings, const SampleOffset& offset, std::vector<float>& smoothIterations, FrameStatistics& statistics,
+    std::vector<float>* finalReal, std::vector<float>* finalImag, const std::vector<char>* active) {
+    auto frameStart = std::chrono::steady_clock::now();
+
+    statistics = FrameStatistics();
+    int pixelCount = settings.width * settings.height;
+    smoothIterations.assign(pixelCount, 0.0f);
+    if (finalReal) finalReal->assign(pixelCount, 0.0f);
+    if (finalImag) finalImag->assign(pixelCount, 0.0f);
+    if (pixelCount <= 0) return;
+
+    std::vector<char> glitched(pixelCount, 0);
+    std::vector<double> metric(pixelCount, 0.0);
+    std::vector<char> periodic(pixelCount, 0);
+
+    auto storeResult = [&](int index, const PixelResult& result) {
+        smoothIterations[index] = result.smoothIterations;
+        if (finalReal) (*finalReal)[index] = static_cast<float>(result.finalReal);
+        if (finalImag) (*finalImag)[index] = static_cast<float>(result.finalImag);
+        glitched[index] = result.glitched;
+        metric[index] = result.glitchMetric;
+        periodic[index] = result.periodic;
+    };
+
+    DeltaPrecision precision = selectDeltaPrecision(settings);
+    statistics.deltaPrecision = deltaPrecisionName(precision);
+
+    ReferenceOrbit reference;
+    reference.compute(settings, FloatExp(), FloatExp());
+    statistics.referencesUsed = 1;
+
+    // the cardioid and bulb tests need c itself, which a double holds to well below a pixel this far out
+    bool testInterior = pixelSpacingLog2(settings) > -40.0;
+    double centerReal = settings.centerX.toDouble() * 2.0;
+    double centerImag = settings.centerY.toDouble() * 2.0;
+
+    parallelFor(settings.height, settings.threadCount, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            for (int x = 0; x < settings.width; ++x) {
+                if (active && !(*active)[y * settings.width + x]) continue;
+                FloatExp deltaReal, deltaImag;
+                offset(x, y, deltaReal, deltaImag);
+                if (testInterior && isInMainCardioidOrBulb(centerReal + static_cast<double>(deltaReal), centerImag + static_cast<double>(deltaImag))) {
+                    storeResult(y * settings.width + x, { static_cast<float>(settings.iterations), false, 0.0 });
+                    continue;
+                }
+                storeResult(y * settings.width + x, iteratePixel(settings, precision, reference, deltaReal, deltaImag));
+            }
+        }
+    });
+
+    auto correctionStart = std::chrono::steady_clock::now();
+
+    statistics.glitchedPixels = static_cast<int>(std::count(glitched.begin(), glitched.end(), 1));
+
+    // The regions are collected once, the largest is corrected first. Each round references the
+    // region's most glitched pixel and iterates only that region again, and whatever is still
+    // glitched in it goes back as smaller regions, which can't touch the others
+    std::vector<GlitchRegion> regions; // a heap on size
+    std::vector<char> visited(pixelCount, 0);
+    auto addRegion = [&](int start) {
+        if (glitched[start] != 1 || visited[start]) return;
+        regions.push_back(collectRegion(settings, visited, glitched, metric, start));
+        std::push_heap(regions.begin(), regions.end(), isSmallerRegion);
+    };
+    for (int index = 0; index < pixelCount; ++index) addRegion(index);
+
+    // pixels given up on take the rest of their orbit as it comes, which ends near where they really escape
+    PerturbationSettings unchecked = settings;
+    unchecked.glitchTolerance = 0.0;
+    auto settle = [&](const std::vector<int>& pixels, const ReferenceOrbit& orbit) {
+        parallelFor(static_cast<int>(pixels.size()), settings.threadCount, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                int index = pixels[i];
+                FloatExp deltaReal, deltaImag;
+                offset(index % settings.width, index / settings.width, deltaReal, deltaImag);
+                storeResult(index, iteratePixel(unchecked, precision, orbit, deltaReal - orbit.offsetReal, deltaImag - orbit.offsetImag));
+                glitched[index] = 2;
+            }
+        });
+    };
+
+    while (!regions.empty() && statistics.referencesUsed < settings.maxReferences) {
+        std::pop_heap(regions.begin(), regions.end(), isSmallerRegion);
+        GlitchRegion region = std::move(regions.back());
+        regions.pop_back();
+
+        FloatExp centerOffsetReal, centerOffsetImag;
+        offset(region.center % settings.width, region.center / settings.width, centerOffsetReal, centerOffsetImag);
+        ReferenceOrbit secondary;
+        secondary.compute(settings, centerOffsetReal, centerOffsetImag);
+        ++statistics.referencesUsed;
+
+        parallelFor(static_cast<int>(region.pixels.size()), settings.threadCount, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                int index = region.pixels[i];
+                FloatExp deltaReal, deltaImag;
+                offset(index % settings.width, index / settings.width, deltaReal, deltaImag);
+                deltaReal -= secondary.offsetReal;
+                deltaImag -= secondary.offsetImag;
+                storeResult(index, iteratePixel(settings, precision, secondary, deltaReal, deltaImag));
+            }
+        });
+
+        // a region that didn't shrink won't get better with another reference inside it
+        bool resolvedAny = false;
+        for (int index : region.pixels) resolvedAny |= !glitched[index];
+        if (!resolvedAny) {
+            settle(region.pixels, secondary);
+            continue;
+        }
+        for (int index : region.pixels) visited[index] = 0;
+        for (int index : region.pixels) addRegion(index);
+    }
+
+    // out of references
+    for (const GlitchRegion& region : regions) settle(region.pixels, reference);
+
+    int remaining = static_cast<int>(pixelCount - std::count(glitched.begin(), glitched.end(), 0));
+
+    auto frameEnd = std::chrono::steady_clock::now();
+    statistics.correctedPixels = statistics.glitchedPixels - remaining;
+    statistics.periodicPixels = static_cast<int>(std::count(periodic.begin(), periodic.end(), 1));
+    statistics.correctionMilliseconds = std::chrono::duration<double, std::milli>(frameEnd - correctionStart).count();
+    statistics.renderMilliseconds = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+}
@@ -0,0 +1,94 @@
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+#include <functional>
+#include <vector>
+#include <string>
+
+#include "frameStatistics.h"
+#include "floatExp.h"
+#include "bigFixed.h"
+#include "complexParser.h"
+
+// CPU perturbation renderer for the quadratic Mandelbrot set (z^2 + c).
+// Every pixel is iterated as a delta against a reference orbit computed at the
+// view center. Pixels that lose precision are detected with Pauldelbrot's
+// criterion and rendered again against secondary references picked inside the
+// glitched regions, largest first; the few no reference fixes finish their orbit
+// without the check. Deltas are kept in float, double or FloatExp depending on
+// how small a pixel is, so shallow views don't pay for the extended exponent.
+
+struct PerturbationSettings {
+    int width = 0;
+    int height = 0;
+
+    BigFixed centerX;
+    BigFixed centerY;
+    FloatExp zoom = 1.0;
+
+    // a window of a larger image like EscapeTimeSettings, the reference stays at the image center
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int originX = 0;
+    int originY = 0;
+
+    int iterations = 100;
+    float escapeRadius = 5.0f;
+
+    double glitchTolerance = 1e-3;
+    int maxReferences = 16;
+    int periodicityInterval = 0; // 0 turns cycle detection off
+    bool distanceEstimation = false; // like EscapeTimeSettings, dz/dc is carried next to the delta
+    float distanceRange = 8.0f;
+    int threadCount = 0; // 0 uses every hardware thread
+
+    bool operator==(const PerturbationSettings&) const = default;
+};
+
+enum class DeltaPrecision {
+    Float,
+    Double,
+    FloatExp
+};
+
+// deltaMode values understood by fractalFrag.frag, which has no doubles
+enum ShaderDeltaMode {
+    SHADER_DELTA_NONE = 0,
+    SHADER_DELTA_FLOAT = 1,
+    SHADER_DELTA_FLOAT_EXP = 2
+};
+
+class ReferenceOrbit {
+public:
+    // c is given relative to the view center, so secondary references only need an offset
+    void compute(const PerturbationSettings& settings, const FloatExp& offsetReal, const FloatExp& offsetImag);
+
+    FloatExp offsetReal;
+    FloatExp offsetImag;
+
+    // Z_n stops at the first escaped iteration, pixels rebase to Z_0 once they run past the end
+    std::vector<double> real;
+    std::vector<double> imag;
+};
+
+DeltaPrecision selectDeltaPrecision(const PerturbationSettings& settings);
+const char* deltaPrecisionName(DeltaPrecision precision);
+ShaderDeltaMode selectShaderDeltaMode(const PerturbationSettings& settings);
+
+bool isPerturbationSupported(const EquationTraits& traits);
+
+// finalReal and finalImag, when given, get z where each pixel stopped, rows like smoothIterations
+void renderPerturbation(const PerturbationSettings& settings, std::vector<float>& smoothIterations, FrameStatistics& statistics,
+    std::vector<float>* finalReal = nullptr, std::vector<float>* finalImag = nullptr);
+
+// offset(x, y, real, imag) gives c - 2 * center of sample (x, y)
+using SampleOffset = std::function<void(int x, int y, FloatExp& real, FloatExp& imag)>;
+
+// renderPerturbation over any settings.width x settings.height grid of samples, such as the
+// exponential map of a zoom video. The zoom only sets the precision: neighbouring samples should
+// be no closer than the pixels of a view of that size and zoom. When active is given, only the
+// samples that aren't 0 in it are iterated and the rest are left at 0.
+void renderPerturbationSamples(const PerturbationSettings& settings, const SampleOffset& offset, std::vector<float>& smoothIterations, FrameStatistics& statistics,
+    std::vector<float>* finalReal = nullptr, std::vector<float>* finalImag = nullptr, const std::vector<char>* active = nullptr);
+
+#endif // PERTURBATION_H
@@ -0,0 +1,265 @@
+#include "pngWriter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#include "deflate.h"
+#include "parallelFor.h"
+
+namespace {
+
+const size_t STRIP_BYTES = 256 * 1024;
+const int STRIPS_PER_THREAD = 2;
+
+enum Filter : uint8_t { NONE = 0, SUB = 1, UP = 2, AVERAGE = 3, PAETH = 4 };
+
+uint8_t paeth(int left, int up, int upLeft) {
+    int estimate = left + up - upLeft;
+    int toLeft = std::abs(estimate - left);
+    int toUp = std::abs(estimate - up);
+    int toUpLeft = std::abs(estimate - upLeft);
+    if (toLeft <= toUp && toLeft <= toUpLeft) return static_cast<uint8_t>(left);
+    if (toUp <= toUpLeft) return static_cast<uint8_t>(up);
+    return static_cast<uint8_t>(upLeft);
+}
+
+void applyFilter(Filter filter, const uint8_t* row, const uint8_t* above, size_t length, int bytesPerPixel, uint8_t* out) {
+    // the first pixel has nothing to its left, the rest of the row runs without the checks
+    size_t first = std::min(length, static_cast<size_t>(bytesPerPixel));
+    switch (filter) {
+        case NONE:
+            std::memcpy(out, row, length);
+            break;
+        case SUB:
+            std::memcpy(out, row, first);
+            for (size_t i = first; i < length; ++i) out[i] = static_cast<uint8_t>(row[i] - row[i - bytesPerPixel]);
+            break;
+        case UP:
+            for (size_t i = 0; i < length; ++i) out[i] = static_cast<uint8_t>(row[i] - above[i]);
+            break;
+        case AVERAGE:
+            for (size_t i = 0; i < first; ++i) out[i] = static_cast<uint8_t>(row[i] - (above[i] >> 1));
+            for (size_t i = first; i < length; ++i) out[i] = static_cast<uint8_t>(row[i] - ((row[i - bytesPerPixel] + above[i]) >> 1));
+            break;
+        case PAETH:
+            for (size_t i = 0; i < first; ++i) out[i] = static_cast<uint8_t>(row[i] - above[i]);
+            for (size_t i = first; i < length; ++i) out[i] = static_cast<uint8_t>(row[i] - paeth(row[i - bytesPerPixel], above[i], above[i - bytesPerPixel]));
+            break;
+    }
+}
+
+// the filter byte and the filtered row, picked by the smallest sum of signed bytes like libpng
+void filterRow(const uint8_t* row, const uint8_t* above, size_t length, int bytesPerPixel, std::vector<uint8_t>& scratch, uint8_t* out) {
+    if (std::memcmp(row, above, length) == 0) {
+        out[0] = UP;
+        std::memset(out + 1, 0, length);
+        return;
+    }
+
+    bool flat = true;
+    for (size_t i = bytesPerPixel; i < length && flat; ++i) flat = row[i] == row[i - bytesPerPixel];
+    if (flat) {
+        out[0] = SUB;
+        std::memcpy(out + 1, row, bytesPerPixel);
+        std::memset(out + 1 + bytesPerPixel, 0, length - bytesPerPixel);
+        return;
+    }
+
+    scratch.resize(length);
+    uint64_t bestSum = UINT64_MAX;
+    for (int filter = NONE; filter <= PAETH; ++filter) {
+        applyFilter(static_cast<Filter>(filter), row, above, length, bytesPerPixel, scratch.data());
+        uint64_t sum = 0;
+        for (size_t i = 0; i < length; ++i) sum += std::abs(static_cast<int8_t>(scratch[i]));
+        if (sum < bestSum) {
+            bestSum = sum;
+            out[0] = static_cast<uint8_t>(filter);
+            std::memcpy(out + 1, scratch.data(), length);
+        }
+    }
+}
+
+void putBigEndian(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+} // namespace
+
+PngWriter::PngWriter(const std::string& path, int width, int height, bool alpha, int threadCount)
+    : file(path, std::ios::binary), path(path), width(width), height(height), channels(alpha ? 4 : 3), threadCount(resolveThreadCount(threadCount)) {
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    if (width <= 0 || height <= 0) {
+        throw std::runtime_error("A PNG needs at least one pixel");
+    }
+
+    rowBytes = static_cast<size_t>(width) * channels;
+    stripRows = static_cast<int>(std::max<size_t>(1, STRIP_BYTES / (rowBytes + 1)));
+    previousRow.assign(rowBytes, 0);
+
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+
+    uint8_t header[13];
+    putBigEndian(header, width);
+    putBigEndian(header + 4, height);
+    header[8] = 8; // bits per channel
+    header[9] = alpha ? 6 : 2; // RGBA or RGB
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+    writeChunk("IHDR", header, sizeof(header));
+}
+
+void PngWriter::addRows(const uint8_t* rgba, int rows) {
+    rows = std::min(rows, height - rowsAdded);
+    size_t window = rowBytes * stripRows * STRIPS_PER_THREAD * threadCount;
+    for (int y = 0; y < rows; ++y) {
+        const uint8_t* source = rgba + static_cast<size_t>(y) * width * 4;
+        if (channels == 4) {
+            pending.insert(pending.end(), source, source + rowBytes);
+        }
+        else {
+            for (int x = 0; x < width; ++x) pending.insert(pending.end(), source + x * 4, source + x * 4 + 3);
+        }
+
+        if (pending.size() >= window) {
+            encodePending(false);
+        }
+    }
+    rowsAdded += rows;
+}
+
+void PngWriter::finish() {
+    if (rowsAdded != height) {
+        throw std::runtime_error(path + " got " + std::to_string(rowsAdded) + " of " + std::to_string(height) + " rows");
+    }
+    encodePending(true);
+
+    uint8_t checksum[4];
+    putBigEndian(checksum, adler);
+    writeChunk("IDAT", checksum, sizeof(checksum));
+    writeChunk("IEND", nullptr, 0);
+
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Can't write " + path);
+    }
+}
+
+void PngWriter::encodePending(bool last) {
+    int rows = static_cast<int>(pending.size() / rowBytes);
+    if (rows == 0 && !last) return;
+    int strips = std::max(1, (rows + stripRows - 1) / stripRows);
+
+    // filtering only needs the raw row above, so every strip filters on its own first
+    std::vector<std::vector<uint8_t>> filtered(strips);
+    parallelFor(strips, threadCount, [&](int begin, int end) {
+        std::vector<uint8_t> scratch;
+        for (int strip = begin; strip < end; ++strip) {
+            int first = strip * stripRows;
+            int count = std::min(stripRows, rows - first);
+            filtered[strip].resize(static_cast<size_t>(count) * (rowBytes + 1));
+            for (int y = first; y < first + count; ++y) {
+                const uint8_t* row = pending.data() + static_cast<size_t>(y) * rowBytes;
+                const uint8_t* above = y == 0 ? previousRow.data() : row - rowBytes;
+                filterRow(row, above, rowBytes, channels, scratch, filtered[strip].data() + static_cast<size_t>(y - first) * (rowBytes + 1));
+            }
+        }
+    });
+
+    // strips go out in order as soon as they and the ones before them are done
+    std::vector<std::vector<uint8_t>> compressed(strips);
+    std::vector<uint32_t> checksums(strips);
+    std::vector<char> done(strips, 0);
+    int nextToWrite = 0;
+    std::mutex writeMutex;
+
+    parallelFor(strips, threadCount, [&](int begin, int end) {
+        std::vector<uint8_t> input;
+        for (int strip = begin; strip < end; ++strip) {
+            // the dictionary is the tail of whatever was filtered before this strip
+            input.clear();
+            if (strip == 0) {
+                input = dictionary;
+            }
+            else {
+                for (int before = strip - 1; before >= 0 && input.size() < DEFLATE_WINDOW; --before) {
+                    size_t take = std::min(filtered[before].size(), DEFLATE_WINDOW - input.size());
+                    input.insert(input.begin(), filtered[before].end() - take, filtered[before].end());
+                }
+                if (input.size() < DEFLATE_WINDOW) {
+                    size_t take = std::min(dictionary.size(), DEFLATE_WINDOW - input.size());
+                    input.insert(input.begin(), dictionary.end() - take, dictionary.end());
+                }
+            }
+            size_t start = input.size();
+            input.insert(input.end(), filtered[strip].begin(), filtered[strip].end());
+
+            deflatePiece(input.data(), start, input.size(), last && strip == strips - 1, compressed[strip]);
+            checksums[strip] = adler32(1, filtered[strip].data(), filtered[strip].size());
+
+            std::lock_guard<std::mutex> lock(writeMutex);
+            done[strip] = 1;
+            while (nextToWrite < strips && done[nextToWrite]) {
+                std::vector<uint8_t>& data = compressed[nextToWrite];
+                if (!headerWritten) {
+                    // zlib header, deflate with a 32 KB window
+                    data.insert(data.begin(), { 0x78, 0x5e });
+                    headerWritten = true;
+                }
+                writeChunk("IDAT", data.data(), data.size());
+                adler = adler32Combine(adler, checksums[nextToWrite], filtered[nextToWrite].size());
+                std::vector<uint8_t>().swap(data);
+                ++nextToWrite;
+            }
+        }
+    });
+
+    // keep the filters' row above and the next dictionary, then drop the window
+    if (rows > 0) {
+        std::memcpy(previousRow.data(), pending.data() + static_cast<size_t>(rows - 1) * rowBytes, rowBytes);
+    }
+    for (int strip = 0; strip < strips; ++strip) {
+        dictionary.insert(dictionary.end(), filtered[strip].begin(), filtered[strip].end());
+        if (dictionary.size() > DEFLATE_WINDOW) {
+            dictionary.erase(dictionary.begin(), dictionary.end() - DEFLATE_WINDOW);
+        }
+    }
+    pending.clear();
+}
+
+void PngWriter::writeChunk(const char* type, const uint8_t* data, size_t length) {
+    uint8_t header[8];
+    putBigEndian(header, static_cast<uint32_t>(length));
+    std::memcpy(header + 4, type, 4);
+
+    uint32_t crc = crc32(0, header + 4, 4);
+    if (length > 0) crc = crc32(crc, data, length);
+    uint8_t footer[4];
+    putBigEndian(footer, crc);
+
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (length > 0) file.write(reinterpret_cast<const char*>(data), length);
+    file.write(reinterpret_cast<const char*>(footer), sizeof(footer));
+    if (!file) {
+        throw std::runtime_error("Can't write " + path);
+    }
+}
+
+void writePNG(const std::string& path, int width, int height, const std::vector<uint8_t>& rgba, int threadCount) {
+    // renders are opaque, the alpha channel is only kept when something uses it
+    bool alpha = false;
+    for (size_t i = 3; i < rgba.size() && !alpha; i += 4) alpha = rgba[i] != 255;
+
+    PngWriter writer(path, width, height, alpha, threadCount);
+    writer.addRows(rgba.data(), height);
+    writer.finish();
+}
@@ -0,0 +1,50 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// PNG output without zlib or libpng. Rows are gathered into horizontal strips of about 256 KB,
+// and each strip is filtered and deflated on its own thread with the 32 KB before it as the
+// dictionary (see deflate.h). Strips are written as IDAT chunks in order as soon as they and
+// every strip above them are done, and at most two strips per thread are held at a time, so
+// memory stays bounded however tall the image is. Rows that repeat the row above or are one
+// flat color skip the filter search, and their zero runs skip the match search.
+
+class PngWriter {
+public:
+    // RGBA8 in, stored as RGB when alpha is false. Throws std::runtime_error when the file can't be written.
+    PngWriter(const std::string& path, int width, int height, bool alpha, int threadCount = 0);
+
+    // top row first, in as many calls as convenient
+    void addRows(const uint8_t* rgba, int rows);
+
+    // after the last row, encodes what is left and closes the file
+    void finish();
+
+private:
+    std::ofstream file;
+    std::string path;
+    int width;
+    int height;
+    int channels;
+    int threadCount;
+    size_t rowBytes;
+    int stripRows;
+
+    int rowsAdded = 0;
+    bool headerWritten = false;
+    std::vector<uint8_t> pending; // rows waiting for a full window of strips, alpha already dropped
+    std::vector<uint8_t> previousRow; // the last encoded row, the filters' row above
+    std::vector<uint8_t> dictionary; // the last 32 KB of filtered data already written
+    uint32_t adler = 1;
+
+    void encodePending(bool last);
+    void writeChunk(const char* type, const uint8_t* data, size_t length);
+};
+
+void writePNG(const std::string& path, int width, int height, const std::vector<uint8_t>& rgba, int threadCount = 0);
+
+#endif // PNG_WRITER_H
@@ -0,0 +1,351 @@
+#include "posterRender.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "iterationFile.h"
+#include "parallelFor.h"
+#include "tiledTiff.h"
+
+namespace {
+
+const int TILE_SIZE = 256;
+
+// what a batch holds per pixel: the framebuffer planes, the row-major colors, the tiles cut from
+// them and their deflated copies, and perturbation's own planes when it is used
+const size_t BYTES_PER_PIXEL = 40;
+const size_t ITERATION_DATA_BYTES_PER_PIXEL = 8; // a batch's records before they are written
+
+uint32_t spreadBits(uint32_t value) {
+    value &= 0xffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
+
+int pyramidLevels(int width, int height) {
+    int levels = 1;
+    while (width > TILE_SIZE || height > TILE_SIZE) {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        ++levels;
+    }
+    return levels;
+}
+
+// Every tile above the first level is built from the four below it. A finished tile adds its
+// half size copy to the tile above, which is written once its last quarter arrives.
+class Pyramid {
+public:
+    Pyramid(TiledTiff& tiff, int threadCount) : tiff(tiff), threadCount(threadCount) {
+    }
+
+    void add(int level, int tileX, int tileY, const std::vector<uint8_t>& rgb) {
+        int parentLevel = level + 1;
+        if (parentLevel >= tiff.getLevelCount() || tiff.hasTile(parentLevel, tileX / 2, tileY / 2)) return;
+
+        auto key = std::make_tuple(parentLevel, tileX / 2, tileY / 2);
+        auto found = partial.find(key);
+        if (found == partial.end()) {
+            Partial created;
+            created.rgb.assign(static_cast<size_t>(TILE_SIZE) * TILE_SIZE * 3, 0);
+            int childrenAcross = std::min(2, tiff.getTilesAcross(level) - (tileX & ~1));
+            int childrenDown = std::min(2, tiff.getTilesDown(level) - (tileY & ~1));
+            created.missing = childrenAcross * childrenDown;
+            found = partial.emplace(key, std::move(created)).first;
+        }
+
+        // 2x2 box filter over the pixels inside the image, edge pixels average fewer
+        int validWidth = std::min(TILE_SIZE, tiff.getWidth(level) - tileX * TILE_SIZE);
+        int validHeight = std::min(TILE_SIZE, tiff.getHeight(level) - tileY * TILE_SIZE);
+        int quarterX = (tileX & 1) * TILE_SIZE / 2;
+        int quarterY = (tileY & 1) * TILE_SIZE / 2;
+        std::vector<uint8_t>& parent = found->second.rgb;
+        for (int y = 0; y < (validHeight + 1) / 2; ++y) {
+            for (int x = 0; x < (validWidth + 1) / 2; ++x) {
+                int sum[3] = { 0, 0, 0 };
+                int count = 0;
+                for (int dy = 0; dy < 2 && y * 2 + dy < validHeight; ++dy) {
+                    for (int dx = 0; dx < 2 && x * 2 + dx < validWidth; ++dx) {
+                        const uint8_t* pixel = rgb.data() + (static_cast<size_t>(y * 2 + dy) * TILE_SIZE + x * 2 + dx) * 3;
+                        for (int c = 0; c < 3; ++c) sum[c] += pixel[c];
+                        ++count;
+                    }
+                }
+                uint8_t* out = parent.data() + (static_cast<size_t>(quarterY + y) * TILE_SIZE + quarterX + x) * 3;
+                for (int c = 0; c < 3; ++c) out[c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+            }
+        }
+
+        if (--found->second.missing == 0) {
+            completed.push_back({ parentLevel, tileX / 2, tileY / 2, std::move(parent) });
+            partial.erase(found);
+        }
+    }
+
+    // writes the tiles add completed, and the ones they complete in turn
+    void flush() {
+        while (!completed.empty()) {
+            std::vector<Finished> finished = std::move(completed);
+            completed.clear();
+
+            std::vector<std::vector<uint8_t>> encoded(finished.size());
+            parallelFor(static_cast<int>(finished.size()), threadCount, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) encoded[i] = tiff.encodeTile(finished[i].rgb.data());
+            });
+            for (size_t i = 0; i < finished.size(); ++i) {
+                tiff.writeTile(finished[i].level, finished[i].tileX, finished[i].tileY, encoded[i]);
+            }
+            tiff.commit();
+
+            for (const Finished& tile : finished) add(tile.level, tile.tileX, tile.tileY, tile.rgb);
+        }
+    }
+
+    bool isComplete() const {
+        return partial.empty() && completed.empty();
+    }
+
+private:
+    struct Partial {
+        std::vector<uint8_t> rgb;
+        int missing = 0;
+    };
+
+    struct Finished {
+        int level;
+        int tileX;
+        int tileY;
+        std::vector<uint8_t> rgb;
+    };
+
+    TiledTiff& tiff;
+    int threadCount;
+    std::map<std::tuple<int, int, int>, Partial> partial;
+    std::vector<Finished> completed;
+};
+
+// The quarters of tiles that were written before the render stopped but whose parent wasn't,
+// read back from the file. Tiles a rebuilt parent completes are added as it is written.
+void rebuildPyramid(TiledTiff& tiff, Pyramid& pyramid) {
+    std::vector<std::vector<char>> writtenBefore(tiff.getLevelCount());
+    for (int level = 0; level < tiff.getLevelCount(); ++level) {
+        for (int tileY = 0; tileY < tiff.getTilesDown(level); ++tileY) {
+            for (int tileX = 0; tileX < tiff.getTilesAcross(level); ++tileX) writtenBefore[level].push_back(tiff.hasTile(level, tileX, tileY));
+        }
+    }
+
+    std::vector<uint8_t> rgb;
+    for (int level = 0; level + 1 < tiff.getLevelCount(); ++level) {
+        for (int tileY = 0; tileY < tiff.getTilesDown(level); ++tileY) {
+            for (int tileX = 0; tileX < tiff.getTilesAcross(level); ++tileX) {
+                if (!writtenBefore[level][static_cast<size_t>(tileY) * tiff.getTilesAcross(level) + tileX]) continue;
+                if (tiff.hasTile(level + 1, tileX / 2, tileY / 2)) continue;
+                tiff.readTile(level, tileX, tileY, rgb);
+                pyramid.add(level, tileX, tileY, rgb);
+            }
+        }
+        pyramid.flush();
+    }
+}
+
+// iterationData is null when the job doesn't ask for it
+PosterSummary renderInto(TiledTiff& tiff, IterationFileWriter* iterationData, const RenderJob& job, const PosterOptions& options, std::ostream& log) {
+    if (job.request.palette.equalize) {
+        throw std::runtime_error(job.output + ": posters can't be equalized batch by batch, save --iteration-data and equalize it with fractal-recolor");
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    PosterSummary summary;
+    summary.width = tiff.getWidth();
+    summary.height = tiff.getHeight();
+    summary.levels = tiff.getLevelCount();
+
+    RenderRequest request = job.request;
+    setViewCenter(request, job.centerReal, job.centerImag);
+    int threadCount = resolveThreadCount(request.threadCount);
+    if (!request.compiledEquation && selectBackend(request) == RenderBackend::EscapeTime) {
+        request.compiledEquation = std::make_shared<CompiledEquation>(request.equation, request.distanceEstimation);
+    }
+
+    Pyramid pyramid(tiff, threadCount);
+    rebuildPyramid(tiff, pyramid);
+
+    // the largest power of two batch of tiles that fits, so batches line up with pyramid tiles
+    int tilesAcross = tiff.getTilesAcross(0);
+    int tilesDown = tiff.getTilesDown(0);
+    size_t bytesPerPixel = BYTES_PER_PIXEL + (iterationData ? ITERATION_DATA_BYTES_PER_PIXEL : 0);
+    int batchTiles = 1;
+    while (batchTiles < std::max(tilesAcross, tilesDown) &&
+           static_cast<size_t>(batchTiles * 2 * TILE_SIZE) * (batchTiles * 2 * TILE_SIZE) * bytesPerPixel <= options.memoryLimit) {
+        batchTiles *= 2;
+    }
+
+    std::vector<std::pair<uint32_t, std::pair<int, int>>> batches;
+    for (int batchY = 0; batchY * batchTiles < tilesDown; ++batchY) {
+        for (int batchX = 0; batchX * batchTiles < tilesAcross; ++batchX) {
+            batches.push_back({ spreadBits(batchX) | (spreadBits(batchY) << 1), { batchX, batchY } });
+        }
+    }
+    std::sort(batches.begin(), batches.end());
+
+    const int width = tiff.getWidth();
+    const int height = tiff.getHeight();
+    for (size_t batch = 0; batch < batches.size(); ++batch) {
+        auto [batchX, batchY] = batches[batch].second;
+        int tileX0 = batchX * batchTiles;
+        int tileY0 = batchY * batchTiles;
+        int tileX1 = std::min(tileX0 + batchTiles, tilesAcross);
+        int tileY1 = std::min(tileY0 + batchTiles, tilesDown);
+
+        std::vector<std::pair<int, int>> missing;
+        for (int tileY = tileY0; tileY < tileY1; ++tileY) {
+            for (int tileX = tileX0; tileX < tileX1; ++tileX) {
+                if (tiff.hasTile(0, tileX, tileY)) ++summary.tilesResumed;
+                else missing.push_back({ tileX, tileY });
+            }
+        }
+        if (missing.empty()) continue;
+        auto batchStart = std::chrono::steady_clock::now();
+
+        // a batch resumed part way still renders its whole window and keeps the missing tiles, fills
+        // and guesses depend on where the window starts, so a smaller one could change the pixels
+
+        // TIFF rows go top down, the view's go bottom up
+        int x0 = tileX0 * TILE_SIZE;
+        int row0 = tileY0 * TILE_SIZE;
+        int row1 = std::min(tileY1 * TILE_SIZE, height);
+        request.windowX = x0;
+        request.windowWidth = std::min(tileX1 * TILE_SIZE, width) - x0;
+        request.windowY = height - row1;
+        request.windowHeight = row1 - row0;
+        RenderResult result = render(request);
+        if (summary.warning.empty() && !result.warning.empty()) {
+            summary.warning = result.warning;
+            log << job.output << ": warning: " << result.warning << "\n";
+        }
+        if (iterationData) iterationData->writeTiles(result.image, x0, row0, threadCount);
+        result.image = TiledFramebuffer();
+
+        std::vector<std::vector<uint8_t>> tiles(missing.size());
+        std::vector<std::vector<uint8_t>> encoded(missing.size());
+        parallelFor(static_cast<int>(missing.size()), threadCount, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                auto [tileX, tileY] = missing[i];
+                std::vector<uint8_t>& rgb = tiles[i];
+                rgb.assign(static_cast<size_t>(TILE_SIZE) * TILE_SIZE * 3, 0);
+                int left = tileX * TILE_SIZE - x0;
+                int top = tileY * TILE_SIZE - row0;
+                int columns = std::min(TILE_SIZE, result.width - left);
+                int rows = std::min(TILE_SIZE, result.height - top);
+                for (int y = 0; y < rows; ++y) {
+                    const uint8_t* source = result.rgba.data() + (static_cast<size_t>(top + y) * result.width + left) * 4;
+                    uint8_t* out = rgb.data() + static_cast<size_t>(y) * TILE_SIZE * 3;
+                    for (int x = 0; x < columns; ++x) {
+                        out[x * 3] = source[x * 4];
+                        out[x * 3 + 1] = source[x * 4 + 1];
+                        out[x * 3 + 2] = source[x * 4 + 2];
+                    }
+                }
+                encoded[i] = tiff.encodeTile(rgb.data());
+            }
+        });
+        result.rgba = std::vector<uint8_t>();
+
+        for (size_t i = 0; i < missing.size(); ++i) {
+            tiff.writeTile(0, missing[i].first, missing[i].second, encoded[i]);
+        }
+        // a tile in the TIFF has its iteration data in the other file, so that goes first
+        if (iterationData) iterationData->commit();
+        tiff.commit();
+        summary.tilesRendered += static_cast<int>(missing.size());
+        ++summary.batches;
+
+        for (size_t i = 0; i < missing.size(); ++i) pyramid.add(0, missing[i].first, missing[i].second, tiles[i]);
+        pyramid.flush();
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+        log << job.output << ": batch " << batch + 1 << " of " << batches.size() << ", " << missing.size() << " tiles in " << milliseconds << " ms\n";
+    }
+
+    if (!pyramid.isComplete()) {
+        throw std::runtime_error(job.output + ": the pyramid is missing tiles");
+    }
+    tiff.close();
+    if (iterationData) iterationData->close();
+
+    summary.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return summary;
+}
+
+} // namespace
+
+bool isPosterPath(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".tif" || extension == ".tiff";
+}
+
+PosterSummary renderPoster(const RenderJob& job, const PosterOptions& options, std::ostream& log) {
+    std::string description = formatRenderJob(job);
+    int levels = options.pyramid ? pyramidLevels(job.request.width, job.request.height) : 1;
+
+    TiledTiff tiff;
+    IterationFileWriter iterationData;
+    bool withIterationData = !job.iterationData.empty();
+    bool resumed = false;
+    if (std::filesystem::exists(job.output)) {
+        try {
+            tiff.open(job.output);
+            bool same = tiff.getDescription() == description && tiff.getLevelCount() == levels && tiff.getTileSize() == TILE_SIZE;
+            if (same && withIterationData) {
+                iterationData.open(job.iterationData);
+                same = iterationData.getDescription() == description;
+            }
+            resumed = same;
+        }
+        catch (const std::runtime_error&) {
+            // not a render this could finish, it is replaced
+        }
+    }
+    if (!resumed) {
+        tiff.create(job.output, job.request.width, job.request.height, TILE_SIZE, levels, description);
+        if (withIterationData) iterationData.create(job.iterationData, job.request.width, job.request.height, job.request.iterations, description, rootBasinRadius(job.request));
+    }
+    return renderInto(tiff, withIterationData ? &iterationData : nullptr, job, options, log);
+}
+
+PosterSummary resumePoster(const std::string& path, const PosterOptions& options, int threadCount, std::ostream& log) {
+    TiledTiff tiff;
+    tiff.open(path);
+    if (tiff.getTileSize() != TILE_SIZE) {
+        throw std::runtime_error(path + ": wasn't written by fractal-render");
+    }
+
+    RenderJob job = parseRenderJob(tiff.getDescription(), path, RenderJob());
+    job.output = path;
+    job.request.threadCount = threadCount;
+    if (job.request.width != tiff.getWidth() || job.request.height != tiff.getHeight()) {
+        throw std::runtime_error(path + ": the stored job doesn't match the image size");
+    }
+
+    IterationFileWriter iterationData;
+    if (!job.iterationData.empty()) {
+        iterationData.open(job.iterationData);
+        if (iterationData.getDescription() != tiff.getDescription()) {
+            throw std::runtime_error(job.iterationData + ": is the iteration data of another render");
+        }
+    }
+    return renderInto(tiff, job.iterationData.empty() ? nullptr : &iterationData, job, options, log);
+}
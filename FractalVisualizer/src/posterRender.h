@@ -0,0 +1,46 @@
+#ifndef POSTER_RENDER_H
+#define POSTER_RENDER_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "renderJobs.h"
+
+// Stills of any size in bounded memory, written to a tiled TIFF (see tiledTiff.h). The image is
+// cut into square batches of TIFF tiles, as large as the memory limit allows, and each batch is
+// rendered as a window of the whole view with every thread, then colored, deflated and written
+// before the next one starts. Batches go in Morton order, so the tiles under a pyramid tile
+// finish together and only one unfinished tile per pyramid level is ever held.
+// The job is stored in the file, so a render that was stopped carries on where it left off.
+// Iteration data the job asks for (see iterationFile.h) is written batch by batch alongside.
+// Equalizing palettes need the histogram of the whole image before the first batch is colored,
+// so they are turned down: fractal-recolor equalizes the iteration data of a poster instead.
+
+struct PosterOptions {
+    bool pyramid = false; // reduced resolution levels down to a single tile
+    size_t memoryLimit = static_cast<size_t>(1024) << 20; // bytes for the batch being rendered
+};
+
+struct PosterSummary {
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+    int tilesRendered = 0;
+    int tilesResumed = 0; // already in the file
+    int batches = 0;
+    double milliseconds = 0.0;
+    std::string warning; // of the first batch, see RenderResult
+};
+
+// .tif and .tiff
+bool isPosterPath(const std::string& path);
+
+// Writes job.output. A file there holding part of the same job and pyramid is finished instead
+// of started again. Throws std::runtime_error.
+PosterSummary renderPoster(const RenderJob& job, const PosterOptions& options, std::ostream& log);
+
+// finishes a file renderPoster started, with the job and pyramid stored in it
+PosterSummary resumePoster(const std::string& path, const PosterOptions& options, int threadCount, std::ostream& log);
+
+#endif // POSTER_RENDER_H
@@ -0,0 +1,255 @@
+#include "renderCore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#include "perturbation.h"
+#include "supersampling.h"
+
+namespace {
+
+// sub-samples laid out together for perturbation, so the glitch correction's buffers stay small
+constexpr int SUBSAMPLE_BATCH = 1 << 20;
+
+PerturbationSettings makePerturbationSettings(const RenderRequest& request, const EscapeTimeSettings& escapeSettings) {
+    PerturbationSettings settings;
+    settings.width = escapeSettings.width;
+    settings.height = escapeSettings.height;
+    settings.imageWidth = escapeSettings.imageWidth;
+    settings.imageHeight = escapeSettings.imageHeight;
+    settings.originX = escapeSettings.originX;
+    settings.originY = escapeSettings.originY;
+    settings.centerX = request.view.centerX;
+    settings.centerY = request.view.centerY;
+    settings.zoom = request.view.getZoom();
+    settings.iterations = request.iterations;
+    settings.escapeRadius = request.escapeRadius;
+    settings.periodicityInterval = request.periodicityInterval;
+    settings.distanceEstimation = request.distanceEstimation;
+    settings.distanceRange = request.distanceRange;
+    settings.threadCount = request.threadCount;
+    return settings;
+}
+
+// Iterates the sub-samples of the pixels on edges with the backend the frame used and replaces
+// their colors with the average, see supersampling.h
+void supersampleEdges(const RenderRequest& request, const EscapeTimeSettings& escapeSettings, RenderResult& result) {
+    int grid = subsampleGrid(request.supersamples);
+    int count = grid * grid;
+    std::vector<int> pixels = findEdgePixels(result.image, request.iterations, request.supersampleThreshold, request.threadCount);
+    result.statistics.supersampledPixels = static_cast<int>(pixels.size());
+    if (pixels.empty()) return;
+
+    int width = result.width;
+    int imageWidth = escapeSettings.imageWidth > 0 ? escapeSettings.imageWidth : escapeSettings.width;
+    int imageHeight = escapeSettings.imageHeight > 0 ? escapeSettings.imageHeight : escapeSettings.height;
+    int originX = escapeSettings.originX;
+    int originY = escapeSettings.originY;
+    size_t total = pixels.size() * count;
+    std::vector<float> samples(total);
+    float basinRadius = rootBasinRadius(request);
+    std::vector<float> basins(basinRadius > 0.0f ? total : 0);
+
+    // sample of the whole image as its pixel there and the offset from the pixel's corner
+    auto locate = [&](size_t sample, int& x, int& y, double& offsetX, double& offsetY) {
+        int pixel = pixels[sample / count];
+        int cell = static_cast<int>(sample % count);
+        x = pixel % width + originX;
+        y = pixel / width + originY;
+        subsamplePosition(x, y, cell % grid, cell / grid, grid, offsetX, offsetY);
+    };
+
+    if (result.backend == RenderBackend::Perturbation) {
+        // Bands of rows of the image's sub-sample lattice, grid x grid samples per pixel, so the
+        // glitched regions are made of neighbouring samples. Only the edge pixels' are iterated
+        PerturbationSettings settings = makePerturbationSettings(request, escapeSettings);
+        settings.imageWidth = imageWidth;
+        settings.imageHeight = imageHeight;
+        settings.originX = 0;
+        settings.originY = 0;
+        settings.width = width * grid;
+        FloatExp span = settings.zoom.timesPowerOfTwo(1);
+        int bandRows = std::max(1, SUBSAMPLE_BATCH / settings.width / grid);
+
+        std::vector<float> values;
+        std::vector<char> active;
+        auto first = pixels.begin();
+        for (int bandY = 0; bandY < result.height && first != pixels.end(); bandY += bandRows) {
+            int rows = std::min(bandRows, result.height - bandY);
+            auto last = std::lower_bound(first, pixels.end(), (bandY + rows) * width);
+            if (first == last) continue;
+
+            settings.height = rows * grid;
+            active.assign(static_cast<size_t>(settings.width) * settings.height, 0);
+            for (auto pixel = first; pixel != last; ++pixel) {
+                int latticeX = *pixel % width * grid;
+                int latticeY = (*pixel / width - bandY) * grid;
+                for (int cellY = 0; cellY < grid; ++cellY) {
+                    std::fill_n(active.begin() + static_cast<size_t>(latticeY + cellY) * settings.width + latticeX, grid, 1);
+                }
+            }
+
+            FrameStatistics statistics;
+            renderPerturbationSamples(settings, [&](int sampleX, int sampleY, FloatExp& real, FloatExp& imag) {
+                int x = sampleX / grid + originX;
+                int y = sampleY / grid + bandY + originY;
+                double offsetX, offsetY;
+                subsamplePosition(x, y, sampleX % grid, sampleY % grid, grid, offsetX, offsetY);
+                real = FloatExp((x + offsetX) / imageWidth - 0.5) * span;
+                imag = FloatExp((y + offsetY) / imageHeight - 0.5) * span;
+            }, values, statistics, nullptr, nullptr, &active);
+
+            for (auto pixel = first; pixel != last; ++pixel) {
+                size_t sample = static_cast<size_t>(pixel - pixels.begin()) * count;
+                int latticeX = *pixel % width * grid;
+                int latticeY = (*pixel / width - bandY) * grid;
+                for (int cell = 0; cell < count; ++cell) {
+                    samples[sample + cell] = values[static_cast<size_t>(latticeY + cell / grid) * settings.width + latticeX + cell % grid];
+                }
+            }
+            first = last;
+        }
+    }
+    else {
+        EscapeTimeKernel kernel(escapeSettings);
+        const int chunk = 256;
+        int chunks = static_cast<int>((pixels.size() + chunk - 1) / chunk);
+        parallelFor(chunks, request.threadCount, [&](int begin, int end) {
+            size_t last = std::min(total, static_cast<size_t>(end) * chunk * count);
+            for (size_t sample = static_cast<size_t>(begin) * chunk * count; sample < last; ++sample) {
+                int x, y;
+                double offsetX, offsetY, finalReal, finalImag;
+                locate(sample, x, y, offsetX, offsetY);
+                double real = (((x + offsetX) / imageWidth - 0.5) * escapeSettings.zoom + escapeSettings.centerX) * 2.0;
+                double imag = (((y + offsetY) / imageHeight - 0.5) * escapeSettings.zoom + escapeSettings.centerY) * 2.0;
+                samples[sample] = kernel.evaluatePoint(real, imag, finalReal, finalImag);
+                if (!basins.empty()) basins[sample] = rootBasin(samples[sample], request.iterations, finalReal, finalImag, basinRadius);
+            }
+        });
+    }
+
+    blendSubsamples(result.image, pixels, samples, basins, grid, request.iterations, request.palette, request.threadCount);
+}
+
+}
+
+double pixelLog2(const RenderRequest& request) {
+    return request.view.logZoom + 1.0 - std::log2(std::max({ request.width, request.height, 1 }));
+}
+
+std::string quantizationWarning(double pixelLog2, double limitLog2, const char* precision) {
+    if (pixelLog2 >= limitLog2) return "";
+    return "pixels are 2^" + std::to_string(static_cast<int>(std::floor(pixelLog2))) + " wide, smaller than " + precision
+        + " can tell apart, so the image is quantized";
+}
+
+RenderBackend selectBackend(const RenderRequest& request) {
+    return selectBackend(request, pixelLog2(request));
+}
+
+RenderBackend selectBackend(const RenderRequest& request, double pixelLog2) {
+    if (request.backend != RenderBackend::Automatic) return request.backend;
+
+    bool supported = isPerturbationSupported(analyzeEquation(request.equation));
+    return supported && pixelLog2 < DOUBLE_PIXEL_LOG2 ? RenderBackend::Perturbation : RenderBackend::EscapeTime;
+}
+
+RenderBackend parseRenderBackend(const std::string& name) {
+    if (name == "auto") return RenderBackend::Automatic;
+    if (name == "escape") return RenderBackend::EscapeTime;
+    if (name == "perturbation") return RenderBackend::Perturbation;
+    throw std::runtime_error("Unknown backend: " + name);
+}
+
+FillMode parseFillMode(const std::string& name) {
+    if (name == "auto") return FillMode::Automatic;
+    if (name == "brute") return FillMode::BruteForce;
+    if (name == "subdivision") return FillMode::Subdivision;
+    if (name == "guessing") return FillMode::SolidGuessing;
+    if (name == "tracing") return FillMode::BoundaryTracing;
+    throw std::runtime_error("Unknown fill mode: " + name);
+}
+
+// the view keeps the center at half scale like the shader's pixel mapping
+void setViewCenter(RenderRequest& request, const std::string& real, const std::string& imag) {
+    int limbs = request.view.requiredFractionalLimbs(std::max(request.width, request.height));
+    BigFixed half = BigFixed::fromString("0.5", limbs);
+    request.view.centerX.reservePrecision(limbs);
+    request.view.centerY.reservePrecision(limbs);
+    BigFixed::multiply(BigFixed::fromString(real, limbs), half, request.view.centerX);
+    BigFixed::multiply(BigFixed::fromString(imag, limbs), half, request.view.centerY);
+}
+
+EscapeTimeSettings makeEscapeTimeSettings(const RenderRequest& request) {
+    EscapeTimeSettings settings;
+    settings.width = request.width;
+    settings.height = request.height;
+    if (request.windowWidth > 0 && request.windowHeight > 0) {
+        settings.width = request.windowWidth;
+        settings.height = request.windowHeight;
+        settings.imageWidth = request.width;
+        settings.imageHeight = request.height;
+        settings.originX = request.windowX;
+        settings.originY = request.windowY;
+    }
+    settings.centerX = request.view.centerX.toDouble();
+    settings.centerY = request.view.centerY.toDouble();
+    settings.zoom = static_cast<double>(request.view.getZoom());
+    settings.iterations = request.iterations;
+    settings.escapeRadius = request.escapeRadius;
+    settings.periodicityInterval = request.periodicityInterval;
+    settings.distanceEstimation = request.distanceEstimation;
+    settings.distanceRange = request.distanceRange;
+    settings.fillMode = request.fillMode;
+    settings.exactFinalPass = true;
+    settings.equation = request.equation;
+    settings.variables = request.variables;
+    settings.compiledEquation = request.compiledEquation;
+    settings.threadCount = request.threadCount;
+    return settings;
+}
+
+float rootBasinRadius(const RenderRequest& request) {
+    bool converges = request.compiledEquation && request.compiledEquation->equation == request.equation
+        ? request.compiledEquation->traits.converges : analyzeEquation(request.equation).converges;
+    return converges ? request.escapeRadius : 0.0f;
+}
+
+RenderResult render(const RenderRequest& request) {
+    EscapeTimeSettings escapeSettings = makeEscapeTimeSettings(request);
+
+    RenderResult result;
+    result.width = escapeSettings.width;
+    result.height = escapeSettings.height;
+    result.backend = selectBackend(request);
+
+    if (result.backend == RenderBackend::Perturbation) {
+        if (!isPerturbationSupported(analyzeEquation(request.equation))) {
+            throw std::runtime_error("Perturbation needs z^2 + c");
+        }
+
+        PerturbationSettings settings = makePerturbationSettings(request, escapeSettings);
+
+        // glitch correction works on whole rows and regions, only the result is tiled
+        std::vector<float> smoothIterations, finalReal, finalImag;
+        renderPerturbation(settings, smoothIterations, result.statistics, &finalReal, &finalImag);
+        result.image.resize(result.width, result.height);
+        result.image.writeSmoothIterations(smoothIterations);
+        result.image.writeFinalZ(finalReal, finalImag);
+    }
+    else {
+        renderEscapeTime(escapeSettings, result.image, result.statistics);
+        result.warning = quantizationWarning(pixelLog2(request), DOUBLE_PIXEL_LOG2, "doubles");
+    }
+
+    colorize(result.image, request.iterations, request.palette, request.threadCount, rootBasinRadius(request));
+    if (request.supersamples > 1) {
+        auto start = std::chrono::steady_clock::now();
+        supersampleEdges(request, escapeSettings, result);
+        result.statistics.renderMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    result.image.readColors(result.rgba);
+    return result;
+}
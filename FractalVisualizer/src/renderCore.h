@@ -0,0 +1,101 @@
+#ifndef RENDER_CORE_H
+#define RENDER_CORE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "viewState.h"
+#include "palette.h"
+#include "frameStatistics.h"
+#include "escapeTimeRenderer.h"
+#include "tiledFramebuffer.h"
+
+// One still image rendered entirely on the CPU, without a window or OpenGL. Everything the
+// GUI keeps in globals is passed in the request, so the viewer and fractal-render share it.
+
+// log2 of the smallest pixel the renderers that iterate c directly still tell apart near the set,
+// in doubles on the CPU and in floats in the shader. Perturbation resolves any depth.
+constexpr double DOUBLE_PIXEL_LOG2 = -42.0;
+constexpr double FLOAT_PIXEL_LOG2 = -19.9;
+
+enum class RenderBackend {
+    Automatic, // perturbation for z^2 + c once doubles can't resolve a pixel, escape time otherwise
+    EscapeTime,
+    Perturbation
+};
+
+struct RenderRequest {
+    // both sides cover the same span of c, like the GUI's view, so only square images are undistorted
+    int width = 1080;
+    int height = 1080;
+    ViewState view;
+
+    // only this part of the image is rendered when windowWidth and windowHeight are set,
+    // x from the left and y from the bottom, the result is windowWidth x windowHeight
+    int windowX = 0;
+    int windowY = 0;
+    int windowWidth = 0;
+    int windowHeight = 0;
+
+    std::string equation = "z^2 + c";
+    std::map<std::string, std::pair<double, double>> variables;
+    std::shared_ptr<const CompiledEquation> compiledEquation; // shared by a batch, compiled per render when it doesn't match
+
+    int iterations = 100;
+    float escapeRadius = 5.0f;
+    int periodicityInterval = 20;
+    bool distanceEstimation = false;
+    float distanceRange = 8.0f;
+
+    Palette palette;
+
+    // edge pixels are iterated again at this many jittered sub-samples, a square, 0 or 1 turns it off
+    int supersamples = 0;
+    float supersampleThreshold = 1.0f; // smooth iterations between neighbours that make an edge, negative for every pixel
+
+    RenderBackend backend = RenderBackend::Automatic;
+    FillMode fillMode = FillMode::Automatic;
+    int threadCount = 0; // 0 uses every hardware thread
+};
+
+struct RenderResult {
+    int width = 0;
+    int height = 0;
+
+    TiledFramebuffer image; // smooth iterations, final z and colors
+    std::vector<uint8_t> rgba; // row-major copy of the colors, top row first
+
+    RenderBackend backend = RenderBackend::EscapeTime;
+    FrameStatistics statistics;
+    std::string warning; // from quantizationWarning when the backend can't resolve the view's pixels
+};
+
+// throws std::runtime_error for equations the parser rejects or a backend that can't draw them
+RenderResult render(const RenderRequest& request);
+
+// log2 of the width of the request's pixels in the complex plane, the smaller of the two sides
+double pixelLog2(const RenderRequest& request);
+
+// Empty while pixels 2^pixelLog2 wide are at least 2^limitLog2, otherwise says the image is
+// quantized because the precision named can't tell them apart
+std::string quantizationWarning(double pixelLog2, double limitLog2, const char* precision);
+
+RenderBackend selectBackend(const RenderRequest& request);
+RenderBackend selectBackend(const RenderRequest& request, double pixelLog2); // for samples pixelLog2 apart
+RenderBackend parseRenderBackend(const std::string& name); // auto, escape or perturbation
+FillMode parseFillMode(const std::string& name); // auto, brute, subdivision, guessing or tracing
+
+// Sets the view center from decimal strings of any length, read with enough limbs for one
+// pixel at the request's zoom and size, so set those first
+void setViewCenter(RenderRequest& request, const std::string& real, const std::string& imag);
+
+EscapeTimeSettings makeEscapeTimeSettings(const RenderRequest& request);
+
+// the basinRadius colorize takes, the escape radius for converging equations and 0 otherwise
+float rootBasinRadius(const RenderRequest& request);
+
+#endif // RENDER_CORE_H
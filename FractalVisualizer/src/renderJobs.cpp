@@ -0,0 +1,529 @@
+#include "renderJobs.h"
+
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "imageFile.h"
+#include "iterationFile.h"
+#include "parallelFor.h"
+#include "posterRender.h"
+#include "supersampling.h"
+
+namespace {
+
+// just enough JSON for job files, numbers keep their text so centers don't go through a double
+struct JsonValue {
+    enum class Type { Null, Boolean, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    std::string text; // strings, and numbers as written
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+    int line = 1;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& [name, value] : members) {
+            if (name == key) return &value;
+        }
+        return nullptr;
+    }
+};
+
+class JsonReader {
+public:
+    JsonReader(const std::string& text, const std::string& path) : text(text), path(path) {
+    }
+
+    bool atEnd() {
+        skipWhitespace();
+        return position >= text.size();
+    }
+
+    JsonValue parseValue() {
+        skipWhitespace();
+        JsonValue value;
+        value.line = line;
+        if (position >= text.size()) fail("Unexpected end of file");
+
+        char c = text[position];
+        if (c == '{') {
+            value.type = JsonValue::Type::Object;
+            ++position;
+            if (consume('}')) return value;
+            do {
+                skipWhitespace();
+                if (position >= text.size() || text[position] != '"') fail("Expected a key");
+                std::string key = parseString();
+                expect(':');
+                value.members.push_back({ key, parseValue() });
+            } while (consume(','));
+            expect('}');
+        }
+        else if (c == '[') {
+            value.type = JsonValue::Type::Array;
+            ++position;
+            if (consume(']')) return value;
+            do {
+                value.items.push_back(parseValue());
+            } while (consume(','));
+            expect(']');
+        }
+        else if (c == '"') {
+            value.type = JsonValue::Type::String;
+            value.text = parseString();
+        }
+        else if (c == '-' || (c >= '0' && c <= '9')) {
+            value.type = JsonValue::Type::Number;
+            size_t start = position;
+            while (position < text.size() && std::string("+-.eE0123456789").find(text[position]) != std::string::npos) ++position;
+            value.text = text.substr(start, position - start);
+        }
+        else if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0) {
+            value.type = JsonValue::Type::Boolean;
+            value.boolean = text[position] == 't';
+            position += value.boolean ? 4 : 5;
+        }
+        else if (text.compare(position, 4, "null") == 0) {
+            position += 4;
+        }
+        else {
+            fail(std::string("Unexpected character ") + c);
+        }
+        return value;
+    }
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error(path + ":" + std::to_string(line) + ": " + message);
+    }
+
+private:
+    const std::string& text;
+    const std::string& path;
+    size_t position = 0;
+    int line = 1;
+
+    void skipWhitespace() {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+            if (text[position] == '\n') ++line;
+            ++position;
+        }
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (position < text.size() && text[position] == c) {
+            ++position;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) fail(std::string("Expected ") + c);
+    }
+
+    std::string parseString() {
+        std::string result;
+        ++position;
+        while (position < text.size() && text[position] != '"') {
+            char c = text[position++];
+            if (c == '\n') fail("Unterminated string");
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (position >= text.size()) break;
+
+            char escaped = text[position++];
+            switch (escaped) {
+                case 'n': result += '\n'; break;
+                case 't': result += '\t'; break;
+                case 'r': result += '\r'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'u': {
+                    if (position + 4 > text.size()) fail("Bad \\u escape");
+                    unsigned int code = std::stoul(text.substr(position, 4), nullptr, 16);
+                    position += 4;
+                    // UTF-8, surrogate pairs aren't needed for paths and equations
+                    if (code < 0x80) result += static_cast<char>(code);
+                    else if (code < 0x800) {
+                        result += static_cast<char>(0xc0 | (code >> 6));
+                        result += static_cast<char>(0x80 | (code & 0x3f));
+                    }
+                    else {
+                        result += static_cast<char>(0xe0 | (code >> 12));
+                        result += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                        result += static_cast<char>(0x80 | (code & 0x3f));
+                    }
+                    break;
+                }
+                default: result += escaped; break;
+            }
+        }
+        if (position >= text.size()) fail("Unterminated string");
+        ++position;
+        return result;
+    }
+};
+
+class JobReader {
+public:
+    JobReader(const std::string& path) : path(path) {
+    }
+
+    RenderJob read(const JsonValue& object, const RenderJob& defaults) const {
+        RenderJob job = defaults;
+        job.source = path + ":" + std::to_string(object.line);
+        if (object.type != JsonValue::Type::Object) fail(object, "A job must be an object");
+
+        std::vector<Color> colors;
+        for (const auto& [key, value] : object.members) {
+            RenderRequest& request = job.request;
+            if (key == "output") job.output = string(value, key);
+            else if (key == "size") {
+                std::vector<double> size = numbers(value, key, 2);
+                request.width = static_cast<int>(size[0]);
+                request.height = static_cast<int>(size[1]);
+                if (request.width <= 0 || request.height <= 0) fail(value, "size must be positive");
+            }
+            else if (key == "center") {
+                if (value.type != JsonValue::Type::Array || value.items.size() != 2) fail(value, "center must be [real, imag]");
+                job.centerReal = digits(value.items[0], key);
+                job.centerImag = digits(value.items[1], key);
+            }
+            else if (key == "zoom") request.view.logZoom = number(value, key);
+            else if (key == "equation") request.equation = string(value, key);
+            else if (key == "variables") {
+                if (value.type != JsonValue::Type::Object) fail(value, "variables must be an object");
+                for (const auto& [name, variable] : value.members) {
+                    std::vector<double> complex = numbers(variable, name, 2);
+                    request.variables[name] = { complex[0], complex[1] };
+                }
+            }
+            else if (key == "iterations") request.iterations = static_cast<int>(number(value, key));
+            else if (key == "escapeRadius") request.escapeRadius = static_cast<float>(number(value, key));
+            else if (key == "periodicity") request.periodicityInterval = static_cast<int>(number(value, key));
+            else if (key == "distance") {
+                request.distanceEstimation = true;
+                request.distanceRange = static_cast<float>(number(value, key));
+            }
+            else if (key == "colorStops") {
+                if (value.type != JsonValue::Type::Array || value.items.empty()) fail(value, "colorStops must be a list of colors");
+                colors.clear();
+                for (const JsonValue& stop : value.items) {
+                    std::vector<double> rgba = numbers(stop, key, 0);
+                    if (rgba.size() != 3 && rgba.size() != 4) fail(stop, "A color stop is [r, g, b] or [r, g, b, a]");
+                    colors.push_back({ static_cast<float>(rgba[0]), static_cast<float>(rgba[1]), static_cast<float>(rgba[2]), rgba.size() == 4 ? static_cast<float>(rgba[3]) : 1.0f });
+                }
+            }
+            else if (key == "stopPositions") {
+                request.palette.positions.clear();
+                for (double position : numbers(value, key, 0)) request.palette.positions.push_back(static_cast<float>(position));
+            }
+            else if (key == "contrast") request.palette.contrast = static_cast<float>(number(value, key));
+            else if (key == "interpolation") request.palette.interpolation = named(value, key, parsePaletteInterpolation);
+            else if (key == "repeats") {
+                request.palette.repeats = static_cast<int>(number(value, key));
+                if (request.palette.repeats < 0) fail(value, "repeats can't be negative");
+            }
+            else if (key == "paletteSize") {
+                request.palette.lutSize = static_cast<int>(number(value, key));
+                if (request.palette.lutSize < 1) fail(value, "paletteSize must be positive");
+            }
+            else if (key == "equalize") request.palette.equalize = boolean(value, key);
+            else if (key == "supersamples") {
+                request.supersamples = static_cast<int>(number(value, key));
+                try {
+                    subsampleGrid(request.supersamples);
+                }
+                catch (const std::runtime_error& e) {
+                    fail(value, e.what());
+                }
+            }
+            else if (key == "supersampleThreshold") request.supersampleThreshold = static_cast<float>(number(value, key));
+            else if (key == "backend") request.backend = named(value, key, parseRenderBackend);
+            else if (key == "fill") request.fillMode = named(value, key, parseFillMode);
+            else if (key == "iterationData") job.iterationData = string(value, key);
+            else fail(value, "Unknown key " + key);
+        }
+
+        if (!colors.empty()) job.request.palette.colors = colors;
+        if (job.output.empty()) fail(object, "The job has no output");
+        return job;
+    }
+
+private:
+    const std::string& path;
+
+    [[noreturn]] void fail(const JsonValue& value, const std::string& message) const {
+        throw std::runtime_error(path + ":" + std::to_string(value.line) + ": " + message);
+    }
+
+    double number(const JsonValue& value, const std::string& key) const {
+        if (value.type != JsonValue::Type::Number) fail(value, key + " must be a number");
+        try {
+            return std::stod(value.text);
+        }
+        catch (const std::exception&) {
+            fail(value, "Bad number " + value.text);
+        }
+    }
+
+    std::vector<double> numbers(const JsonValue& value, const std::string& key, size_t count) const {
+        if (value.type != JsonValue::Type::Array || (count != 0 && value.items.size() != count)) {
+            fail(value, key + " must be a list of " + (count != 0 ? std::to_string(count) + " numbers" : "numbers"));
+        }
+        std::vector<double> result;
+        for (const JsonValue& item : value.items) result.push_back(number(item, key));
+        return result;
+    }
+
+    std::string string(const JsonValue& value, const std::string& key) const {
+        if (value.type != JsonValue::Type::String) fail(value, key + " must be a string");
+        return value.text;
+    }
+
+    bool boolean(const JsonValue& value, const std::string& key) const {
+        if (value.type != JsonValue::Type::Boolean) fail(value, key + " must be true or false");
+        return value.boolean;
+    }
+
+    template <typename Result>
+    Result named(const JsonValue& value, const std::string& key, Result (*parse)(const std::string&)) const {
+        try {
+            return parse(string(value, key));
+        }
+        catch (const std::runtime_error& e) {
+            fail(value, e.what());
+        }
+    }
+
+    // numbers or strings, passed on to BigFixed as written
+    std::string digits(const JsonValue& value, const std::string& key) const {
+        if (value.type != JsonValue::Type::Number && value.type != JsonValue::Type::String) fail(value, key + " must hold numbers");
+        return value.text;
+    }
+};
+
+std::string quote(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') result += '\\';
+        if (c == '\n') result += "\\n";
+        else if (c == '\t') result += "\\t";
+        else if (c == '\r') result += "\\r";
+        else result += c;
+    }
+    return result + "\"";
+}
+
+// the shortest precision that reads back to the same value
+std::string formatNumber(double value) {
+    std::ostringstream text;
+    text << std::setprecision(17) << value;
+    return text.str();
+}
+
+std::string formatNumber(float value) {
+    std::ostringstream text;
+    text << std::setprecision(9) << value;
+    return text.str();
+}
+
+const char* backendName(RenderBackend backend) {
+    switch (backend) {
+        case RenderBackend::EscapeTime: return "escape";
+        case RenderBackend::Perturbation: return "perturbation";
+        default: return "auto";
+    }
+}
+
+const char* interpolationName(PaletteInterpolation interpolation) {
+    switch (interpolation) {
+        case PaletteInterpolation::Smooth: return "smooth";
+        case PaletteInterpolation::Step: return "step";
+        default: return "linear";
+    }
+}
+
+const char* fillName(FillMode mode) {
+    switch (mode) {
+        case FillMode::BruteForce: return "brute";
+        case FillMode::Subdivision: return "subdivision";
+        case FillMode::SolidGuessing: return "guessing";
+        case FillMode::BoundaryTracing: return "tracing";
+        default: return "auto";
+    }
+}
+
+} // namespace
+
+std::vector<RenderJob> readRenderJobs(const std::string& path, const RenderJob& defaults) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    // JSON Lines is a sequence of documents too, so both forms read the same way
+    JsonReader json(text, path);
+    JobReader reader(path);
+    std::vector<RenderJob> jobs;
+    while (!json.atEnd()) {
+        JsonValue document = json.parseValue();
+        const JsonValue* list = document.type == JsonValue::Type::Object ? document.find("jobs") : nullptr;
+        if (list && list->type == JsonValue::Type::Array) {
+            for (const JsonValue& item : list->items) jobs.push_back(reader.read(item, defaults));
+        }
+        else if (document.type == JsonValue::Type::Array) {
+            for (const JsonValue& item : document.items) jobs.push_back(reader.read(item, defaults));
+        }
+        else {
+            jobs.push_back(reader.read(document, defaults));
+        }
+    }
+    return jobs;
+}
+
+std::string formatRenderJob(const RenderJob& job) {
+    const RenderRequest& request = job.request;
+    std::ostringstream json;
+    json << "{\"output\": " << quote(job.output)
+        << ", \"size\": [" << request.width << ", " << request.height << "]"
+        << ", \"center\": [" << quote(job.centerReal) << ", " << quote(job.centerImag) << "]"
+        << ", \"zoom\": " << formatNumber(request.view.logZoom)
+        << ", \"equation\": " << quote(request.equation)
+        << ", \"variables\": {";
+    bool first = true;
+    for (const auto& [name, value] : request.variables) {
+        json << (first ? "" : ", ") << quote(name) << ": [" << formatNumber(value.first) << ", " << formatNumber(value.second) << "]";
+        first = false;
+    }
+    json << "}, \"iterations\": " << request.iterations
+        << ", \"escapeRadius\": " << formatNumber(request.escapeRadius)
+        << ", \"periodicity\": " << request.periodicityInterval;
+    if (request.distanceEstimation) json << ", \"distance\": " << formatNumber(request.distanceRange);
+
+    json << ", \"colorStops\": [";
+    for (size_t i = 0; i < request.palette.colors.size(); ++i) {
+        const Color& color = request.palette.colors[i];
+        json << (i == 0 ? "[" : ", [") << formatNumber(color.r) << ", " << formatNumber(color.g) << ", " << formatNumber(color.b) << ", " << formatNumber(color.a) << "]";
+    }
+    json << "], \"stopPositions\": [";
+    for (size_t i = 0; i < request.palette.positions.size(); ++i) {
+        json << (i == 0 ? "" : ", ") << formatNumber(request.palette.positions[i]);
+    }
+    json << "], \"contrast\": " << formatNumber(request.palette.contrast)
+        << ", \"interpolation\": " << quote(interpolationName(request.palette.interpolation))
+        << ", \"repeats\": " << request.palette.repeats
+        << ", \"paletteSize\": " << request.palette.lutSize
+        << ", \"equalize\": " << (request.palette.equalize ? "true" : "false");
+    if (request.supersamples > 1) {
+        json << ", \"supersamples\": " << request.supersamples
+            << ", \"supersampleThreshold\": " << formatNumber(request.supersampleThreshold);
+    }
+    json << ", \"backend\": " << quote(backendName(request.backend))
+        << ", \"fill\": " << quote(fillName(request.fillMode));
+    if (!job.iterationData.empty()) json << ", \"iterationData\": " << quote(job.iterationData);
+    json << "}";
+    return json.str();
+}
+
+RenderJob parseRenderJob(const std::string& text, const std::string& source, const RenderJob& defaults) {
+    JsonReader json(text, source);
+    JsonValue document = json.parseValue();
+    if (!json.atEnd()) json.fail("Expected a single job");
+    return JobReader(source).read(document, defaults);
+}
+
+BatchSummary renderJobs(const std::vector<RenderJob>& jobs, int threadCount, std::ostream& log) {
+    auto batchStart = std::chrono::steady_clock::now();
+    threadCount = resolveThreadCount(threadCount);
+
+    // groups keep the order their equations first appear in
+    std::vector<std::vector<size_t>> groups;
+    std::map<std::string, size_t> groupOfEquation;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        auto [found, inserted] = groupOfEquation.try_emplace(jobs[i].request.equation, groups.size());
+        if (inserted) groups.emplace_back();
+        groups[found->second].push_back(i);
+    }
+
+    BatchSummary summary;
+    std::mutex logMutex;
+
+    for (const std::vector<size_t>& group : groups) {
+        const std::string& equation = jobs[group.front()].request.equation;
+
+        bool withDerivative = false;
+        for (size_t i : group) withDerivative |= jobs[i].request.distanceEstimation;
+
+        std::shared_ptr<const CompiledEquation> compiled;
+        try {
+            compiled = std::make_shared<CompiledEquation>(equation, withDerivative);
+        }
+        catch (const std::exception& e) {
+            for (size_t i : group) log << jobs[i].source << ": " << e.what() << "\n";
+            summary.failed += static_cast<int>(group.size());
+            continue;
+        }
+
+        bool jobPerThread = static_cast<int>(group.size()) >= threadCount;
+        parallelFor(static_cast<int>(group.size()), jobPerThread ? threadCount : 1, [&](int begin, int end) {
+            for (int j = begin; j < end; ++j) {
+                const RenderJob& job = jobs[group[j]];
+                RenderRequest request = job.request;
+                request.compiledEquation = compiled;
+                request.threadCount = jobPerThread ? 1 : threadCount;
+
+                try {
+                    if (isPosterPath(job.output)) {
+                        // batch progress would interleave with the other jobs' lines
+                        RenderJob poster = job;
+                        poster.request = request;
+                        std::ostringstream progress;
+                        PosterSummary written = renderPoster(poster, PosterOptions(), progress);
+
+                        std::lock_guard<std::mutex> lock(logMutex);
+                        ++summary.rendered;
+                        log << job.output << ": " << written.width << "x" << written.height << " in " << written.milliseconds << " ms\n";
+                        if (!written.warning.empty()) log << job.output << ": warning: " << written.warning << "\n";
+                        continue;
+                    }
+
+                    setViewCenter(request, job.centerReal, job.centerImag);
+                    RenderResult result = render(request);
+                    writeImage(job.output, result.width, result.height, result.rgba, request.threadCount);
+                    if (!job.iterationData.empty()) {
+                        writeIterationFile(job.iterationData, result.image, request.iterations, formatRenderJob(job), request.threadCount, rootBasinRadius(request));
+                    }
+
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    ++summary.rendered;
+                    log << job.output << ": " << result.width << "x" << result.height << " in " << result.statistics.renderMilliseconds << " ms\n";
+                    if (!result.warning.empty()) log << job.output << ": warning: " << result.warning << "\n";
+                }
+                catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    ++summary.failed;
+                    log << job.source << ": " << e.what() << "\n";
+                }
+            }
+        });
+    }
+
+    summary.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+    return summary;
+}
@@ -0,0 +1,56 @@
+#ifndef RENDER_JOBS_H
+#define RENDER_JOBS_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "renderCore.h"
+
+// Batches of stills for fractal-render. A job file holds one JSON object per job, either as a
+// single document (an object, an array of objects, or an object with a "jobs" array) or one
+// object per line (JSON Lines). Keys use the GUI's names where it has one:
+//   output                  image path, required
+//   size                    [width, height]
+//   center                  [real, imag], strings keep more digits than a double
+//   zoom                    log2 like --zoom
+//   equation                parsed by ComplexExpressionParser
+//   variables               {"name": [real, imag], ...}
+//   iterations, escapeRadius, periodicity
+//   distance                pixels, turns distance estimation on
+//   colorStops              [[r, g, b], [r, g, b, a], ...], stopPositions [p, ...], contrast
+//   interpolation           linear, smooth or step, repeats, paletteSize
+//   equalize                true colors by the iteration histogram in place of contrast
+//   backend, fill           the names --backend and --fill take
+//   iterationData           path for the raw iteration data as well, see iterationFile.h
+// Keys a job leaves out keep the value from the defaults.
+
+struct RenderJob {
+    RenderRequest request;
+    std::string centerReal = "0";
+    std::string centerImag = "0";
+    std::string output;
+    std::string iterationData; // empty for none
+    std::string source; // file:line of the job, for messages
+};
+
+// throws std::runtime_error with the file and line of the first mistake
+std::vector<RenderJob> readRenderJobs(const std::string& path, const RenderJob& defaults);
+
+// One job as a single line of JSON with every key, so it can be stored with an image and
+// read back by parseRenderJob. The thread count isn't part of a job.
+std::string formatRenderJob(const RenderJob& job);
+RenderJob parseRenderJob(const std::string& text, const std::string& source, const RenderJob& defaults);
+
+struct BatchSummary {
+    int rendered = 0;
+    int failed = 0;
+    double milliseconds = 0.0;
+};
+
+// Renders jobs grouped by equation, every group compiling its equation once. A group with at
+// least as many jobs as threads renders one job per thread, smaller groups render their jobs
+// one at a time with every thread. A failed job is reported to log and the batch carries on.
+BatchSummary renderJobs(const std::vector<RenderJob>& jobs, int threadCount, std::ostream& log);
+
+#endif // RENDER_JOBS_H
@@ -1,59 +1,11 @@
 #include "shader.h"
 
-const char* vertexShaderPath = "shaders/fractalVert.vert";
-const char* fragmentShaderPath = "shaders/fractalFrag.frag";
-
-Shader::Shader() {
-
-	ID = glCreateProgram();
-
-	// Vertex Shader
-
-	std::string vertexShaderCode = readShaderFile(vertexShaderPath);
-	const char* vertexShaderString = vertexShaderCode.c_str();
-	int successVertex;
-	char errorMessageVertex[512];
-
-	unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vertexShaderString, NULL);
-	glCompileShader(vertex);
-
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &successVertex);
-	if (!successVertex) {
-		glGetShaderInfoLog(vertex, 512, nullptr, errorMessageVertex);
-		std::cout << "Vertex\n";
-		std::cout << "Error compiling shader: " << errorMessageVertex << "\n";
-		std::cout << "Shader location: " << vertexShaderPath << "\n";
-	}
-
-	// Fragment Shader
-
-	std::string fragmentShaderCode = readShaderFile(fragmentShaderPath);
-	const char* fragmentShaderString = fragmentShaderCode.c_str();
-	int successFragment;
-	char errorMessageFragment[512];
-
-	unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fragmentShaderString, NULL);
-	glCompileShader(fragment);
-
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &successFragment);
-	if (!successFragment) {
-		glGetShaderInfoLog(fragment, 512, nullptr, errorMessageFragment);
-		std::cout << "Fragment\n";
-		std::cout << "Error compiling shader: " << errorMessageFragment << "\n";
-		std::cout << "Shader location: " << fragmentShaderPath << "\n";
-	}
-
-	// Attach and Delete Shaders
-
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
-
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+#include <iomanip>
+#include <regex>
 
+Shader::Shader(const char* fragmentPath, const char* vertexPath) : fragmentShaderPath(fragmentPath), vertexShaderPath(vertexPath) {
+	ID = compileProgram(readShaderFile(fragmentPath), fragmentShaderPath, vertexShaderPath);
+	boundID = ID;
 }
 
 Shader::~Shader() {
@@ -63,53 +15,57 @@ Shader::~Shader() {
 	}
 }
 
-void Shader::useShader() const {
+void Shader::useShader() {
 	glUseProgram(ID);
+	boundID = ID;
 }
 
+void Shader::useVariant(unsigned int program) {
+	glUseProgram(program);
+	boundID = program;
+}
 
-void Shader::reload(std::vector<std::string> variables, std::string customEquation) {
-	glDeleteProgram(ID);
-	ID = glCreateProgram();
-
-	// Vertex Shader
 
-	std::string vertexShaderCode = readShaderFile(vertexShaderPath);
-	const char* vertexShaderString = vertexShaderCode.c_str();
-	int successVertex;
-	char errorMessageVertex[512];
+void Shader::reload(std::vector<std::string> variables, std::string customEquation, std::string customDerivative, int unrollFactor) {
+	customVariables = std::move(variables);
+	customEquationGLSL = std::move(customEquation);
+	customDerivativeGLSL = std::move(customDerivative);
+	customUnrollFactor = unrollFactor;
 
-	unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vertexShaderString, NULL);
-	glCompileShader(vertex);
-
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &successVertex);
-	if (!successVertex) {
-		glGetShaderInfoLog(vertex, 512, nullptr, errorMessageVertex);
-		std::cout << "Vertex\n";
-		std::cout << "Error compiling shader: " << errorMessageVertex << "\n";
-		std::cout << "Shader location: " << vertexShaderPath << "\n";
+	std::string fragmentShaderCode = buildFragmentSource(ShaderSpecialization());
+	if (fragmentShaderCode.empty()) {
+		return;
 	}
 
-	// Fragment Shader
+	glDeleteProgram(ID);
+	ID = compileProgram(fragmentShaderCode, fragmentShaderPath, vertexShaderPath);
+	boundID = ID;
+}
 
-	std::string fragmentShaderCode = readShaderFile(fragmentShaderPath);
+std::string Shader::buildFragmentSource(const ShaderSpecialization& specialization) const {
+	std::string fragmentShaderCode = readShaderFile(fragmentShaderPath.c_str());
 
 	// find placement uniform positions
 	size_t uniformsPos = fragmentShaderCode.find("// [CUSTOM_UNIFORMS]");
 
 	if (uniformsPos == std::string::npos) {
 		std::cerr << "Error: Shader template missing markers!\n";
-		return;
+		return "";
 	}
 
 	std::stringstream uniforms;
 	std::unordered_set<std::string> definedVars;
 
-	// add variable uniforms
-	for (const auto& var : variables) {
+	// add variable uniforms, specialized ones become constants like the template uniforms below
+	for (const auto& var : customVariables) {
 		if (definedVars.find(var) == definedVars.end()) {
-			uniforms << "uniform vec2 " << var << ";\n";
+			auto constant = specialization.find(var);
+			if (constant != specialization.end()) {
+				uniforms << "const vec2 " << var << " = " << constant->second << ";\n";
+			}
+			else {
+				uniforms << "uniform vec2 " << var << ";\n";
+			}
 			definedVars.insert(var);
 		}
 	}
@@ -117,6 +73,12 @@ void Shader::reload(std::vector<std::string> variables, std::string customEquati
 	size_t uniformsLineEnd = fragmentShaderCode.find('\n', uniformsPos);
 	fragmentShaderCode.replace(uniformsPos, uniformsLineEnd - uniformsPos, uniforms.str());
 
+	// template uniforms like iterations turn into constants of the same type
+	for (const auto& [name, value] : specialization) {
+		std::regex declaration("uniform (\\w+) " + name + ";");
+		fragmentShaderCode = std::regex_replace(fragmentShaderCode, declaration, "const $1 " + name + " = " + value + ";");
+	}
+
 	const std::string beginMarker = "// [BEGIN_CUSTOM_EQUATION]";
 	const std::string endMarker = "// [END_CUSTOM_EQUATION]";
 
@@ -125,7 +87,7 @@ void Shader::reload(std::vector<std::string> variables, std::string customEquati
 
 	if (beginPos == std::string::npos || endPos == std::string::npos) {
 		std::cerr << "Can't find markers\n";
-		return;
+		return "";
 	}
 
 	size_t replaceLength = endPos - beginPos + endMarker.length();
@@ -133,11 +95,62 @@ void Shader::reload(std::vector<std::string> variables, std::string customEquati
 	std::stringstream newEquation;
 	newEquation << beginMarker << "\n"
 		<< "vec2 customEquation(vec2 z, vec2 c) {\n"
-		<< "    return " << customEquation << ";\n"
+		<< "    return " << customEquationGLSL << ";\n"
+		<< "}\n"
+		<< "vec2 customDerivative(vec2 z, vec2 c, vec2 dz, vec2 dc) {\n"
+		<< "    return " << customDerivativeGLSL << ";\n"
+		<< "}\n";
+
+	// written out step by step so z stays a local through the whole block
+	newEquation << "#define UNROLL_FACTOR " << customUnrollFactor << "\n"
+		<< "vec2 iterateUnrolled(vec2 z, vec2 c, inout float peak) {\n";
+	for (int i = 0; i < customUnrollFactor; ++i) {
+		newEquation << "    z = customEquation(z, c); peak = max(peak, dot(z, z));\n";
+	}
+	newEquation << "    return z;\n"
 		<< "}\n"
 		<< endMarker;
 
 	fragmentShaderCode.replace(beginPos, replaceLength, newEquation.str());
+	return fragmentShaderCode;
+}
+
+// identifies the program buildFragmentSource would give without reading the template
+std::string Shader::variantKey(const ShaderSpecialization& specialization) const {
+	std::stringstream key;
+	key << fragmentShaderPath << "\n" << customEquationGLSL << "\n" << customUnrollFactor << "\n";
+	for (const auto& var : customVariables) {
+		key << var << " ";
+	}
+	for (const auto& [name, value] : specialization) {
+		key << "\n" << name << "=" << value;
+	}
+	return key.str();
+}
+
+unsigned int Shader::compileProgram(const std::string& fragmentShaderCode, const std::string& fragmentPath, const std::string& vertexPath) {
+	unsigned int program = glCreateProgram();
+
+	// Vertex Shader
+
+	std::string vertexShaderCode = readShaderFile(vertexPath.c_str());
+	const char* vertexShaderString = vertexShaderCode.c_str();
+	int successVertex;
+	char errorMessageVertex[512];
+
+	unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertex, 1, &vertexShaderString, NULL);
+	glCompileShader(vertex);
+
+	glGetShaderiv(vertex, GL_COMPILE_STATUS, &successVertex);
+	if (!successVertex) {
+		glGetShaderInfoLog(vertex, 512, nullptr, errorMessageVertex);
+		std::cout << "Vertex\n";
+		std::cout << "Error compiling shader: " << errorMessageVertex << "\n";
+		std::cout << "Shader location: " << vertexPath << "\n";
+	}
+
+	// Fragment Shader
 
 	const char* fragmentShaderString = fragmentShaderCode.c_str();
 	int successFragment;
@@ -152,17 +165,29 @@ void Shader::reload(std::vector<std::string> variables, std::string customEquati
 		glGetShaderInfoLog(fragment, 512, nullptr, errorMessageFragment);
 		std::cout << "Fragment\n";
 		std::cout << "Error compiling shader: " << errorMessageFragment << "\n";
-		std::cout << "Shader location: " << fragmentShaderPath << "\n";
+		std::cout << "Shader location: " << fragmentPath << "\n";
 	}
 
 	// Attach and Delete Shaders
 
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glLinkProgram(program);
 
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+
+	return program;
+}
+
+std::string Shader::floatLiteral(double value) {
+	std::ostringstream literal;
+	literal << std::setprecision(9) << value;
+	std::string text = literal.str();
+	if (text.find_first_of(".e") == std::string::npos) {
+		text += ".0";
+	}
+	return text;
 }
 
 std::string Shader::readShaderFile(const char* filePath) {
@@ -182,34 +207,34 @@ std::string Shader::readShaderFile(const char* filePath) {
 
 void Shader::setFloat(const std::string& name, double value) const {
 	
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1f(glGetUniformLocation(boundID, name.c_str()), value);
 }
 
 void Shader::setInt(const std::string& name, int value) const {
 
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1i(glGetUniformLocation(boundID, name.c_str()), value);
 }
 
 void Shader::setVec4(const std::string& name, glm::vec4 vec) const {
 
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), vec.x, vec.y, vec.z, vec.w);
+	glUniform4f(glGetUniformLocation(boundID, name.c_str()), vec.x, vec.y, vec.z, vec.w);
 }
 
 void Shader::setVec2(const std::string& name, glm::vec2 vec) const {
 
-	glUniform2f(glGetUniformLocation(ID, name.c_str()), vec.x, vec.y);
+	glUniform2f(glGetUniformLocation(boundID, name.c_str()), vec.x, vec.y);
 }
 
 void Shader::setVec4Array(const std::string& name, const std::vector<glm::vec4>& values) const {
 	for (size_t i = 0; i < values.size(); ++i) {
 		std::string uniformName = name + "[" + std::to_string(i) + "]";
-		glUniform4f(glGetUniformLocation(ID, uniformName.c_str()), values[i].x, values[i].y, values[i].z, values[i].w);
+		glUniform4f(glGetUniformLocation(boundID, uniformName.c_str()), values[i].x, values[i].y, values[i].z, values[i].w);
 	}
 }
 
 void Shader::setFloatArray(const std::string& name, const std::vector<float>& values) const {
 	for (size_t i = 0; i < values.size(); ++i) {
 		std::string uniformName = name + "[" + std::to_string(i) + "]";
-		glUniform1f(glGetUniformLocation(ID, uniformName.c_str()), values[i]);
+		glUniform1f(glGetUniformLocation(boundID, uniformName.c_str()), values[i]);
 	}
 }
\ No newline at end of file
@@ -6,20 +6,33 @@
 #include <sstream>
 #include <vector>
 #include <unordered_set>
+#include <map>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+// uniform name to the GLSL literal it is baked in as
+using ShaderSpecialization = std::map<std::string, std::string>;
+
 class Shader {
 public:
 
 	unsigned int ID;
-	Shader();
+	Shader(const char* fragmentPath = "shaders/fractalFrag.frag", const char* vertexPath = "shaders/fractalVert.vert");
 	~Shader();
 
-	void useShader() const;
-	void reload(std::vector<std::string> variables, std::string customEquation);
+	void useShader();
+	void reload(std::vector<std::string> variables, std::string customEquation, std::string customDerivative, int unrollFactor = 1);
+
+	// a program built from buildFragmentSource elsewhere, the setters go to it until useShader
+	void useVariant(unsigned int program);
+
+	// the fragment shader of the last reload with the specialized uniforms turned into constants
+	std::string buildFragmentSource(const ShaderSpecialization& specialization) const;
+	std::string variantKey(const ShaderSpecialization& specialization) const;
+	static unsigned int compileProgram(const std::string& fragmentShaderCode, const std::string& fragmentPath, const std::string& vertexPath = "shaders/fractalVert.vert");
+	static std::string floatLiteral(double value);
 
 	void setFloat(const std::string& name, double value) const;
 	void setInt(const std::string& name, int value) const;
@@ -31,5 +44,14 @@ public:
 
 private:
 
-	std::string readShaderFile(const char* filePath);
+	unsigned int boundID = 0;
+	std::string fragmentShaderPath;
+	std::string vertexShaderPath;
+
+	std::vector<std::string> customVariables;
+	std::string customEquationGLSL = "z";
+	std::string customDerivativeGLSL = "dz";
+	int customUnrollFactor = 1;
+
+	static std::string readShaderFile(const char* filePath);
 };
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "shaderVariants.h"
+
+#include <algorithm>
+
+ShaderVariantCache::ShaderVariantCache(GLFWwindow* sharedWith) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    context = glfwCreateWindow(1, 1, "Shader Compiler", nullptr, sharedWith);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    // without a second context every request keeps returning 0 and the generic program is used
+    if (context) {
+        worker = std::thread(&ShaderVariantCache::compileLoop, this);
+    }
+}
+
+ShaderVariantCache::~ShaderVariantCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    for (auto& [key, variant] : variants) {
+        if (variant.program != 0) {
+            glDeleteProgram(variant.program);
+        }
+    }
+    if (context) {
+        glfwDestroyWindow(context);
+    }
+}
+
+unsigned int ShaderVariantCache::request(const Shader& shader, const ShaderSpecialization& specialization) {
+    std::string key = shader.variantKey(specialization);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto found = variants.find(key);
+    if (found != variants.end()) {
+        recentlyUsed.remove(key);
+        recentlyUsed.push_front(key);
+        return found->second.ready ? found->second.program : 0;
+    }
+    if (!context) {
+        return 0;
+    }
+
+    while (variants.size() >= MAX_VARIANTS) {
+        evictOldest();
+    }
+    variants[key] = Variant();
+    recentlyUsed.push_front(key);
+
+    // the template is read here, the driver's compile and link are the slow part
+    lock.unlock();
+    Job job = { key, shader.buildFragmentSource(specialization), "shaders/fractalFrag.frag (specialized)" };
+    lock.lock();
+
+    jobs.push_back(std::move(job));
+    lock.unlock();
+    wake.notify_one();
+    return 0;
+}
+
+// called with the mutex held, a variant still compiling is deleted by the worker once it finishes
+void ShaderVariantCache::evictOldest() {
+    std::string key = recentlyUsed.back();
+    recentlyUsed.pop_back();
+
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const Job& job) { return job.key == key; }), jobs.end());
+
+    auto found = variants.find(key);
+    if (found->second.program != 0) {
+        glDeleteProgram(found->second.program);
+    }
+    variants.erase(found);
+}
+
+void ShaderVariantCache::compileLoop() {
+    glfwMakeContextCurrent(context);
+
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) break;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+
+            // a variant evicted while compiling and requested again is queued twice, the first job fills it in
+            auto found = variants.find(job.key);
+            if (found == variants.end() || found->second.ready) continue;
+        }
+
+        unsigned int program = Shader::compileProgram(job.fragmentSource, job.fragmentPath);
+        int linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+        // the main context may only use the program once this context is done with it
+        glFinish();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = variants.find(job.key);
+        bool filled = found != variants.end() && found->second.ready;
+        if (found == variants.end() || filled || !linked) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+        if (found != variants.end() && !filled) {
+            found->second.program = program;
+            found->second.ready = true;
+        }
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
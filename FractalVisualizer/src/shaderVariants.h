@@ -0,0 +1,61 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include "shader.h"
+
+// Programs of the fractal shader with some uniforms baked in as constants, one per set of values.
+// A worker thread compiles them on a hidden window sharing the main context, so a new variant
+// never stalls a frame: the generic program is drawn until the variant has linked.
+
+class ShaderVariantCache {
+public:
+    // must be called on the main thread, GLFW only creates windows there
+    explicit ShaderVariantCache(GLFWwindow* sharedWith);
+    ~ShaderVariantCache();
+
+    ShaderVariantCache(const ShaderVariantCache&) = delete;
+    ShaderVariantCache& operator=(const ShaderVariantCache&) = delete;
+
+    // the linked program, or 0 while it compiles or when it failed to
+    unsigned int request(const Shader& shader, const ShaderSpecialization& specialization);
+
+private:
+    struct Variant {
+        unsigned int program = 0;
+        bool ready = false;
+    };
+
+    struct Job {
+        std::string key;
+        std::string fragmentSource;
+        std::string fragmentPath;
+    };
+
+    static constexpr size_t MAX_VARIANTS = 16;
+
+    GLFWwindow* context = nullptr;
+    std::thread worker;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::unordered_map<std::string, Variant> variants;
+    std::list<std::string> recentlyUsed; // front is the latest, the back is evicted first
+    bool stopping = false;
+
+    void compileLoop();
+    void evictOldest();
+};
+
+#endif // SHADER_VARIANTS_H
@@ -7,6 +7,10 @@
 #include <array>
 #include "glm/glm.hpp"
 
+#include "frameStatistics.h"
+#include "viewState.h"
+#include "complexParser.h"
+
 #define CONSTANTS_H
 
 extern int OPENGL_WIDTH;
@@ -16,13 +20,27 @@ extern int IMGUI_WIDTH;
 extern int iterations;
 extern float contrast;
 extern float escapeRadius;
+extern int periodicityInterval;
+extern bool distanceEstimation;
+extern float distanceRange;
+extern int unrollFactor; // iterations per escape check in the shader, 0 picks one from the equation cost
+extern bool specializeShader; // bake settled uniforms and constant variables into the shader
+extern int fillMode;
+extern bool exactFinalPass;
 
-extern float zoom;
-extern double centerX;
-extern double centerY;
+extern ViewState view;
 
-extern std::vector<float> stopPositions;
+extern std::vector<float> stopPositions; // one per color stop
 extern std::vector<glm::vec4> colorStops;
+extern int paletteInterpolation; // a PaletteInterpolation
+extern int paletteRepeats;
+extern int paletteSize;
+extern bool equalizeColors; // histogram equalization in place of contrast
+extern double histogramMilliseconds; // GPU time of the last histogram count
+
+// edge-adaptive antialiasing in the shader, sub-samples per side of pixels on an edge, 1 turns it off
+extern int supersampleGrid;
+extern float supersampleThreshold; // smooth iterations between neighbours that make an edge
 
 struct ComplexVariableControl {
     glm::vec2 value = { 0.0f, 0.0f };
@@ -31,4 +49,40 @@ struct ComplexVariableControl {
 
 extern std::unordered_map<std::string, ComplexVariableControl> variableControls;
 
+enum RendererMode {
+    RENDERER_GPU_SHADER = 0,
+    RENDERER_CPU_PERTURBATION = 1,
+    RENDERER_CPU_ESCAPE_TIME = 2,
+    RENDERER_ITERATION_DATA = 3 // a file from fractal-render --iteration-data, colored again
+};
+
+extern int rendererMode;
+extern std::string activeEquation;
+extern EquationTraits activeEquationTraits;
+extern FrameStatistics frameStatistics;
+extern bool collectStatistics;
+extern std::string precisionStatus; // set by main while the renderer can't resolve the view's pixels
+
+// GPU time of every preset at each unroll factor, main runs it when the GUI asks
+struct UnrollBenchmarkResult {
+    std::string equation;
+    int unrollFactor;
+    double milliseconds;
+};
+
+extern bool unrollBenchmarkRequested;
+extern std::vector<UnrollBenchmarkResult> unrollBenchmarkResults;
+
+// main loads iterationDataPath when the GUI asks and says how it went in iterationDataStatus
+extern std::string iterationDataPath;
+extern bool iterationDataRequested;
+extern std::string iterationDataStatus;
+
+// views the GUI collects for fractal-render --path, main saves them to pathFile when asked
+extern std::vector<ViewState> pathWaypoints;
+extern std::string pathFile;
+extern std::string pathVideoFile; // the waypoints' output, the video fractal-render writes without --output
+extern bool pathSaveRequested;
+extern std::string pathSaveStatus;
+
 #endif // !STATE_H
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "supersamplePass.h"
+
+#include "supersampling.h"
+
+namespace {
+
+void setNearest(unsigned int texture) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+}
+
+SupersamplePass::SupersamplePass() {
+    glGenFramebuffers(1, &framebuffer);
+    glGenTextures(1, &subsampleTexture);
+    glGenTextures(1, &pixelTexture);
+    glGenTextures(1, &indexTexture);
+    setNearest(subsampleTexture);
+    setNearest(pixelTexture);
+    setNearest(indexTexture);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+SupersamplePass::~SupersamplePass() {
+    glDeleteTextures(1, &indexTexture);
+    glDeleteTextures(1, &pixelTexture);
+    glDeleteTextures(1, &subsampleTexture);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+void SupersamplePass::run(const Shader& fractalShader, unsigned int iterationTexture, int width, int height, int grid, float threshold, int iterations, unsigned int quadArray) {
+    // the same edges as a headless render of the frame
+    readback.resize(static_cast<size_t>(width) * height);
+    glBindTexture(GL_TEXTURE_2D, iterationTexture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, readback.data());
+    std::vector<int> pixels = findEdgePixels(readback, width, height, iterations, threshold);
+    int count = static_cast<int>(pixels.size());
+    supersampledPixels = count;
+
+    entries.assign(readback.size(), -1);
+    for (int i = 0; i < count; ++i) entries[pixels[i]] = i;
+    glBindTexture(GL_TEXTURE_2D, indexTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, width, height, 0, GL_RED_INTEGER, GL_INT, entries.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (count == 0) return;
+
+    int rows = (count + ROW_ENTRIES - 1) / ROW_ENTRIES;
+    pixelList.assign(static_cast<size_t>(rows) * ROW_ENTRIES * 2, 0);
+    for (int i = 0; i < count; ++i) {
+        pixelList[i * 2] = pixels[i] % width;
+        pixelList[i * 2 + 1] = pixels[i] / width;
+    }
+    glBindTexture(GL_TEXTURE_2D, pixelTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32I, ROW_ENTRIES, rows, 0, GL_RG_INTEGER, GL_INT, pixelList.data());
+
+    // room for the list, kept while it shrinks by less than half so a moving edge doesn't reallocate
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (grid != this->grid || rows > textureRows || rows * 2 < textureRows) {
+        this->grid = grid;
+        textureRows = rows;
+        glBindTexture(GL_TEXTURE_2D, subsampleTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, ROW_ENTRIES * grid, textureRows * grid, 0, GL_RG, GL_FLOAT, nullptr);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, subsampleTexture, 0);
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, ROW_ENTRIES * grid, rows * grid);
+
+    fractalShader.setInt("subsampleGrid", grid);
+    fractalShader.setInt("subsampleCount", count);
+    fractalShader.setInt("subsamplePixels", 4);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, pixelTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(quadArray);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+    // the frame's own iteration pass draws one sample per pixel
+    fractalShader.setInt("subsampleGrid", 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
@@ -0,0 +1,54 @@
+#ifndef SUPERSAMPLE_PASS_H
+#define SUPERSAMPLE_PASS_H
+
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "shader.h"
+
+// Edge-adaptive antialiasing on the GPU, see supersampling.h. The frame's own iteration texture
+// is read back and its edge pixels found with findEdgePixels, then fractalFrag.frag is drawn a
+// second time over a list of them, grid x grid fragments per edge pixel, one per sub-sample, into
+// an RG32F texture only as large as the list. colorFrag.frag looks each pixel up in the index
+// texture and averages the colors of its sub-samples.
+
+class SupersamplePass {
+public:
+    // edge pixels per row of the list, each grid x grid texels of the sub-sample texture
+    static constexpr int ROW_ENTRIES = 1024;
+
+    SupersamplePass();
+    ~SupersamplePass();
+
+    SupersamplePass(const SupersamplePass&) = delete;
+    SupersamplePass& operator=(const SupersamplePass&) = delete;
+
+    // Draws the sub-samples with the program fractalShader has bound, which has every uniform of
+    // the frame's iteration pass set, and quadArray (the full screen quad). The pixel list is
+    // bound to unit 4, framebuffer 0 is bound and the viewport restored afterwards.
+    void run(const Shader& fractalShader, unsigned int iterationTexture, int width, int height, int grid, float threshold, int iterations, unsigned int quadArray);
+
+    unsigned int getSubsampleTexture() const { return subsampleTexture; }
+
+    // R32I, width x height, the pixel's entry in the list or -1 for pixels that weren't supersampled
+    unsigned int getIndexTexture() const { return indexTexture; }
+    int getGrid() const { return grid; }
+
+    int getSupersampledPixels() const { return supersampledPixels; }
+
+private:
+    unsigned int framebuffer = 0;
+    unsigned int subsampleTexture = 0;
+    unsigned int pixelTexture = 0; // RG32I, x and y of each entry
+    unsigned int indexTexture = 0;
+    int textureRows = 0; // rows of entries the sub-sample texture has room for
+    int grid = 0;
+    int supersampledPixels = 0;
+
+    std::vector<float> readback;
+    std::vector<int> pixelList;
+    std::vector<int> entries;
+};
+
+#endif // SUPERSAMPLE_PASS_H
@@ -0,0 +1,110 @@
+#include "supersampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "parallelFor.h"
+
+namespace {
+
+// integer hash of the jitter, hashSample in fractalFrag.frag
+uint32_t hashSample(uint32_t value) {
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return value;
+}
+
+// valueAt(x, y) gives the pixel's smooth iterations
+template <typename ValueAt>
+std::vector<int> findEdges(int width, int height, int iterations, float threshold, int threadCount, const ValueAt& valueAt) {
+    float limit = static_cast<float>(iterations);
+
+    std::vector<char> edge(static_cast<size_t>(width) * height, 0);
+    parallelFor(height, threadCount, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = 0; x < width; ++x) {
+                float value = valueAt(x, y);
+                bool inside = value >= limit;
+                bool found = threshold < 0.0f;
+                for (int dy = -1; dy <= 1 && !found; ++dy) {
+                    int ny = y + dy;
+                    if (ny < 0 || ny >= height) continue;
+                    for (int dx = -1; dx <= 1 && !found; ++dx) {
+                        int nx = x + dx;
+                        if (nx < 0 || nx >= width) continue;
+                        float neighbour = valueAt(nx, ny);
+                        found = (neighbour >= limit) != inside || std::abs(neighbour - value) > threshold;
+                    }
+                }
+                edge[static_cast<size_t>(y) * width + x] = found;
+            }
+        }
+    });
+
+    std::vector<int> pixels;
+    for (size_t i = 0; i < edge.size(); ++i) {
+        if (edge[i]) pixels.push_back(static_cast<int>(i));
+    }
+    return pixels;
+}
+
+}
+
+int subsampleGrid(int samples) {
+    if (samples <= 1) return 1;
+    int grid = static_cast<int>(std::lround(std::sqrt(static_cast<double>(samples))));
+    if (grid * grid != samples || grid > MAX_SUBSAMPLE_GRID) {
+        throw std::runtime_error("Supersamples must be a square from 4 to " + std::to_string(MAX_SUBSAMPLE_GRID * MAX_SUBSAMPLE_GRID));
+    }
+    return grid;
+}
+
+std::vector<int> findEdgePixels(const TiledFramebuffer& image, int iterations, float threshold, int threadCount) {
+    return findEdges(image.getWidth(), image.getHeight(), iterations, threshold, threadCount, [&image](int x, int y) {
+        return image.smoothIterations[image.index(x, y)];
+    });
+}
+
+std::vector<int> findEdgePixels(const std::vector<float>& smoothIterations, int width, int height, int iterations, float threshold, int threadCount) {
+    return findEdges(width, height, iterations, threshold, threadCount, [&smoothIterations, width](int x, int y) {
+        return smoothIterations[static_cast<size_t>(y) * width + x];
+    });
+}
+
+void subsamplePosition(int x, int y, int cellX, int cellY, int grid, double& offsetX, double& offsetY) {
+    uint32_t seed = hashSample(static_cast<uint32_t>(x) + hashSample(static_cast<uint32_t>(y) + hashSample(static_cast<uint32_t>(cellY * grid + cellX))));
+    offsetX = (cellX + (seed & 0xffffu) / 65536.0) / grid;
+    offsetY = (cellY + (seed >> 16) / 65536.0) / grid;
+}
+
+void blendSubsamples(TiledFramebuffer& image, const std::vector<int>& pixels, const std::vector<float>& samples, const std::vector<float>& basins,
+    int grid, int iterations, const Palette& palette, int threadCount) {
+    std::vector<uint32_t> lut = bakePalette(palette);
+    std::vector<float> cumulative;
+    if (palette.equalize) cumulative = countIterations(image, iterations, threadCount).cumulative();
+
+    int width = image.getWidth();
+    int count = grid * grid;
+    const int CHUNK = 256;
+    int chunks = static_cast<int>((pixels.size() + CHUNK - 1) / CHUNK);
+    parallelFor(chunks, threadCount, [&](int begin, int end) {
+        size_t last = std::min(pixels.size(), static_cast<size_t>(end) * CHUNK);
+        for (size_t i = static_cast<size_t>(begin) * CHUNK; i < last; ++i) {
+            uint32_t sum[4] = {};
+            for (int sample = 0; sample < count; ++sample) {
+                size_t at = i * count + sample;
+                uint32_t color = shadeSmoothIterations(samples[at], iterations, palette, lut, &cumulative, basins.empty() ? -1.0f : basins[at]);
+                for (int channel = 0; channel < 4; ++channel) sum[channel] += (color >> (channel * 8)) & 0xffu;
+            }
+
+            uint32_t average = 0;
+            for (int channel = 0; channel < 4; ++channel) average |= ((sum[channel] + count / 2) / count) << (channel * 8);
+            image.colors[image.index(pixels[i] % width, pixels[i] / width)] = average;
+        }
+    });
+}
@@ -0,0 +1,39 @@
+#ifndef SUPERSAMPLING_H
+#define SUPERSAMPLING_H
+
+#include <cstdint>
+#include <vector>
+
+#include "palette.h"
+#include "tiledFramebuffer.h"
+
+// Edge-adaptive antialiasing. A frame is rendered at one sample per pixel first, then only the
+// pixels on an edge, whose smooth iterations differ from one of their eight neighbours by more
+// than a threshold or that are inside the set while a neighbour escapes or the other way around,
+// are iterated again at grid x grid jittered sub-samples, one in each cell of the pixel, and take
+// the average of their colors. fractalFrag.frag's sub-sample pass jitters with the same hash.
+
+constexpr int MAX_SUBSAMPLE_GRID = 8;
+
+// sub-samples per side for samples per pixel, 1 for 0 or 1, throws std::runtime_error unless it is a square
+int subsampleGrid(int samples);
+
+// Pixels on an edge as y * width + x, rows from the bottom, in order. A negative threshold
+// takes every pixel, which is full supersampling.
+std::vector<int> findEdgePixels(const TiledFramebuffer& image, int iterations, float threshold, int threadCount = 0);
+
+// the same for row-major smooth iterations, bottom row first, such as the shader's read back
+std::vector<int> findEdgePixels(const std::vector<float>& smoothIterations, int width, int height, int iterations, float threshold, int threadCount = 0);
+
+// Where sub-sample (cellX, cellY) of pixel (x, y) of the whole image falls, offsetX and offsetY
+// from the pixel's lower left corner, from 0 to 1
+void subsamplePosition(int x, int y, int cellX, int cellY, int grid, double& offsetX, double& offsetY);
+
+// Colors the sub-samples of each pixel, samples[i * grid * grid + cellY * grid + cellX] for pixels[i],
+// and stores their average in image.colors. Equalizing palettes read the histogram of the image's
+// own smooth iterations like colorize. basins holds rootBasin of each sample for converging
+// equations and is empty otherwise.
+void blendSubsamples(TiledFramebuffer& image, const std::vector<int>& pixels, const std::vector<float>& samples, const std::vector<float>& basins,
+    int grid, int iterations, const Palette& palette, int threadCount = 0);
+
+#endif // SUPERSAMPLING_H
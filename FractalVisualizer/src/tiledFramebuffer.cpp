@@ -0,0 +1,112 @@
+#include "tiledFramebuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// spreads the low 16 bits apart so two coordinates interleave into a Morton code
+uint32_t spreadBits(uint32_t value) {
+    value &= 0xffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
+
+} // namespace
+
+TiledFramebuffer::TiledFramebuffer(int width, int height) {
+    resize(width, height);
+}
+
+void TiledFramebuffer::resize(int newWidth, int newHeight) {
+    width = std::max(newWidth, 0);
+    height = std::max(newHeight, 0);
+    tilesX = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+    tilesY = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+
+    // the grid is rarely a power of two, so tiles are sorted by Morton code and numbered in that order
+    std::vector<std::pair<uint32_t, int>> order;
+    order.reserve(static_cast<size_t>(tilesX) * tilesY);
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            order.push_back({ spreadBits(tx) | (spreadBits(ty) << 1), ty * tilesX + tx });
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    slotOfTile.assign(order.size(), 0);
+    tiles.resize(order.size());
+    for (size_t slot = 0; slot < order.size(); ++slot) {
+        int tile = order[slot].second;
+        slotOfTile[tile] = static_cast<int>(slot);
+
+        Tile& bounds = tiles[slot];
+        bounds.x0 = (tile % tilesX) * TILE_SIZE;
+        bounds.y0 = (tile / tilesX) * TILE_SIZE;
+        bounds.width = std::min(TILE_SIZE, width - bounds.x0);
+        bounds.height = std::min(TILE_SIZE, height - bounds.y0);
+    }
+
+    size_t storage = tiles.size() * TILE_PIXELS;
+    smoothIterations.assign(storage, 0.0f);
+    finalReal.assign(storage, 0.0f);
+    finalImag.assign(storage, 0.0f);
+    colors.assign(storage, 0);
+    periodic.assign(storage, 0);
+}
+
+void TiledFramebuffer::readSmoothIterations(std::vector<float>& rowMajor) const {
+    readPlane(smoothIterations, rowMajor);
+}
+
+void TiledFramebuffer::writeSmoothIterations(const std::vector<float>& rowMajor) {
+    writePlane(smoothIterations, rowMajor);
+}
+
+void TiledFramebuffer::readFinalZ(std::vector<float>& realRowMajor, std::vector<float>& imagRowMajor) const {
+    readPlane(finalReal, realRowMajor);
+    readPlane(finalImag, imagRowMajor);
+}
+
+void TiledFramebuffer::writeFinalZ(const std::vector<float>& realRowMajor, const std::vector<float>& imagRowMajor) {
+    writePlane(finalReal, realRowMajor);
+    writePlane(finalImag, imagRowMajor);
+}
+
+void TiledFramebuffer::readPlane(const std::vector<float>& plane, std::vector<float>& rowMajor) const {
+    rowMajor.resize(static_cast<size_t>(width) * height);
+    for (const Tile& tile : tiles) {
+        for (int y = tile.y0; y < tile.y0 + tile.height; ++y) {
+            std::memcpy(&rowMajor[static_cast<size_t>(y) * width + tile.x0], &plane[index(tile.x0, y)], tile.width * sizeof(float));
+        }
+    }
+}
+
+void TiledFramebuffer::writePlane(std::vector<float>& plane, const std::vector<float>& rowMajor) {
+    for (const Tile& tile : tiles) {
+        for (int y = tile.y0; y < tile.y0 + tile.height; ++y) {
+            std::memcpy(&plane[index(tile.x0, y)], &rowMajor[static_cast<size_t>(y) * width + tile.x0], tile.width * sizeof(float));
+        }
+    }
+}
+
+void TiledFramebuffer::readColors(std::vector<uint8_t>& rgba) const {
+    rgba.resize(static_cast<size_t>(width) * height * 4);
+    for (const Tile& tile : tiles) {
+        for (int y = tile.y0; y < tile.y0 + tile.height; ++y) {
+            uint8_t* row = rgba.data() + (static_cast<size_t>(height - 1 - y) * width + tile.x0) * 4;
+            const uint32_t* source = &colors[index(tile.x0, y)];
+            for (int x = 0; x < tile.width; ++x) {
+                uint32_t color = source[x];
+                row[x * 4] = static_cast<uint8_t>(color);
+                row[x * 4 + 1] = static_cast<uint8_t>(color >> 8);
+                row[x * 4 + 2] = static_cast<uint8_t>(color >> 16);
+                row[x * 4 + 3] = static_cast<uint8_t>(color >> 24);
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef TILED_FRAMEBUFFER_H
+#define TILED_FRAMEBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU image layout of 64x64 pixel tiles stored in Morton (Z) order. Every plane, smooth
+// iterations, final z and color, keeps each tile's pixels together, so a kernel working on
+// one tile and the neighbour lookups of the fill modes stay within 16 KB of each plane, and
+// tiles close in the image are close in memory. Rows go bottom up like gl_FragCoord, images
+// are only converted to row-major on output.
+
+class TiledFramebuffer {
+public:
+    static constexpr int TILE_SHIFT = 6;
+    static constexpr int TILE_SIZE = 1 << TILE_SHIFT;
+    static constexpr int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+
+    // the part of the image a tile covers, edge tiles are smaller but keep full size planes
+    struct Tile {
+        int x0 = 0;
+        int y0 = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    TiledFramebuffer() = default;
+    TiledFramebuffer(int width, int height);
+
+    // clears every plane to 0
+    void resize(int width, int height);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // slots count tiles in Morton order, which is also their order in the planes
+    int getTileCount() const { return static_cast<int>(tiles.size()); }
+    const Tile& getTile(int slot) const { return tiles[slot]; }
+
+    size_t index(int x, int y) const {
+        size_t slot = slotOfTile[(y >> TILE_SHIFT) * tilesX + (x >> TILE_SHIFT)];
+        return slot * TILE_PIXELS + ((y & (TILE_SIZE - 1)) << TILE_SHIFT) + (x & (TILE_SIZE - 1));
+    }
+
+    // indexed by index(x, y)
+    std::vector<float> smoothIterations;
+    std::vector<float> finalReal;
+    std::vector<float> finalImag;
+    std::vector<uint32_t> colors; // RGBA8 with red in the lowest byte
+    std::vector<uint8_t> periodic; // 1 where the periodicity check stopped the orbit, filled by the CPU escape time renderer
+
+    // row-major copies for output, bottom row first like the GL_R32F upload
+    void readSmoothIterations(std::vector<float>& rowMajor) const;
+    void writeSmoothIterations(const std::vector<float>& rowMajor);
+    void readFinalZ(std::vector<float>& realRowMajor, std::vector<float>& imagRowMajor) const;
+    void writeFinalZ(const std::vector<float>& realRowMajor, const std::vector<float>& imagRowMajor);
+
+    // RGBA8 with the top row first like image files
+    void readColors(std::vector<uint8_t>& rgba) const;
+
+private:
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    std::vector<int> slotOfTile; // row-major tile grid to Morton slot
+    std::vector<Tile> tiles;
+
+    void readPlane(const std::vector<float>& plane, std::vector<float>& rowMajor) const;
+    void writePlane(std::vector<float>& plane, const std::vector<float>& rowMajor);
+};
+
+#endif // TILED_FRAMEBUFFER_H
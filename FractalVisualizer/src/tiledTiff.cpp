@@ -0,0 +1,385 @@
+#include "tiledTiff.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include "deflate.h"
+
+namespace {
+
+enum Tag : uint16_t {
+    NEW_SUBFILE_TYPE = 254,
+    IMAGE_WIDTH = 256,
+    IMAGE_LENGTH = 257,
+    BITS_PER_SAMPLE = 258,
+    COMPRESSION = 259,
+    PHOTOMETRIC = 262,
+    IMAGE_DESCRIPTION = 270,
+    SAMPLES_PER_PIXEL = 277,
+    PLANAR_CONFIGURATION = 284,
+    PREDICTOR = 317,
+    TILE_WIDTH = 322,
+    TILE_LENGTH = 323,
+    TILE_OFFSETS = 324,
+    TILE_BYTE_COUNTS = 325
+};
+
+enum Type : uint16_t {
+    ASCII = 2,
+    SHORT = 3,
+    LONG = 4,
+    LONG8 = 16
+};
+
+const int TYPE_SIZES[17] = { 0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8, 4, 0, 0, 8 };
+
+const int CHANNELS = 3;
+const uint16_t DEFLATE_COMPRESSION = 8; // Adobe deflate, a zlib stream per tile
+const uint16_t HORIZONTAL_PREDICTOR = 2;
+
+// BigTIFF is always little-endian here, "II"
+void put(std::vector<uint8_t>& buffer, uint64_t position, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) buffer[position + i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint64_t get(const uint8_t* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    return value;
+}
+
+struct Entry {
+    uint16_t tag;
+    uint16_t type;
+    uint64_t count;
+    uint64_t value; // inline when count values fit in 8 bytes, an offset otherwise
+};
+
+} // namespace
+
+void TiledTiff::create(const std::string& path, int width, int height, int tileSize, int levelCount, const std::string& description) {
+    if (width <= 0 || height <= 0 || tileSize <= 0 || tileSize % 16 != 0 || levelCount < 1) {
+        throw std::runtime_error("Bad TIFF layout for " + path);
+    }
+    this->path = path;
+    this->tileSize = tileSize;
+    this->description = description;
+    levels.assign(levelCount, Level());
+    pending.clear();
+
+    for (int level = 0; level < levelCount; ++level) {
+        Level& current = levels[level];
+        current.width = level == 0 ? width : (levels[level - 1].width + 1) / 2;
+        current.height = level == 0 ? height : (levels[level - 1].height + 1) / 2;
+        current.tilesAcross = (current.width + tileSize - 1) / tileSize;
+        current.tilesDown = (current.height + tileSize - 1) / tileSize;
+        current.offsets.assign(static_cast<size_t>(current.tilesAcross) * current.tilesDown, 0);
+        current.counts.assign(current.offsets.size(), 0);
+    }
+
+    // lay out the header, every IFD and its out of line arrays before writing any of it
+    std::vector<std::vector<Entry>> directories(levelCount);
+    std::vector<uint64_t> directoryPositions(levelCount);
+    uint64_t position = 16;
+    uint64_t descriptionPosition = 0;
+    for (int level = 0; level < levelCount; ++level) {
+        const Level& current = levels[level];
+        uint64_t tiles = current.offsets.size();
+        std::vector<Entry>& entries = directories[level];
+        entries = {
+            { NEW_SUBFILE_TYPE, LONG, 1, level == 0 ? 0u : 1u },
+            { IMAGE_WIDTH, LONG, 1, static_cast<uint64_t>(current.width) },
+            { IMAGE_LENGTH, LONG, 1, static_cast<uint64_t>(current.height) },
+            { BITS_PER_SAMPLE, SHORT, CHANNELS, 8 | (8 << 16) | (8ull << 32) },
+            { COMPRESSION, SHORT, 1, DEFLATE_COMPRESSION },
+            { PHOTOMETRIC, SHORT, 1, 2 } // RGB
+        };
+        if (level == 0) entries.push_back({ IMAGE_DESCRIPTION, ASCII, description.size() + 1, 0 });
+        entries.push_back({ SAMPLES_PER_PIXEL, SHORT, 1, CHANNELS });
+        entries.push_back({ PLANAR_CONFIGURATION, SHORT, 1, 1 }); // interleaved
+        entries.push_back({ PREDICTOR, SHORT, 1, HORIZONTAL_PREDICTOR });
+        entries.push_back({ TILE_WIDTH, LONG, 1, static_cast<uint64_t>(tileSize) });
+        entries.push_back({ TILE_LENGTH, LONG, 1, static_cast<uint64_t>(tileSize) });
+        entries.push_back({ TILE_OFFSETS, LONG8, tiles, 0 });
+        entries.push_back({ TILE_BYTE_COUNTS, LONG8, tiles, 0 });
+
+        directoryPositions[level] = position;
+        position += 8 + entries.size() * 20 + 8;
+
+        // a lone tile's offset and count sit in the entries themselves
+        uint64_t entriesStart = directoryPositions[level] + 8;
+        size_t offsetsEntry = entries.size() - 2;
+        if (tiles == 1) {
+            levels[level].offsetsPosition = entriesStart + offsetsEntry * 20 + 12;
+            levels[level].countsPosition = entriesStart + (offsetsEntry + 1) * 20 + 12;
+        }
+        else {
+            levels[level].offsetsPosition = position;
+            position += tiles * 8;
+            levels[level].countsPosition = position;
+            position += tiles * 8;
+            entries[offsetsEntry].value = levels[level].offsetsPosition;
+            entries[offsetsEntry + 1].value = levels[level].countsPosition;
+        }
+
+        if (level == 0 && description.size() + 1 > 8) {
+            descriptionPosition = position;
+            position += description.size() + 1;
+            for (Entry& entry : entries) {
+                if (entry.tag == IMAGE_DESCRIPTION) entry.value = descriptionPosition;
+            }
+        }
+        position = (position + 7) & ~7ull;
+    }
+
+    std::vector<uint8_t> head(position, 0);
+    head[0] = 'I';
+    head[1] = 'I';
+    put(head, 2, 43, 2);
+    put(head, 4, 8, 2); // offsets are 8 bytes
+    put(head, 8, directoryPositions[0], 8);
+
+    for (int level = 0; level < levelCount; ++level) {
+        uint64_t at = directoryPositions[level];
+        put(head, at, directories[level].size(), 8);
+        at += 8;
+        for (const Entry& entry : directories[level]) {
+            put(head, at, entry.tag, 2);
+            put(head, at + 2, entry.type, 2);
+            put(head, at + 4, entry.count, 8);
+            put(head, at + 12, entry.value, 8);
+            at += 20;
+        }
+        put(head, at, level + 1 < levelCount ? directoryPositions[level + 1] : 0, 8);
+    }
+    if (description.size() + 1 > 8) {
+        std::memcpy(head.data() + descriptionPosition, description.data(), description.size());
+    }
+    else {
+        // short enough to sit in the entry
+        uint64_t entryPosition = directoryPositions[0] + 8 + 6 * 20;
+        std::memcpy(head.data() + entryPosition + 12, description.data(), description.size());
+    }
+
+    file.close();
+    file.clear();
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    file.write(reinterpret_cast<const char*>(head.data()), head.size());
+    file.flush();
+    if (!file) fail("Can't write");
+    end = head.size();
+}
+
+void TiledTiff::open(const std::string& path) {
+    this->path = path;
+    levels.clear();
+    pending.clear();
+
+    file.close();
+    file.clear();
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+
+    auto readAt = [&](uint64_t position, void* data, size_t length) {
+        file.seekg(static_cast<std::streamoff>(position));
+        file.read(static_cast<char*>(data), static_cast<std::streamsize>(length));
+        if (!file) fail("Is cut short");
+    };
+
+    uint8_t header[16];
+    readAt(0, header, sizeof(header));
+    if (header[0] != 'I' || header[1] != 'I' || get(header + 2, 2) != 43 || get(header + 4, 2) != 8) {
+        fail("Isn't a little-endian BigTIFF");
+    }
+
+    // the end of everything create laid out, tiles come after it
+    end = 16;
+    uint64_t directory = get(header + 8, 8);
+    while (directory != 0) {
+        if (levels.size() > 64) fail("Has too many images");
+
+        uint8_t countBytes[8];
+        readAt(directory, countBytes, 8);
+        uint64_t entryCount = get(countBytes, 8);
+        if (entryCount > 1000) fail("Has a damaged IFD");
+        std::vector<uint8_t> entries(entryCount * 20 + 8);
+        readAt(directory + 8, entries.data(), entries.size());
+        end = std::max(end, directory + 8 + entries.size());
+
+        Level level;
+        int compression = 0;
+        int samples = 0;
+        int predictor = 0;
+        int tileWidth = 0;
+        int tileLength = 0;
+        uint64_t tiles = 0;
+        for (uint64_t i = 0; i < entryCount; ++i) {
+            const uint8_t* entry = entries.data() + i * 20;
+            uint16_t tag = static_cast<uint16_t>(get(entry, 2));
+            uint16_t type = static_cast<uint16_t>(get(entry + 2, 2));
+            uint64_t count = get(entry + 4, 8);
+            int size = type < 17 ? TYPE_SIZES[type] : 0;
+            bool inlined = size > 0 && count * size <= 8;
+            uint64_t valuePosition = inlined ? directory + 8 + i * 20 + 12 : get(entry + 12, 8);
+            uint64_t value = size > 0 && size <= 8 ? get(entry + 12, size) : 0;
+            if (!inlined) end = std::max(end, valuePosition + count * size);
+
+            switch (tag) {
+                case IMAGE_WIDTH: level.width = static_cast<int>(value); break;
+                case IMAGE_LENGTH: level.height = static_cast<int>(value); break;
+                case COMPRESSION: compression = static_cast<int>(value); break;
+                case SAMPLES_PER_PIXEL: samples = static_cast<int>(value); break;
+                case PREDICTOR: predictor = static_cast<int>(value); break;
+                case TILE_WIDTH: tileWidth = static_cast<int>(value); break;
+                case TILE_LENGTH: tileLength = static_cast<int>(value); break;
+                case IMAGE_DESCRIPTION:
+                    if (levels.empty()) {
+                        std::string text(count, '\0');
+                        readAt(valuePosition, text.data(), count);
+                        description = text.substr(0, text.find('\0'));
+                    }
+                    break;
+                case TILE_OFFSETS:
+                case TILE_BYTE_COUNTS:
+                    if (type != LONG8) fail("Has a tile table that isn't 64 bit");
+                    tiles = count;
+                    (tag == TILE_OFFSETS ? level.offsetsPosition : level.countsPosition) = valuePosition;
+                    break;
+            }
+        }
+
+        if (compression != DEFLATE_COMPRESSION || samples != CHANNELS || predictor != HORIZONTAL_PREDICTOR || tileWidth != tileLength || tileWidth <= 0) {
+            fail("Wasn't written by fractal-render");
+        }
+        if (levels.empty()) tileSize = tileWidth;
+        if (tileWidth != tileSize || level.width <= 0 || level.height <= 0) fail("Has images with different tiles");
+
+        level.tilesAcross = (level.width + tileSize - 1) / tileSize;
+        level.tilesDown = (level.height + tileSize - 1) / tileSize;
+        if (tiles != static_cast<uint64_t>(level.tilesAcross) * level.tilesDown) fail("Has a tile table of the wrong size");
+        level.offsets.resize(tiles);
+        level.counts.resize(tiles);
+        readAt(level.offsetsPosition, level.offsets.data(), tiles * 8);
+        readAt(level.countsPosition, level.counts.data(), tiles * 8);
+        for (size_t tile = 0; tile < tiles; ++tile) {
+            level.offsets[tile] = get(reinterpret_cast<const uint8_t*>(&level.offsets[tile]), 8);
+            level.counts[tile] = get(reinterpret_cast<const uint8_t*>(&level.counts[tile]), 8);
+        }
+        levels.push_back(level);
+
+        readAt(directory + 8 + entryCount * 20, countBytes, 8);
+        directory = get(countBytes, 8);
+    }
+    if (levels.empty()) fail("Has no images");
+
+    // anything past the last tile with a table entry was cut off mid batch, and is dropped
+    end = (end + 7) & ~7ull;
+    for (const Level& level : levels) {
+        for (size_t tile = 0; tile < level.offsets.size(); ++tile) {
+            if (level.counts[tile] > 0) end = std::max(end, level.offsets[tile] + level.counts[tile]);
+        }
+    }
+    file.close();
+    std::filesystem::resize_file(path, end);
+    file.clear();
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+}
+
+bool TiledTiff::hasTile(int level, int tileX, int tileY) const {
+    const Level& current = levels[level];
+    return current.counts[static_cast<size_t>(tileY) * current.tilesAcross + tileX] > 0;
+}
+
+std::vector<uint8_t> TiledTiff::encodeTile(const uint8_t* rgb) const {
+    // horizontal differencing, each sample minus the same sample of the pixel to its left
+    size_t rowBytes = static_cast<size_t>(tileSize) * CHANNELS;
+    std::vector<uint8_t> predicted(rowBytes * tileSize);
+    for (int y = 0; y < tileSize; ++y) {
+        const uint8_t* row = rgb + y * rowBytes;
+        uint8_t* out = predicted.data() + y * rowBytes;
+        std::memcpy(out, row, CHANNELS);
+        for (size_t i = CHANNELS; i < rowBytes; ++i) out[i] = static_cast<uint8_t>(row[i] - row[i - CHANNELS]);
+    }
+
+    // zlib header, deflate data, adler32 big-endian
+    std::vector<uint8_t> encoded = { 0x78, 0x5e };
+    deflatePiece(predicted.data(), 0, predicted.size(), true, encoded);
+    uint32_t adler = adler32(1, predicted.data(), predicted.size());
+    for (int shift = 24; shift >= 0; shift -= 8) encoded.push_back(static_cast<uint8_t>(adler >> shift));
+    return encoded;
+}
+
+void TiledTiff::writeTile(int level, int tileX, int tileY, const std::vector<uint8_t>& encoded) {
+    Level& current = levels[level];
+    int tile = tileY * current.tilesAcross + tileX;
+
+    file.seekp(static_cast<std::streamoff>(end));
+    file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+    if (!file) fail("Can't write");
+
+    current.offsets[tile] = end;
+    current.counts[tile] = encoded.size();
+    pending.push_back({ level, tile });
+    end += encoded.size();
+}
+
+void TiledTiff::commit() {
+    file.flush();
+
+    // offsets first, a tile only counts as written once its byte count is set
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const PendingEntry& entry : pending) {
+            const Level& level = levels[entry.level];
+            uint64_t value = pass == 0 ? level.offsets[entry.tile] : level.counts[entry.tile];
+            std::vector<uint8_t> bytes(8);
+            put(bytes, 0, value, 8);
+            file.seekp(static_cast<std::streamoff>((pass == 0 ? level.offsetsPosition : level.countsPosition) + entry.tile * 8ull));
+            file.write(reinterpret_cast<const char*>(bytes.data()), 8);
+        }
+        file.flush();
+    }
+    if (!file) fail("Can't write");
+    pending.clear();
+}
+
+void TiledTiff::readTile(int level, int tileX, int tileY, std::vector<uint8_t>& rgb) {
+    const Level& current = levels[level];
+    size_t tile = static_cast<size_t>(tileY) * current.tilesAcross + tileX;
+    std::vector<uint8_t> encoded(current.counts[tile]);
+    if (encoded.size() < 6) fail("Has a damaged tile");
+
+    file.seekg(static_cast<std::streamoff>(current.offsets[tile]));
+    file.read(reinterpret_cast<char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+    if (!file) fail("Is cut short");
+
+    rgb.clear();
+    inflate(encoded.data() + 2, encoded.size() - 6, rgb);
+    size_t rowBytes = static_cast<size_t>(tileSize) * CHANNELS;
+    uint32_t stored = 0;
+    for (int i = 0; i < 4; ++i) stored = (stored << 8) | encoded[encoded.size() - 4 + i];
+    if (rgb.size() != rowBytes * tileSize || adler32(1, rgb.data(), rgb.size()) != stored) fail("Has a damaged tile");
+
+    for (int y = 0; y < tileSize; ++y) {
+        uint8_t* row = rgb.data() + y * rowBytes;
+        for (size_t i = CHANNELS; i < rowBytes; ++i) row[i] = static_cast<uint8_t>(row[i] + row[i - CHANNELS]);
+    }
+}
+
+void TiledTiff::close() {
+    commit();
+    file.close();
+}
+
+void TiledTiff::fail(const std::string& message) const {
+    throw std::runtime_error(path + ": " + message);
+}
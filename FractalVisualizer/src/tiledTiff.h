@@ -0,0 +1,77 @@
+#ifndef TILED_TIFF_H
+#define TILED_TIFF_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Tiled RGB BigTIFF for images larger than memory, written tile by tile in any order. Tiles are
+// deflated with the horizontal predictor, and every level after the first is a reduced
+// resolution copy (NewSubfileType 1), the pyramid viewers like GDAL and libvips read as
+// overviews. The IFDs and their tile tables are written up front, and a tile's table entry is
+// only filled in once its data is flushed, so a file cut short by a crash still says which
+// tiles it holds and the render can carry on from it.
+
+class TiledTiff {
+public:
+    // Creates path, replacing any file there. Each level is half the size of the one before,
+    // rounded up, and the description is stored with the image (ImageDescription).
+    void create(const std::string& path, int width, int height, int tileSize, int levelCount, const std::string& description);
+
+    // opens a file create wrote to add the missing tiles, throws std::runtime_error for anything else
+    void open(const std::string& path);
+
+    int getWidth(int level = 0) const { return levels[level].width; }
+    int getHeight(int level = 0) const { return levels[level].height; }
+    int getTilesAcross(int level) const { return levels[level].tilesAcross; }
+    int getTilesDown(int level) const { return levels[level].tilesDown; }
+    int getTileSize() const { return tileSize; }
+    int getLevelCount() const { return static_cast<int>(levels.size()); }
+    const std::string& getDescription() const { return description; }
+
+    bool hasTile(int level, int tileX, int tileY) const;
+
+    // rgb is tileSize x tileSize pixels, top row first. Safe to call from several threads at once.
+    std::vector<uint8_t> encodeTile(const uint8_t* rgb) const;
+
+    // appends an encoded tile, its table entry is written by the next commit
+    void writeTile(int level, int tileX, int tileY, const std::vector<uint8_t>& encoded);
+
+    // flushes the tile data written so far and only then the table entries that point to it
+    void commit();
+
+    // decodes a tile that was written before, into tileSize x tileSize rgb pixels
+    void readTile(int level, int tileX, int tileY, std::vector<uint8_t>& rgb);
+
+    void close();
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        int tilesAcross = 0;
+        int tilesDown = 0;
+        uint64_t offsetsPosition = 0; // where the TileOffsets and TileByteCounts arrays start
+        uint64_t countsPosition = 0;
+        std::vector<uint64_t> offsets;
+        std::vector<uint64_t> counts;
+    };
+
+    struct PendingEntry {
+        int level;
+        int tile;
+    };
+
+    std::fstream file;
+    std::string path;
+    int tileSize = 0;
+    std::string description;
+    std::vector<Level> levels;
+    std::vector<PendingEntry> pending;
+    uint64_t end = 0; // where the next tile goes
+
+    void fail(const std::string& message) const;
+};
+
+#endif // TILED_TIFF_H
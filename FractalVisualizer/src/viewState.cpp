@@ -0,0 +1,39 @@
+#include "viewState.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define MIN_LOG_ZOOM -20000.0
+#define MAX_LOG_ZOOM 3.321928 // zoom of 10
+
+FloatExp ViewState::getZoom() const {
+    double whole = std::floor(logZoom);
+    return FloatExp(std::exp2(logZoom - whole), static_cast<int>(whole));
+}
+
+void ViewState::setLogZoom(double value) {
+    logZoom = std::clamp(value, MIN_LOG_ZOOM, MAX_LOG_ZOOM);
+
+    // precision only ever grows, zooming back out keeps the extra limbs
+    int limbs = requiredFractionalLimbs(8192);
+    centerX.reservePrecision(limbs);
+    centerY.reservePrecision(limbs);
+}
+
+void ViewState::pan(double spanFractionX, double spanFractionY) {
+    FloatExp zoom = getZoom();
+    centerX.add(FloatExp(spanFractionX) * zoom);
+    centerY.add(FloatExp(spanFractionY) * zoom);
+}
+
+void ViewState::reset() {
+    centerX = BigFixed();
+    centerY = BigFixed();
+    logZoom = 0.0;
+}
+
+int ViewState::requiredFractionalLimbs(int pixels) const {
+    // bits of one pixel plus a 32 bit guard, at least the 64 bits of the old double center
+    double bits = -logZoom + std::log2(std::max(pixels, 1)) + 32.0;
+    return std::max(2, static_cast<int>(std::ceil(bits / 32.0)));
+}
@@ -0,0 +1,27 @@
+#ifndef VIEW_STATE_H
+#define VIEW_STATE_H
+
+#include "bigFixed.h"
+#include "floatExp.h"
+
+// Where the fractal is looked at. The center is arbitrary precision and zoom is kept
+// as log2, so deep views are never quantized by a float or double.
+
+struct ViewState {
+    BigFixed centerX;
+    BigFixed centerY;
+    double logZoom = 0.0;
+
+    FloatExp getZoom() const;
+    void setLogZoom(double value);
+
+    // moves the center by a fraction of the view span, in place
+    void pan(double spanFractionX, double spanFractionY);
+
+    void reset();
+
+    // fractional limbs needed to address a single pixel of a frame this big at the current zoom
+    int requiredFractionalLimbs(int pixels) const;
+};
+
+#endif // VIEW_STATE_H
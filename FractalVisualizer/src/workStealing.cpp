@@ -0,0 +1,293 @@
+#include "workStealing.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// a range that has run this long without splitting hands its back half to the deque
+constexpr auto SPLIT_INTERVAL = std::chrono::microseconds(500);
+
+// indices a range runs between reading the clock and taking them off the remaining count
+constexpr int PROGRESS_BLOCK = 64;
+
+// set on pool threads, and on the caller while its job runs, so nested calls run inline
+thread_local bool insideJob = false;
+
+uint64_t packRange(int begin, int end) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(begin)) << 32) | static_cast<uint32_t>(end);
+}
+
+void unpackRange(uint64_t range, int& begin, int& end) {
+    begin = static_cast<int>(range >> 32);
+    end = static_cast<int>(range & 0xffffffffu);
+}
+
+void pinToCore(int core) {
+    int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    core %= cores;
+#if defined(_WIN32)
+    if (core < 64) {
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+    }
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+
+} // namespace
+
+bool ChaseLevDeque::push(uint64_t item) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= CAPACITY) {
+        return false;
+    }
+    buffer[b % CAPACITY].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ChaseLevDeque::take(uint64_t& item) {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    item = buffer[b % CAPACITY].load(std::memory_order_relaxed);
+    if (t == b) {
+        // the last item, a thief may be after it too
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool ChaseLevDeque::steal(uint64_t& item) {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return false;
+    }
+
+    item = buffer[t % CAPACITY].load(std::memory_order_relaxed);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+void ChaseLevDeque::reset() {
+    top.store(0, std::memory_order_relaxed);
+    bottom.store(0, std::memory_order_relaxed);
+}
+
+WorkStealingPool& WorkStealingPool::instance() {
+    static WorkStealingPool pool;
+    return pool;
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::ensureWorkers(int count) {
+    while (static_cast<int>(deques.size()) < count) {
+        deques.push_back(std::make_unique<ChaseLevDeque>());
+    }
+    while (static_cast<int>(workers.size()) < count - 1) {
+        int index = static_cast<int>(workers.size()) + 1;
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, index);
+    }
+}
+
+void WorkStealingPool::run(int count, int threadCount, RangeFunction rangeFunction, void* rangeContext) {
+    if (count <= 0) {
+        return;
+    }
+    if (threadCount <= 1 || count == 1 || insideJob) {
+        rangeFunction(rangeContext, 0, count);
+        return;
+    }
+    threadCount = std::min(threadCount, count);
+
+    std::lock_guard<std::mutex> runLock(runMutex);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ensureWorkers(threadCount);
+
+        function = rangeFunction;
+        context = rangeContext;
+        participants = threadCount;
+        remaining.store(count, std::memory_order_relaxed);
+        idle.store(0, std::memory_order_relaxed);
+        error = nullptr;
+
+        // the same contiguous split as before to start with, stealing evens it out from there
+        int chunk = (count + threadCount - 1) / threadCount;
+        for (int t = 0; t < threadCount; ++t) {
+            deques[t]->reset();
+            int begin = t * chunk;
+            int end = std::min(count, begin + chunk);
+            if (begin < end) {
+                deques[t]->push(packRange(begin, end));
+            }
+        }
+
+        activeWorkers = threadCount - 1;
+        ++generation;
+    }
+    wake.notify_all();
+
+    insideJob = true;
+    work(0);
+    insideJob = false;
+
+    // the function and its context live on the caller's stack, every worker has to be out first
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return activeWorkers == 0; });
+    function = nullptr;
+    context = nullptr;
+
+    if (error) {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+void WorkStealingPool::workerLoop(int index) {
+    insideJob = true;
+    if (pinning) {
+        pinToCore(index);
+    }
+
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) break;
+            seen = generation;
+            if (index >= participants) continue;
+        }
+
+        work(index);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --activeWorkers;
+        }
+        finished.notify_one();
+    }
+}
+
+void WorkStealingPool::work(int index) {
+    ChaseLevDeque& own = *deques[index];
+    uint64_t range;
+
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (own.take(range)) {
+            runRange(index, range);
+            continue;
+        }
+
+        idle.fetch_add(1, std::memory_order_relaxed);
+        bool stolen = false;
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (stealFromOthers(index, range)) {
+                stolen = true;
+                break;
+            }
+            std::this_thread::yield();
+        }
+        idle.fetch_sub(1, std::memory_order_relaxed);
+
+        if (stolen) {
+            runRange(index, range);
+        }
+    }
+}
+
+void WorkStealingPool::runRange(int index, uint64_t range) {
+    ChaseLevDeque& own = *deques[index];
+    int begin, end;
+    unpackRange(range, begin, end);
+    auto lastSplit = std::chrono::steady_clock::now();
+    int unpublished = 0;
+
+    while (begin < end) {
+        // split lazily, only once somebody could use the other half, the clock is read once per block
+        if (end - begin >= 2) {
+            bool wanted = idle.load(std::memory_order_relaxed) > 0;
+            if (wanted || unpublished == 0) {
+                auto now = std::chrono::steady_clock::now();
+                if (wanted || now - lastSplit > SPLIT_INTERVAL) {
+                    int middle = begin + (end - begin) / 2;
+                    if (own.push(packRange(middle, end))) {
+                        end = middle;
+                    }
+                    lastSplit = now;
+                }
+            }
+        }
+
+        try {
+            function(context, begin, begin + 1);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+        ++begin;
+        if (++unpublished == PROGRESS_BLOCK) {
+            remaining.fetch_sub(unpublished, std::memory_order_release);
+            unpublished = 0;
+        }
+    }
+    if (unpublished > 0) {
+        remaining.fetch_sub(unpublished, std::memory_order_release);
+    }
+}
+
+bool WorkStealingPool::stealFromOthers(int index, uint64_t& range) {
+    // a different first victim per attempt keeps thieves from piling onto the same deque
+    thread_local uint32_t state = 0x9e3779b9u * static_cast<uint32_t>(index + 1);
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    int start = static_cast<int>(state % static_cast<uint32_t>(participants));
+    for (int i = 0; i < participants; ++i) {
+        int victim = (start + i) % participants;
+        if (victim != index && deques[victim]->steal(range)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,87 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing scheduler behind parallelFor. Every participating thread owns a Chase-Lev deque
+// of index ranges: the owner takes from the bottom, idle threads steal the oldest range from the
+// top of someone else's. A range being worked on gives its back half away to its owner's deque
+// as soon as a thread is idle or it has run long, so a few expensive interior tiles don't leave
+// the other cores waiting. Workers persist between calls and are pinned to one core each.
+
+// Lock-free deque of one owner and many thieves (Chase and Lev, with the C11 orderings of
+// Le et al. 2013). Fixed capacity, a push that doesn't fit returns false and the work stays
+// with the owner.
+class ChaseLevDeque {
+public:
+    static constexpr int CAPACITY = 1024;
+
+    // owner only
+    bool push(uint64_t item);
+    bool take(uint64_t& item);
+    void reset();
+
+    // any thread
+    bool steal(uint64_t& item);
+
+private:
+    alignas(64) std::atomic<int64_t> top = 0;
+    alignas(64) std::atomic<int64_t> bottom = 0;
+    std::atomic<uint64_t> buffer[CAPACITY] = {};
+};
+
+class WorkStealingPool {
+public:
+    using RangeFunction = void (*)(void* context, int begin, int end);
+
+    static WorkStealingPool& instance();
+
+    ~WorkStealingPool();
+
+    // Calls function on every index of [0, count) with threadCount threads including the caller,
+    // one index per call. Calls from inside a job, or with one thread, run inline on the caller.
+    // Concurrent callers take turns. The first exception thrown is rethrown here.
+    void run(int count, int threadCount, RangeFunction function, void* context);
+
+    // pins worker threads created from now on, the calling thread is never pinned
+    void setPinning(bool enabled) { pinning.store(enabled); }
+
+private:
+    WorkStealingPool() = default;
+
+    std::mutex runMutex; // one job at a time
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<ChaseLevDeque>> deques; // index 0 belongs to the caller
+    uint64_t generation = 0;
+    int activeWorkers = 0;
+    bool stopping = false;
+    std::atomic<bool> pinning = true;
+
+    // the current job
+    RangeFunction function = nullptr;
+    void* context = nullptr;
+    int participants = 0;
+    std::atomic<int> remaining = 0;
+    std::atomic<int> idle = 0;
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    void ensureWorkers(int count);
+    void workerLoop(int index);
+    void work(int index);
+    void runRange(int index, uint64_t range);
+    bool stealFromOthers(int index, uint64_t& range);
+};
+
+#endif // WORK_STEALING_H
@@ -0,0 +1,581 @@
+#include "zoomVideo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "frameWriter.h"
+#include "parallelFor.h"
+#include "perturbation.h"
+
+namespace {
+
+const int BAND_ROWS = 256;
+const double TWO_PI = 6.283185307179586;
+
+FloatExp fromLog2(double log2Value) {
+    double whole = std::floor(log2Value);
+    return FloatExp(std::exp2(log2Value - whole), static_cast<int>(whole));
+}
+
+// row-major samples, final z only kept when the frames color root basins
+struct Samples {
+    std::vector<float> smooth;
+    std::vector<float> real;
+    std::vector<float> imag;
+
+    void resize(size_t count, bool finalZ) {
+        smooth.resize(count);
+        real.resize(finalZ ? count : 0);
+        imag.resize(finalZ ? count : 0);
+    }
+
+    // final z of sample from is the nearest one to index
+    void take(size_t index, float value, const Samples& from, size_t sample) {
+        smooth[index] = value;
+        if (real.empty()) return;
+        real[index] = from.real[sample];
+        imag[index] = from.imag[sample];
+    }
+};
+
+// The exponential map of the whole zoom, with only the bands the current frame reads in memory
+class Strip {
+public:
+    Strip(const RenderRequest& request, int width, double outerLog2, int rows, bool finalZ)
+        : request(request), width(width), outerLog2(outerLog2), rowOctaves(TWO_PI / width / std::log(2.0)), rows(rows),
+          finalZ(finalZ), cosines(width), sines(width), rowData(rows, nullptr) {
+        for (int x = 0; x < width; ++x) {
+            double angle = TWO_PI * (x + 0.5) / width;
+            cosines[x] = std::cos(angle);
+            sines[x] = std::sin(angle);
+        }
+    }
+
+    int getWidth() const { return width; }
+    int getRows() const { return rows; }
+    double getRenderedPoints() const { return renderedPoints; }
+
+    // log2 of the distance from the center, and the other way around
+    double rowLog2(double row) const { return outerLog2 - (row + 0.5) * rowOctaves; }
+    double rowAt(double log2Radius) const { return (outerLog2 - log2Radius) / rowOctaves - 0.5; }
+
+    // renders the bands holding rows first to last that are missing, and drops the bands above
+    void require(int first, int last) {
+        first = std::clamp(first, 0, rows - 1);
+        last = std::clamp(last, 0, rows - 1);
+        for (auto band = bands.begin(); band != bands.end() && band->first < first / BAND_ROWS; ) {
+            setRows(band->first, nullptr);
+            band = bands.erase(band);
+        }
+        for (int band = first / BAND_ROWS; band <= last / BAND_ROWS; ++band) {
+            if (bands.count(band)) continue;
+            renderBand(band, bands[band]);
+            setRows(band, &bands[band]);
+        }
+    }
+
+    // x wraps around, y must be a row of a band require kept
+    float at(int x, int y) const {
+        return rowData[y]->smooth[offset(x, y)];
+    }
+
+    void finalZAt(int x, int y, float& real, float& imag) const {
+        size_t sample = offset(x, y);
+        real = finalZ ? rowData[y]->real[sample] : 0.0f;
+        imag = finalZ ? rowData[y]->imag[sample] : 0.0f;
+    }
+
+private:
+    const RenderRequest& request;
+    int width;
+    double outerLog2;
+    double rowOctaves; // log2 of the step from one row to the next
+    int rows;
+    bool finalZ;
+    std::vector<double> cosines;
+    std::vector<double> sines;
+
+    std::map<int, Samples> bands; // by first row / BAND_ROWS
+    std::vector<const Samples*> rowData; // the band of each row, nullptr for rows not in memory
+    double renderedPoints = 0.0;
+
+    size_t offset(int x, int y) const {
+        x %= width;
+        if (x < 0) x += width;
+        return static_cast<size_t>(y % BAND_ROWS) * width + x;
+    }
+
+    void setRows(int band, const Samples* data) {
+        int firstRow = band * BAND_ROWS;
+        int bandRows = std::min(BAND_ROWS, rows - firstRow);
+        for (int row = 0; row < bandRows; ++row) rowData[firstRow + row] = data;
+    }
+
+    void renderBand(int band, Samples& samples) {
+        int firstRow = band * BAND_ROWS;
+        int bandRows = std::min(BAND_ROWS, rows - firstRow);
+        renderedPoints += static_cast<double>(width) * bandRows;
+
+        // the innermost row has the closest samples, which sets the precision of the band
+        double spacingLog2 = rowLog2(firstRow + bandRows - 1) + std::log2(TWO_PI / width);
+
+        if (selectBackend(request, spacingLog2) == RenderBackend::Perturbation) {
+            if (!isPerturbationSupported(analyzeEquation(request.equation))) {
+                throw std::runtime_error("Perturbation needs z^2 + c");
+            }
+
+            PerturbationSettings settings;
+            settings.width = width;
+            settings.height = bandRows;
+            settings.centerX = request.view.centerX;
+            settings.centerY = request.view.centerY;
+            settings.zoom = fromLog2(spacingLog2 - 1.0 + std::log2(std::max(width, bandRows)));
+            settings.iterations = request.iterations;
+            settings.escapeRadius = request.escapeRadius;
+            settings.periodicityInterval = request.periodicityInterval;
+            settings.distanceEstimation = request.distanceEstimation;
+            settings.distanceRange = request.distanceRange;
+            settings.threadCount = request.threadCount;
+
+            std::vector<FloatExp> radii(bandRows);
+            for (int row = 0; row < bandRows; ++row) radii[row] = fromLog2(rowLog2(firstRow + row));
+
+            FrameStatistics statistics;
+            renderPerturbationSamples(settings, [&](int x, int y, FloatExp& real, FloatExp& imag) {
+                real = radii[y] * FloatExp(cosines[x]);
+                imag = radii[y] * FloatExp(sines[x]);
+            }, samples.smooth, statistics);
+            return;
+        }
+
+        // the kernel's pixel, used for periodicity and distance estimation, is the sample spacing
+        EscapeTimeSettings settings = makeEscapeTimeSettings(request);
+        settings.width = width;
+        settings.height = bandRows;
+        settings.imageWidth = 0;
+        settings.imageHeight = 0;
+        settings.zoom = std::exp2(spacingLog2) * bandRows / 2.0;
+        EscapeTimeKernel kernel(settings);
+
+        double centerReal = request.view.centerX.toDouble() * 2.0;
+        double centerImag = request.view.centerY.toDouble() * 2.0;
+        samples.resize(static_cast<size_t>(width) * bandRows, finalZ);
+        parallelFor(bandRows, request.threadCount, [&](int begin, int end) {
+            for (int row = begin; row < end; ++row) {
+                double radius = std::exp2(rowLog2(firstRow + row));
+                double finalReal, finalImag;
+                for (int x = 0; x < width; ++x) {
+                    size_t sample = static_cast<size_t>(row) * width + x;
+                    samples.smooth[sample] = kernel.evaluatePoint(centerReal + radius * cosines[x], centerImag + radius * sines[x], finalReal, finalImag);
+                    if (!finalZ) continue;
+                    samples.real[sample] = static_cast<float>(finalReal);
+                    samples.imag[sample] = static_cast<float>(finalImag);
+                }
+            }
+        });
+    }
+};
+
+// smooth iterations between the four samples around (x, y), the nearest one next to the set,
+// and the final z of the nearest one
+float sampleStrip(const Strip& strip, double x, double y, float iterations, float& real, float& imag) {
+    int x0 = static_cast<int>(std::floor(x));
+    int y0 = std::clamp(static_cast<int>(std::floor(y)), 0, strip.getRows() - 1);
+    int y1 = std::min(y0 + 1, strip.getRows() - 1);
+    float fx = static_cast<float>(x - x0);
+    float fy = static_cast<float>(std::clamp(y - y0, 0.0, 1.0));
+    strip.finalZAt(fx < 0.5f ? x0 : x0 + 1, fy < 0.5f ? y0 : y1, real, imag);
+
+    float a = strip.at(x0, y0), b = strip.at(x0 + 1, y0);
+    float c = strip.at(x0, y1), d = strip.at(x0 + 1, y1);
+    if (a >= iterations || b >= iterations || c >= iterations || d >= iterations) {
+        return fx < 0.5f ? (fy < 0.5f ? a : c) : (fy < 0.5f ? b : d);
+    }
+    float top = a + (b - a) * fx;
+    float bottom = c + (d - c) * fx;
+    return top + (bottom - top) * fy;
+}
+
+// colors a frame, bottom row first, like a render and adds it to the video
+void addFrame(FrameWriter& writer, TiledFramebuffer& image, const Samples& frame, const RenderRequest& request, float basinRadius, std::vector<uint8_t>& rgba) {
+    image.writeSmoothIterations(frame.smooth);
+    if (basinRadius > 0.0f) image.writeFinalZ(frame.real, frame.imag);
+    colorize(image, request.iterations, request.palette, request.threadCount, basinRadius);
+    image.readColors(rgba);
+    writer.addFrame(rgba);
+}
+
+// 2^log2Value - 1 without losing small differences near 0 or overflowing far from it
+FloatExp powerOfTwoMinusOne(double log2Value) {
+    if (log2Value > 60.0) return fromLog2(log2Value);
+    return FloatExp(std::expm1(log2Value * std::log(2.0)));
+}
+
+// position runs from 0 at the first view to views.size() - 1 at the last
+ViewState viewAlongPath(const std::vector<ViewState>& views, double position) {
+    if (views.size() == 1) return views[0];
+    int segment = std::clamp(static_cast<int>(std::floor(position)), 0, static_cast<int>(views.size()) - 2);
+    const ViewState& from = views[segment];
+    const ViewState& to = views[segment + 1];
+    double t = std::clamp(position - segment, 0.0, 1.0);
+
+    ViewState view = to;
+    view.logZoom = from.logZoom + (to.logZoom - from.logZoom) * t;
+
+    // how much of the way back to from's center is left, shrinking with the zoom, so the offset
+    // stays a steady number of pixels per frame and keeps its precision however deep it goes
+    FloatExp remaining = FloatExp(1.0 - t);
+    if (std::abs(to.logZoom - from.logZoom) > 1e-9) {
+        remaining = powerOfTwoMinusOne(view.logZoom - to.logZoom) / powerOfTwoMinusOne(from.logZoom - to.logZoom);
+    }
+
+    BigFixed offsetX = from.centerX;
+    offsetX.subtract(to.centerX);
+    BigFixed offsetY = from.centerY;
+    offsetY.subtract(to.centerY);
+    view.centerX.add(offsetX.toFloatExp() * remaining);
+    view.centerY.add(offsetY.toFloatExp() * remaining);
+    return view;
+}
+
+// Resamples the frame of request from a keyframe rendered at keyView, keyframeScale times larger.
+// Pixels outside the keyframe or between samples on both sides of the edge of the set are left
+// to iterate in missing.
+void resampleKeyframe(const RenderRequest& request, const ViewState& keyView, const Samples& keyframe, int keyframeScale, Samples& frame, std::vector<int>& missing) {
+    int width = request.width;
+    int height = request.height;
+    int keyWidth = width * keyframeScale;
+    int keyHeight = height * keyframeScale;
+    float iterations = static_cast<float>(request.iterations);
+
+    // keyframe pixel = ((offset + (pixel + 0.5) / size - 0.5) * scale + 0.5) * keyframe size - 0.5
+    FloatExp keyZoom = keyView.getZoom();
+    BigFixed offsetX = request.view.centerX;
+    offsetX.subtract(keyView.centerX);
+    BigFixed offsetY = request.view.centerY;
+    offsetY.subtract(keyView.centerY);
+    double shiftX = static_cast<double>(offsetX.toFloatExp() / keyZoom);
+    double shiftY = static_cast<double>(offsetY.toFloatExp() / keyZoom);
+    double scale = std::exp2(request.view.logZoom - keyView.logZoom);
+
+    std::vector<char> iterate(static_cast<size_t>(width) * height, 0);
+    parallelFor(height, request.threadCount, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            double keyY = (shiftY + ((y + 0.5) / height - 0.5) * scale + 0.5) * keyHeight - 0.5;
+            bool rowInside = keyY >= -1e-9 && keyY <= keyHeight - 1 + 1e-9;
+            int y0 = std::clamp(static_cast<int>(std::floor(keyY)), 0, keyHeight - 1);
+            int y1 = std::min(y0 + 1, keyHeight - 1);
+            float fy = static_cast<float>(std::clamp(keyY - y0, 0.0, 1.0));
+
+            for (int x = 0; x < width; ++x) {
+                size_t index = static_cast<size_t>(y) * width + x;
+                double keyX = (shiftX + ((x + 0.5) / width - 0.5) * scale + 0.5) * keyWidth - 0.5;
+                if (!rowInside || keyX < -1e-9 || keyX > keyWidth - 1 + 1e-9) {
+                    iterate[index] = 1;
+                    continue;
+                }
+                int x0 = std::clamp(static_cast<int>(std::floor(keyX)), 0, keyWidth - 1);
+                int x1 = std::min(x0 + 1, keyWidth - 1);
+                float fx = static_cast<float>(std::clamp(keyX - x0, 0.0, 1.0));
+
+                const std::vector<float>& smooth = keyframe.smooth;
+                float a = smooth[static_cast<size_t>(y0) * keyWidth + x0], b = smooth[static_cast<size_t>(y0) * keyWidth + x1];
+                float c = smooth[static_cast<size_t>(y1) * keyWidth + x0], d = smooth[static_cast<size_t>(y1) * keyWidth + x1];
+                int inside = (a >= iterations) + (b >= iterations) + (c >= iterations) + (d >= iterations);
+                size_t nearest = static_cast<size_t>(fy < 0.5f ? y0 : y1) * keyWidth + (fx < 0.5f ? x0 : x1);
+                if (inside == 4) {
+                    frame.take(index, iterations, keyframe, nearest);
+                }
+                else if (inside > 0) {
+                    iterate[index] = 1;
+                }
+                else {
+                    float top = a + (b - a) * fx;
+                    float bottom = c + (d - c) * fx;
+                    frame.take(index, top + (bottom - top) * fy, keyframe, nearest);
+                }
+            }
+        }
+    });
+
+    missing.clear();
+    for (size_t index = 0; index < iterate.size(); ++index) {
+        if (iterate[index]) missing.push_back(static_cast<int>(index));
+    }
+}
+
+// iterates just these pixels of the request's frame, with the backend a whole frame would use
+void iteratePixels(const RenderRequest& request, const std::vector<int>& pixels, Samples& frame) {
+    if (pixels.empty()) return;
+    int width = request.width;
+    int height = request.height;
+    int count = static_cast<int>(pixels.size());
+
+    if (selectBackend(request) == RenderBackend::Perturbation) {
+        if (!isPerturbationSupported(analyzeEquation(request.equation))) {
+            throw std::runtime_error("Perturbation needs z^2 + c");
+        }
+
+        // the whole frame with only these pixels iterated, so glitched regions are neighbouring pixels
+        PerturbationSettings settings;
+        settings.width = width;
+        settings.height = height;
+        settings.centerX = request.view.centerX;
+        settings.centerY = request.view.centerY;
+        settings.zoom = request.view.getZoom();
+        settings.iterations = request.iterations;
+        settings.escapeRadius = request.escapeRadius;
+        settings.periodicityInterval = request.periodicityInterval;
+        settings.distanceEstimation = request.distanceEstimation;
+        settings.distanceRange = request.distanceRange;
+        settings.threadCount = request.threadCount;
+        FloatExp span = settings.zoom.timesPowerOfTwo(1);
+
+        std::vector<char> active(static_cast<size_t>(width) * height, 0);
+        for (int pixel : pixels) active[pixel] = 1;
+        std::vector<float> values;
+        FrameStatistics statistics;
+        renderPerturbationSamples(settings, [&](int x, int y, FloatExp& real, FloatExp& imag) {
+            real = FloatExp((x + 0.5) / width - 0.5) * span;
+            imag = FloatExp((y + 0.5) / height - 0.5) * span;
+        }, values, statistics, nullptr, nullptr, &active);
+        for (int pixel : pixels) frame.smooth[pixel] = values[pixel];
+        return;
+    }
+
+    EscapeTimeSettings settings = makeEscapeTimeSettings(request);
+    EscapeTimeKernel kernel(settings);
+    const int chunk = 256;
+    parallelFor((count + chunk - 1) / chunk, request.threadCount, [&](int begin, int end) {
+        double finalReal, finalImag;
+        for (int i = begin * chunk; i < std::min(end * chunk, count); ++i) {
+            int pixel = pixels[i];
+            frame.smooth[pixel] = kernel.evaluate(pixel % width, pixel / width, finalReal, finalImag);
+            if (frame.real.empty()) continue;
+            frame.real[pixel] = static_cast<float>(finalReal);
+            frame.imag[pixel] = static_cast<float>(finalImag);
+        }
+    });
+}
+
+} // namespace
+
+ZoomVideoSummary renderZoomVideo(const RenderJob& job, const ZoomVideoOptions& options, std::ostream& log) {
+    auto start = std::chrono::steady_clock::now();
+
+    RenderRequest request = job.request;
+    request.supersamples = 0; // keyframes only give their iterations, which frames are resampled from
+    setViewCenter(request, job.centerReal, job.centerImag);
+    if (!request.compiledEquation) {
+        request.compiledEquation = std::make_shared<CompiledEquation>(request.equation, request.distanceEstimation);
+    }
+    if (!job.iterationData.empty()) {
+        throw std::runtime_error(job.output + ": iteration data isn't saved for videos");
+    }
+
+    double endZoom = request.view.logZoom;
+    double startZoom = options.startZoom;
+    if (startZoom < endZoom) {
+        throw std::runtime_error("A zoom video zooms in, the start zoom must be above the final --zoom");
+    }
+    if (options.fps < 1 || options.seconds <= 0.0 || options.keyframeOctaves <= 0.0) {
+        throw std::runtime_error("A zoom video needs a length, a frame rate and a keyframe interval above 0");
+    }
+
+    ZoomVideoSummary summary;
+    summary.width = request.width;
+    summary.height = request.height;
+    int width = request.width;
+    int height = request.height;
+    int frames = std::max(1, static_cast<int>(std::lround(options.seconds * options.fps)));
+
+    // the frame is [-1, 1] in both directions around the center, in units of the zoom, and the
+    // strip is as fine as the larger of the two pixel sizes at the frame corners
+    int stripWidth = static_cast<int>(std::ceil(TWO_PI * std::sqrt(2.0) * std::max(width, height) / 2.0));
+    double outerLog2 = startZoom + 0.5;
+    double rowOctaves = TWO_PI / stripWidth / std::log(2.0);
+    int stripRows = static_cast<int>(std::ceil((outerLog2 - endZoom) / rowOctaves)) + 2;
+    float basinRadius = rootBasinRadius(request);
+    Strip strip(request, stripWidth, outerLog2, stripRows, basinRadius > 0.0f);
+    summary.stripWidth = stripWidth;
+    summary.stripRows = stripRows;
+
+    int keyframeCount = static_cast<int>(std::floor((startZoom - endZoom) / options.keyframeOctaves + 1e-9)) + 1;
+    int keyframeIndex = -1;
+    Samples keyframe;
+    double keyframePoints = 0.0;
+
+    FrameWriter writer(job.output, width, height, options.fps, request.threadCount);
+    TiledFramebuffer image;
+    image.resize(width, height);
+    Samples frame;
+    frame.resize(static_cast<size_t>(width) * height, basinRadius > 0.0f);
+    std::vector<uint8_t> rgba;
+    float iterations = static_cast<float>(request.iterations);
+
+    for (int index = 0; index < frames; ++index) {
+        double zoom = frames > 1 ? startZoom + (endZoom - startZoom) * index / (frames - 1) : endZoom;
+
+        // the nearest keyframe at or past this frame
+        int wanted = std::clamp(static_cast<int>(std::floor((zoom - endZoom) / options.keyframeOctaves + 1e-9)), 0, keyframeCount - 1);
+        double keyframeZoom = endZoom + wanted * options.keyframeOctaves;
+        if (wanted != keyframeIndex) {
+            auto keyframeStart = std::chrono::steady_clock::now();
+            RenderRequest keyRequest = request;
+            keyRequest.view.logZoom = keyframeZoom;
+            RenderResult result = render(keyRequest);
+            result.image.readSmoothIterations(keyframe.smooth);
+            if (basinRadius > 0.0f) result.image.readFinalZ(keyframe.real, keyframe.imag);
+            keyframeIndex = wanted;
+            keyframePoints += static_cast<double>(width) * height;
+            ++summary.keyframes;
+
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - keyframeStart).count();
+            log << job.output << ": keyframe " << summary.keyframes << " of " << keyframeCount << " at zoom " << keyframeZoom
+                << " in " << milliseconds << " ms, frame " << index + 1 << " of " << frames << "\n";
+            if (!result.warning.empty()) log << job.output << ": warning: " << result.warning << "\n";
+        }
+
+        // the ring between the frame corners and the keyframe
+        double scale = std::exp2(keyframeZoom - zoom);
+        strip.require(static_cast<int>(std::floor(strip.rowAt(zoom + 0.5))) - 1, static_cast<int>(std::ceil(strip.rowAt(keyframeZoom))) + 1);
+
+        parallelFor(height, request.threadCount, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                double v = ((y + 0.5) / height - 0.5) * 2.0;
+                for (int x = 0; x < width; ++x) {
+                    double u = ((x + 0.5) / width - 0.5) * 2.0;
+                    size_t pixel = static_cast<size_t>(y) * width + x;
+                    if (std::max(std::abs(u), std::abs(v)) < scale) {
+                        int keyX = std::clamp(static_cast<int>((u / scale * 0.5 + 0.5) * width), 0, width - 1);
+                        int keyY = std::clamp(static_cast<int>((v / scale * 0.5 + 0.5) * height), 0, height - 1);
+                        size_t sample = static_cast<size_t>(keyY) * width + keyX;
+                        frame.take(pixel, keyframe.smooth[sample], keyframe, sample);
+                    }
+                    else {
+                        double angle = std::atan2(v, u);
+                        if (angle < 0.0) angle += TWO_PI;
+                        double row = strip.rowAt(zoom + 0.5 * std::log2(u * u + v * v));
+                        float real, imag;
+                        frame.smooth[pixel] = sampleStrip(strip, angle / TWO_PI * stripWidth - 0.5, row, iterations, real, imag);
+                        if (frame.real.empty()) continue;
+                        frame.real[pixel] = real;
+                        frame.imag[pixel] = imag;
+                    }
+                }
+            }
+        });
+
+        addFrame(writer, image, frame, request, basinRadius, rgba);
+    }
+    writer.finish();
+
+    summary.frames = frames;
+    summary.iteratedPoints = strip.getRenderedPoints() + keyframePoints;
+    summary.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return summary;
+}
+
+ZoomVideoSummary renderZoomPath(const std::vector<RenderJob>& waypoints, const ZoomPathOptions& options, std::ostream& log) {
+    auto start = std::chrono::steady_clock::now();
+
+    if (waypoints.empty()) {
+        throw std::runtime_error("A zoom path needs at least one waypoint");
+    }
+    if (options.fps < 1 || options.seconds <= 0.0 || options.keyframeScale < 1 || options.maxError <= 0.0) {
+        throw std::runtime_error("A zoom path needs a length, a frame rate, a keyframe scale and an error above 0");
+    }
+    const RenderJob& first = waypoints.front();
+    if (!first.iterationData.empty()) {
+        throw std::runtime_error(first.output + ": iteration data isn't saved for videos");
+    }
+
+    RenderRequest request = first.request;
+    request.supersamples = 0;
+    if (!request.compiledEquation) {
+        request.compiledEquation = std::make_shared<CompiledEquation>(request.equation, request.distanceEstimation);
+    }
+
+    // every center with the limbs the deepest waypoint needs, so the path can be added up exactly
+    std::vector<ViewState> views;
+    int limbs = 0;
+    for (const RenderJob& waypoint : waypoints) {
+        RenderRequest located = request;
+        located.view.logZoom = waypoint.request.view.logZoom;
+        setViewCenter(located, waypoint.centerReal, waypoint.centerImag);
+        limbs = std::max(limbs, located.view.centerX.fractionalLimbs());
+        views.push_back(located.view);
+    }
+    for (ViewState& view : views) {
+        view.centerX.reservePrecision(limbs);
+        view.centerY.reservePrecision(limbs);
+    }
+
+    ZoomVideoSummary summary;
+    summary.width = request.width;
+    summary.height = request.height;
+    int width = request.width;
+    int height = request.height;
+    int frames = std::max(1, static_cast<int>(std::lround(options.seconds * options.fps)));
+    int keyframeScale = options.keyframeScale;
+
+    float basinRadius = rootBasinRadius(request);
+    FrameWriter writer(first.output, width, height, options.fps, request.threadCount);
+    TiledFramebuffer image;
+    image.resize(width, height);
+    Samples frame;
+    frame.resize(static_cast<size_t>(width) * height, basinRadius > 0.0f);
+    std::vector<uint8_t> rgba;
+    std::vector<int> missing;
+
+    ViewState keyView;
+    Samples keyframe;
+    double keyframePoints = 0.0;
+    double iteratedPixels = 0.0;
+
+    for (int index = 0; index < frames; ++index) {
+        double position = frames > 1 ? static_cast<double>(views.size() - 1) * index / (frames - 1) : static_cast<double>(views.size() - 1);
+        RenderRequest frameRequest = request;
+        frameRequest.view = viewAlongPath(views, position);
+
+        // keyframe samples this many frame pixels apart
+        bool reuse = !keyframe.smooth.empty() && std::exp2(keyView.logZoom - frameRequest.view.logZoom) / keyframeScale <= options.maxError;
+        if (reuse) {
+            resampleKeyframe(frameRequest, keyView, keyframe, keyframeScale, frame, missing);
+            reuse = missing.size() <= frame.smooth.size() / 2;
+        }
+        if (!reuse) {
+            auto keyframeStart = std::chrono::steady_clock::now();
+            RenderRequest keyRequest = frameRequest;
+            keyRequest.width = width * keyframeScale;
+            keyRequest.height = height * keyframeScale;
+            RenderResult result = render(keyRequest);
+            result.image.readSmoothIterations(keyframe.smooth);
+            if (basinRadius > 0.0f) result.image.readFinalZ(keyframe.real, keyframe.imag);
+            keyView = frameRequest.view;
+            keyframePoints += static_cast<double>(keyRequest.width) * keyRequest.height;
+            ++summary.keyframes;
+
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - keyframeStart).count();
+            log << first.output << ": keyframe " << summary.keyframes << " at zoom " << keyView.logZoom << " in " << milliseconds
+                << " ms, frame " << index + 1 << " of " << frames << "\n";
+            if (!result.warning.empty()) log << first.output << ": warning: " << result.warning << "\n";
+            resampleKeyframe(frameRequest, keyView, keyframe, keyframeScale, frame, missing);
+        }
+
+        iteratePixels(frameRequest, missing, frame);
+        iteratedPixels += static_cast<double>(missing.size());
+        addFrame(writer, image, frame, request, basinRadius, rgba);
+    }
+    writer.finish();
+
+    summary.frames = frames;
+    summary.iteratedPoints = keyframePoints + iteratedPixels;
+    summary.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return summary;
+}
@@ -0,0 +1,58 @@
+#ifndef ZOOM_VIDEO_H
+#define ZOOM_VIDEO_H
+
+#include <ostream>
+#include <vector>
+
+#include "renderJobs.h"
+
+// Zoom videos from an exponential map. Rendered frame by frame, a deep zoom iterates nearly the
+// same points for every frame; here each point along the zoom is iterated once, on a log-polar
+// strip around the center: column x is the angle 2 pi (x + 0.5) / width and every row is
+// exp(2 pi / width) closer in, so samples are square and at most a pixel apart out to the frame
+// corners. Frames are resampled from the strip, except in their middle where the strip gets far
+// denser than the pixels: that part comes from keyframes, full frames rendered every
+// keyframeOctaves of zoom, each covering the middle of the frames until the next one.
+// The strip is rendered in bands of rows as the frames reach them and dropped behind them, so
+// memory stays at a few frames' worth however deep the zoom goes.
+
+struct ZoomVideoOptions {
+    double startZoom = 0.0; // log2 zoom of the first frame, the job's zoom is the last frame's
+    double seconds = 10.0;
+    int fps = 30;
+    double keyframeOctaves = 1.0;
+};
+
+struct ZoomVideoSummary {
+    int width = 0;
+    int height = 0;
+    int frames = 0;
+    int keyframes = 0;
+    int stripWidth = 0; // 0 along a path
+    int stripRows = 0;
+    double iteratedPoints = 0.0; // strip and keyframes, a frame by frame render iterates width x height x frames
+    double milliseconds = 0.0;
+};
+
+// Writes job.output through FrameWriter (see frameWriter.h), throws std::runtime_error
+ZoomVideoSummary renderZoomVideo(const RenderJob& job, const ZoomVideoOptions& options, std::ostream& log);
+
+// Videos along a scripted path of views, for pans and zooms out the exponential map can't follow.
+// Frames are resampled from the last keyframe, a render of a whole frame at keyframeScale times
+// its resolution, and only pixels the keyframe doesn't cover or that straddle the edge of the set
+// are iterated. A new keyframe is rendered once its samples are more than maxError frame pixels
+// apart, or when more than half the frame would be iterated anyway.
+// Between two waypoints the zoom moves evenly in log2 and the center moves with the zoom, so the
+// next waypoint's center glides to the middle of the frame at a steady speed on screen.
+
+struct ZoomPathOptions {
+    double seconds = 10.0; // split evenly between the waypoints
+    int fps = 30;
+    int keyframeScale = 2;
+    double maxError = 1.0;
+};
+
+// every waypoint's center and zoom, the other settings and the output come from the first one
+ZoomVideoSummary renderZoomPath(const std::vector<RenderJob>& waypoints, const ZoomPathOptions& options, std::ostream& log);
+
+#endif // ZOOM_VIDEO_H
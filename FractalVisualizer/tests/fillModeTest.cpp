@@ -0,0 +1,86 @@
+// Renders each view with every fill mode and with brute force, and fails unless every smooth
+// iteration value is the same. The views are where fills used to cover features the iteration
+// reaches: the first four at the size they went wrong at, then converging equations, exp and
+// sinh overflowing, and distance estimation.
+
+#include <cstdio>
+#include <exception>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "renderCore.h"
+
+namespace {
+
+struct FillCase {
+    const char* equation;
+    const char* centerReal;
+    const char* centerImag;
+    double logZoom;
+    int iterations;
+    int size;
+    bool distanceEstimation;
+    std::map<std::string, std::pair<double, double>> variables;
+};
+
+// solid guessing through render() always ends with the exact final pass
+const FillMode FILL_MODES[] = { FillMode::Subdivision, FillMode::SolidGuessing, FillMode::BoundaryTracing };
+
+std::vector<float> renderSmoothIterations(const FillCase& view, FillMode fillMode) {
+    RenderRequest request;
+    request.width = view.size;
+    request.height = view.size;
+    request.iterations = view.iterations;
+    request.distanceEstimation = view.distanceEstimation;
+    request.backend = RenderBackend::EscapeTime;
+    request.fillMode = fillMode;
+    request.equation = view.equation;
+    request.variables = view.variables;
+    request.view.logZoom = view.logZoom;
+    setViewCenter(request, view.centerReal, view.centerImag);
+
+    std::vector<float> values;
+    render(request).image.readSmoothIterations(values);
+    return values;
+}
+
+}
+
+int main() {
+    const FillCase CASES[] = {
+        { "abs(z)^2 - c", "0.5", "0.5", 0.0, 100, 1080, false, {} },
+        { "conj(z)^2 + c", "0", "0", 0.0, 100, 1080, false, {} },
+        { "z^2 + c", "-0.75", "0.1", -3.0, 1000, 1080, false, {} },
+        { "z^2 + k", "0", "0", 0.0, 100, 1080, false, { { "k", { -0.8, 0.156 } } } },
+        { "z^2 + c", "0", "0", 0.0, 1000, 1080, false, {} },
+        { "z^3 + c", "0", "0", 0.0, 200, 540, false, {} },
+        { "z - (z^3 - 1) / (3*z^2)", "0", "0", 1.0, 50, 540, false, {} },
+        { "exp(z) + c", "0", "0", 1.0, 100, 540, false, {} },
+        { "sinh(z) + c", "0", "0", 1.0, 100, 540, false, {} },
+        { "z^2 + c", "-0.75", "0.1", -3.0, 1000, 540, true, {} },
+    };
+
+    int failed = 0;
+    for (const FillCase& view : CASES) {
+        try {
+            std::vector<float> expected = renderSmoothIterations(view, FillMode::BruteForce);
+            for (FillMode fillMode : FILL_MODES) {
+                std::vector<float> filled = renderSmoothIterations(view, fillMode);
+                int different = 0;
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    if (expected[i] != filled[i]) ++different;
+                }
+                std::printf("%s%s, %s: %d of %zu pixels differ\n", view.equation, view.distanceEstimation ? " by distance" : "",
+                    fillModeName(fillMode), different, expected.size());
+                if (different != 0) ++failed;
+            }
+        }
+        catch (const std::exception& error) {
+            std::printf("%s: %s\n", view.equation, error.what());
+            ++failed;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}